@@ -0,0 +1,443 @@
+/*
+ * bench.c
+ *
+ * Copyright 2021 Paul Rose <rose.apply@googlemail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ *
+ */
+
+/* er_bench : throughput benchmark for the libenoch commands */
+
+/* Runs G/E/D/P over a ladder of pad sizes (x16 per step), byte and bit */
+/* Pyx modes, and each stream backend (stdio, fd, mmap). A FIFO or file */
+/* fed by a PRNG stands in for /dev/TrueRNG. Every case runs in its own */
+/* child process so syscall counts and peak RSS are per case. */
+
+/* er_bench [-m minsize] [-s maxsize] [-d dir] [-r fifo|file] [-c cmds] [-o csv] */
+/* [er_bench -s64M -rfifo -cGEDP -obench_output.txt] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <ctype.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "libenoch.h"
+
+#define CMD_STD			9
+#define CMD_ALT			1
+#define FALSE			0
+#define TRUE			1
+#define OPTSTR			"m:s:d:r:c:o:h"
+#define BENCH_BLOCK		65536
+#define BENCH_FSP_MAX	(MAX_FSP_PATH + 32)
+#define CSV_HEADER		"libenoch,cmd,mode,backend,bytes,seconds,mb_per_s,syscr,syscw,maxrss_kb,status\n"
+#define USAGE_FMT		"%s : libenoch benchmark (libenoch:v%s)\n[-m minsize] [-s maxsize] [-d dir] [-r fifo|file] [-c cmds] [-o csvfile]\n[%s -s64M -rfifo -cGEDP -obench_output.txt]\n"
+#define ERR_SETUP		"Error preparing benchmark files in %s\n"
+#define ERR_FIFO		"Error creating fake RNG device %s\n"
+
+typedef struct {
+	char		cmd;
+	int			mode;
+	int			binary;
+	const char	*name;
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+	{ 'G', CMD_STD, FALSE, "size" },
+	{ 'G', CMD_ALT, FALSE, "pd" },
+	{ 'E', CMD_STD, FALSE, "existing" },
+	{ 'E', CMD_ALT, FALSE, "dynamic" },
+	{ 'D', CMD_STD, FALSE, "existing" },
+	{ 'P', CMD_ALT, FALSE, "byte" },
+	{ 'P', CMD_ALT, TRUE,  "bit" }
+};
+
+static const char *backends[] = { "stdio", "fd", "mmap" };
+
+typedef struct {
+	unsigned long long	minsize;
+	unsigned long long	maxsize;
+	char				dir[MAX_FSP_PATH];
+	char				cmds[8];
+	int					fifo;
+	char				rng[BENCH_FSP_MAX];
+	FILE				*out;
+	char				version[5];
+	pid_t				feeder;
+} bench_t;
+
+static unsigned long long prng_state = 0x9E3779B97F4A7C15ULL;
+
+/*  prng_fill  --  xorshift64* stream; stands in for the RNG hardware.  */
+
+static void prng_fill(unsigned char *buf, size_t len)
+{
+	unsigned long long x = prng_state, r;
+	size_t i;
+
+	for (i = 0; i < len; i += 8) {
+		x ^= x >> 12;
+		x ^= x << 25;
+		x ^= x >> 27;
+		r = x * 0x2545F4914F6CDD1DULL;
+		memcpy(buf + i, &r, (len - i < 8) ? len - i : 8);
+	}
+	prng_state = x;
+}
+
+static unsigned long long parse_size(const char *str)
+{
+	unsigned long long size;
+
+	size = strtoull(str, NULL, 10);
+	switch (toupper((unsigned char) str[strlen(str) - 1])) {
+		case 'K': size <<= 10; break;
+		case 'M': size <<= 20; break;
+		case 'G': size <<= 30; break;
+	}
+	return(size);
+}
+
+static int write_prng_file(const char *fsp, unsigned long long size)
+{
+	unsigned char buf[BENCH_BLOCK];
+	unsigned long long left = size;
+	size_t n;
+	FILE *fp;
+
+	if ((fp = fopen(fsp, "w")) == NULL)
+		return(EXIT_FAILURE);
+	while (left > 0) {
+		n = (left < sizeof(buf)) ? (size_t) left : sizeof(buf);
+		prng_fill(buf, n);
+		if (fwrite(buf, 1, n, fp) != n) {
+			fclose(fp);
+			return(EXIT_FAILURE);
+		}
+		left -= n;
+	}
+	return(fclose(fp) == EOF ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/*  start_feeder  --  child that keeps the FIFO device supplied; each case
+	opens and closes the FIFO, so the feeder simply reopens after EPIPE.  */
+
+static int start_feeder(bench_t *b)
+{
+	unsigned char buf[BENCH_BLOCK];
+	int fd;
+
+	if ((mkfifo(b->rng, 0600) == -1) && (errno != EEXIST))
+		return(EXIT_FAILURE);
+	fflush(b->out);
+	if ((b->feeder = fork()) < 0)
+		return(EXIT_FAILURE);
+	if (b->feeder > 0)
+		return(EXIT_SUCCESS);
+
+	signal(SIGPIPE, SIG_IGN);
+	for (;;) {
+		if ((fd = open(b->rng, O_WRONLY)) < 0)
+			_exit(EXIT_FAILURE);
+		do
+			prng_fill(buf, sizeof(buf));
+		while (write(fd, buf, sizeof(buf)) > 0);
+		close(fd);
+	}
+}
+
+/*  proc_io  --  read/write syscall counters of this process.  */
+
+static void proc_io(long long *syscr, long long *syscw)
+{
+	char line[64];
+	FILE *fp;
+
+	*syscr = *syscw = -1;
+	if ((fp = fopen("/proc/self/io", "r")) == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		sscanf(line, "syscr: %lld", syscr);
+		sscanf(line, "syscw: %lld", syscw);
+	}
+	fclose(fp);
+}
+
+static le_stream_t *open_source(const char *backend, const char *fsp)
+{
+	le_stream_t *stream;
+	FILE *fp;
+
+	if (strcmp(backend, "stdio") == 0) {
+		if ((fp = fopen(fsp, "r")) == NULL)
+			return(NULL);
+		if ((stream = le_open_stdio(fp, TRUE)) == NULL)
+			fclose(fp);
+		return(stream);
+	}
+	if (strcmp(backend, "mmap") == 0)
+		return(le_open_mmap(fsp));
+	return(le_open_file(fsp, O_RDONLY));
+}
+
+static le_stream_t *open_sink(const char *backend, const char *fsp)
+{
+	le_stream_t *stream;
+	FILE *fp;
+
+	if (strcmp(backend, "stdio") == 0) {
+		if ((fp = fopen(fsp, "w")) == NULL)
+			return(NULL);
+		if ((stream = le_open_stdio(fp, TRUE)) == NULL)
+			fclose(fp);
+		return(stream);
+	}
+	return(le_open_file(fsp, O_WRONLY | O_CREAT | O_TRUNC));
+}
+
+static void bench_fsp(char *fsp, const bench_t *b, const char *name, unsigned long long size)
+{
+	snprintf(fsp, BENCH_FSP_MAX, "%s/%s.%llu", b->dir, name, size);
+}
+
+/*  run_case  --  child body: open streams, time one command, report.  */
+
+static void run_case(bench_t *b, const bench_case_t *c, const char *backend, unsigned long long size)
+{
+	char clear[BENCH_FSP_MAX], pad[BENCH_FSP_MAX], enc[BENCH_FSP_MAX];
+	char out[BENCH_FSP_MAX], out2[BENCH_FSP_MAX];
+	long long r0, w0, r1, w1;
+	struct timespec t0, t1;
+	struct rusage ru;
+	options_t options;
+	double secs;
+	int rc;
+
+	bench_fsp(clear, b, "clear", size);
+	bench_fsp(pad, b, "pad", size);
+	bench_fsp(enc, b, "enc", size);
+	bench_fsp(out, b, "out", size);
+	bench_fsp(out2, b, "out2", size);
+
+	memset(&options, 0, sizeof(options));
+	options.cmd_mode = c->mode;
+	options.pyx_binary = c->binary;
+	options.size = size;
+
+	switch (c->cmd) {
+		case 'G':
+			if (c->mode == CMD_ALT) {
+				options.input = open_source(backend, clear);
+				options.encrypted = open_source(backend, enc);
+			}
+			options.otp = open_sink(backend, out);
+			break;
+
+		case 'E':
+			options.input = open_source(backend, clear);
+			options.output = open_sink(backend, out);
+			if (c->mode == CMD_ALT)
+				options.otp = open_sink(backend, out2);
+			else
+				options.otp = open_source(backend, pad);
+			break;
+
+		case 'D':
+			options.size = 0;
+			options.input = open_source(backend, enc);
+			options.otp = open_source(backend, pad);
+			options.output = open_sink(backend, out);
+			break;
+
+		case 'P':
+			options.otp = open_source(backend, pad);
+			options.output = open_sink(backend, out);
+			break;
+	}
+	if (((c->cmd == 'G') && (c->mode == CMD_STD)) || ((c->cmd == 'E') && (c->mode == CMD_ALT)))
+		options.device = le_open_device(b->rng);
+
+	proc_io(&r0, &w0);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	switch (c->cmd) {
+		case 'G': rc = g_generate(&options); break;
+		case 'E': rc = e_encrypt(&options); break;
+		case 'D': rc = d_decrypt(&options); break;
+		default:  rc = p_pyx(&options); break;
+	}
+	le_close(options.output);
+	le_close(options.otp);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	proc_io(&r1, &w1);
+	getrusage(RUSAGE_SELF, &ru);
+
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	fprintf(b->out, "%s,%c,%s,%s,%llu,%.6f,%.2f,%lld,%lld,%ld,%s\n",
+		b->version, c->cmd, c->name, backend, size, secs,
+		(secs > 0.0) ? size / secs / 1048576.0 : 0.0,
+		(r0 < 0) ? -1 : r1 - r0, (w0 < 0) ? -1 : w1 - w0, ru.ru_maxrss,
+		(rc == EXIT_SUCCESS) ? "ok" : options.errmsg);
+	fflush(b->out);
+
+	le_close(options.input);
+	le_close(options.encrypted);
+	le_close(options.device);
+}
+
+/*  prepare  --  clear, pad and matching encrypted file for one size.  */
+
+static int prepare(bench_t *b, unsigned long long size)
+{
+	char clear[BENCH_FSP_MAX], pad[BENCH_FSP_MAX], enc[BENCH_FSP_MAX];
+	options_t options;
+	int rc;
+
+	bench_fsp(clear, b, "clear", size);
+	bench_fsp(pad, b, "pad", size);
+	bench_fsp(enc, b, "enc", size);
+
+	if ((write_prng_file(clear, size) != EXIT_SUCCESS) || (write_prng_file(pad, size) != EXIT_SUCCESS))
+		return(EXIT_FAILURE);
+
+	memset(&options, 0, sizeof(options));
+	options.cmd_mode = CMD_STD;
+	options.input = le_open_file(clear, O_RDONLY);
+	options.otp = le_open_file(pad, O_RDONLY);
+	options.output = le_open_file(enc, O_WRONLY | O_CREAT | O_TRUNC);
+	if ((options.input == NULL) || (options.otp == NULL) || (options.output == NULL))
+		rc = EXIT_FAILURE;
+	else
+		rc = e_encrypt(&options);
+	le_close(options.input);
+	le_close(options.otp);
+	le_close(options.output);
+	return(rc);
+}
+
+static void cleanup(bench_t *b, unsigned long long size)
+{
+	const char *names[] = { "clear", "pad", "enc", "out", "out2" };
+	char fsp[BENCH_FSP_MAX];
+	size_t i;
+
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		bench_fsp(fsp, b, names[i], size);
+		unlink(fsp);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long size;
+	size_t c, k;
+	bench_t b;
+	pid_t pid;
+	int opt;
+
+	memset(&b, 0, sizeof(b));
+	b.minsize = 1024;
+	b.maxsize = 16 * 1048576ULL;
+	b.fifo = TRUE;
+	b.out = stdout;
+	snprintf(b.dir, sizeof(b.dir), "%s", "/tmp");
+	snprintf(b.cmds, sizeof(b.cmds), "%s", "GEDP");
+	enoch(b.version);
+
+	while ((opt = getopt(argc, argv, OPTSTR)) != EOF)
+		switch (opt) {
+			case 'm': b.minsize = parse_size(optarg); break;
+			case 's': b.maxsize = parse_size(optarg); break;
+			case 'd': snprintf(b.dir, sizeof(b.dir), "%s", optarg); break;
+			case 'r': b.fifo = (strcmp(optarg, "file") != 0); break;
+			case 'c': snprintf(b.cmds, sizeof(b.cmds), "%s", optarg); break;
+			case 'o':
+				if ((b.out = fopen(optarg, "w")) == NULL) {
+					perror(optarg);
+					return(EXIT_FAILURE);
+				}
+				break;
+			case 'h':
+			default:
+				fprintf(stdout, USAGE_FMT, argv[0], b.version, argv[0]);
+				return(EXIT_FAILURE);
+		}
+
+	if (b.minsize == 0)
+		b.minsize = 1;
+
+	if (b.fifo) {
+		snprintf(b.rng, sizeof(b.rng), "%s/er_bench_rng.%d", b.dir, (int) getpid());
+		if (start_feeder(&b) != EXIT_SUCCESS) {
+			fprintf(stderr, ERR_FIFO, b.rng);
+			return(EXIT_FAILURE);
+		}
+	} else {
+		snprintf(b.rng, sizeof(b.rng), "%s/er_bench_rng.%d", b.dir, (int) getpid());
+		if (write_prng_file(b.rng, b.maxsize) != EXIT_SUCCESS) {
+			fprintf(stderr, ERR_FIFO, b.rng);
+			return(EXIT_FAILURE);
+		}
+	}
+
+	fprintf(b.out, CSV_HEADER);
+
+	for (size = b.minsize; size <= b.maxsize; size *= 16) {
+		if (prepare(&b, size) != EXIT_SUCCESS) {
+			fprintf(stderr, ERR_SETUP, b.dir);
+			cleanup(&b, size);
+			break;
+		}
+		for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+			if (strchr(b.cmds, cases[c].cmd) == NULL)
+				continue;
+			for (k = 0; k < sizeof(backends) / sizeof(backends[0]); k++) {
+				/* the size-only generator reads nothing but the device */
+				if ((cases[c].cmd == 'G') && (cases[c].mode == CMD_STD) && (strcmp(backends[k], "mmap") == 0))
+					continue;
+				fflush(b.out);
+				if ((pid = fork()) == 0) {
+					run_case(&b, &cases[c], backends[k], size);
+					_exit(EXIT_SUCCESS);
+				}
+				if (pid > 0)
+					waitpid(pid, NULL, 0);
+			}
+		}
+		cleanup(&b, size);
+		if (size > b.maxsize / 16)
+			break;
+	}
+
+	if (b.feeder > 0) {
+		kill(b.feeder, SIGTERM);
+		waitpid(b.feeder, NULL, 0);
+	}
+	unlink(b.rng);
+	if (b.out != stdout)
+		fclose(b.out);
+	return(EXIT_SUCCESS);
+}
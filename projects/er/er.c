@@ -36,12 +36,13 @@
 #include <sys/stat.h>
 #include <ctype.h>
 #include <math.h>
+#include <signal.h>
 #include "libenoch.h"
 
 /* er usage */
 
-/* Commands : G, E, D, P */
-/* Generate OTP/PD OTP, Encrypt, Decrypt, Pyx */
+/* Commands : G, E, D, P, S, W, C */
+/* Generate OTP/PD OTP, Encrypt, Decrypt, Pyx, Serve, Wipe, Carve */
 
 /* G -s<size BKMG> -pfsp || G -ifsp -efsp -pfsp -f */
 /* [G -s1M -pnew.otp] */
@@ -59,20 +60,48 @@
 /* [P -pexisting.otp] [-b] */
 /* [P -pexisting.otp -oterse.rpt] [-b] */
 
+/* S -u<socket fsp> */
+/* [S -u/run/er.sock] */
+
+/* C -pfsp -oprefix -s<size BKMG> || C -pfsp -oprefix -n<count> || C -pfsp,fsp... -ofsp */
+/* [C -pbig.otp -oseg -s1G] */
+/* [C -pbig.otp -oparty -n4] */
+/* [C -pparty.000,party.001 -ojoined.otp] */
+
 /* -v : verbose output */
 /* -r : select random number generation device */
 /* -b ; binary mode for Pyx */
+/* -t : byte triple serial test for Pyx */
+/* -g : autocorrelation lags for Pyx */
+/* -d : resumable Generate, checkpointed in <otp>.ckpt */
 /* -f : fill PD OTP for plausible deniability */
-
-#define ER_VERSION	"0.1"
-#define REQ_LE_VERSION "0.1"
+/* -j : dump operation statistics as JSON */
+/* -m : huge page backed, memory locked I/O buffers */
+/* -z : compress before encrypting, or LZ compressibility test for Pyx */
+/* -l : write a legacy raw OTP (no container header) */
+/* -a : authenticate the encrypted file with a one-time MAC */
+/* -c : condition RNG device output (vn, xor[2-8] or sha256) */
+/* -x : pad reuse index (default $ER_REUSE_INDEX) */
+/* -n : number of segments to carve, or the one chunk to decrypt */
+/* -q : chunk size of a chunked encrypted file */
+/* -k : page cache policy, cache, stream or direct (default $ER_IO_POLICY) */
+/* -y : Pyx result cache (default $ER_PYX_CACHE) */
+
+#define ENV_REUSE_INDEX	"ER_REUSE_INDEX"
+#define ENV_IO_POLICY	"ER_IO_POLICY"
+#define ENV_PYX_CACHE	"ER_PYX_CACHE"
+#define ER_VERSION	"0.2"
+#define REQ_LE_VERSION "0.2"
 #define ERR_LE_MISMATCH "Mismatch with libenoch version : Required %s; libenoch installed %s\n"
-#define OPTSTR "GEDPvfbr:i:s:o:p:e:h"
+#define OPTSTR "GEDPSWCvfbtdjmzlawr:c:x:n:q:k:y:g:i:s:o:p:e:u:h"
 #define GCMD			0
 #define	ECMD			1
 #define DCMD			2
 #define PCMD			3
-#define ZCMD			4
+#define SCMD			4
+#define WCMD			5
+#define CCMD			6
+#define ZCMD			7
 #define CMD_STD			9
 #define CMD_ALT			1
 #define FALSE			0
@@ -81,12 +110,15 @@
 #define END				1
 #define USAGE_FMT0 "%s : Equivocal dual acronym \"Encrypt Right\"/\"Enoch Root\" (v%s;libenoch:v%s)\n"
 #define USAGE_FMT9 "%s : Equivocal dual acronym \"Encrypt Right\"/\"Enoch Root\" (v%s)\n"
-#define USAGE_FMT1 "%s : -G : Generate OTP/PD OTP, -E : Encrypt, -D : Decrypt, -P : Pyx\n[-i inputfile] [-e inputfile] [-p otp file] [-o outputfile]\n[-s size] [-r devname] [-v] [-b] [-f] [-h]\n\n"
-#define USAGE_FMT2 "-G -s<size BKMG> -pfsp || -G -ifsp -efsp -pfsp -f\n[-G -s1M -pnew.otp]\n[-G -iclear.in -eexisting.enc -pnew.otp -f]\n\n"
-#define USAGE_FMT3 "-E -ifsp -pfsp -ofsp  || -E -ifsp -pnewfsp -ofsp\n[-E -iclear.in -pexisting.otp -oencrypted.out]\n[-E -iclear.in -pnew.otp -oencrypted.out]\n\n"
-#define USAGE_FMT4 "-D -ifsp -pfsp -ofsp || -D -ifsp -pfsp -ofsp -s<size BKMG>\n[-D -iencrypted.in -pexisting.otp -oclear.out]\n[-D -iencrypted.in -pexisting.otp -oclear.out -s1M]\n\n"
-#define USAGE_FMT5 "-P -pfsp -b || -P -pfsp -ofsp -b\n[-P -pexisting.otp] [-b]\n[-P -pexisting.otp -oterse.rpt] [-b]\n\n"
-#define USAGE_FMT6 "-v : Verbose output, -r : RNG device, -b : Pyx binary mode, -f : Fill PD OTP\n"
+#define USAGE_FMT1 "%s : -G : Generate OTP/PD OTP, -E : Encrypt, -D : Decrypt, -P : Pyx, -S : Serve, -W : Wipe, -C : Carve\n[-i inputfile] [-e inputfile] [-p otp file] [-o outputfile] [-u socket]\n[-s size] [-r devname] [-c vn|xor[2-8]|sha256] [-x index] [-n count] [-q chunk] [-k policy] [-y cache] [-g lags] [-v] [-b] [-t] [-d] [-f] [-j] [-m] [-z] [-l] [-a] [-w] [-h]\n\n"
+#define USAGE_FMT2 "-G -s<size BKMG> -pfsp || -G -ifsp -efsp -pfsp -f\n[-G -s1M -pnew.otp] [-l] [-d]\n[-G -iclear.in -eexisting.enc -pnew.otp -f]\n\n"
+#define USAGE_FMT3 "-E -ifsp -pfsp -ofsp  || -E -ifsp -pnewfsp -ofsp\n[-E -iclear.in -pexisting.otp -oencrypted.out]\n[-E -iclear.in -pnew.otp -oencrypted.out] [-z] [-a]\n[-E -iarchive.tar -pexisting.otp -oarchive.enc -q64M] [-z]\n[-E -iclear.in -p/ssd0/a.otp,/ssd1/b.otp -oencrypted.out]\n\n"
+#define USAGE_FMT4 "-D -ifsp -pfsp -ofsp || -D -ifsp -pfsp -ofsp -s<size BKMG>\n[-D -iencrypted.in -pexisting.otp -oclear.out]\n[-D -iencrypted.in -pexisting.otp -oclear.out -s1M]\n[-D -iarchive.enc -pexisting.otp -oclear.out -n3]\n\n"
+#define USAGE_FMT5 "-P -pfsp -b || -P -pfsp -ofsp -b\n[-P -pexisting.otp] [-b] [-z]\n[-P -pexisting.otp -oterse.rpt] [-b]\n[-P -p/pads/ -oinventory.csv] [-P -p@pads.lst] [-P -p'pads/*.otp']\n\n"
+#define USAGE_FMT5b "-W -pfsp || -W -pfsp -s<size BKMG>\n[-W -pused.otp]\n[-W -plegacy.otp -s1M]\n\n"
+#define USAGE_FMT5c "-C -pfsp -ofsp -s<size BKMG> || -C -pfsp -ofsp -n<count> || -C -pfsp,fsp... -ofsp\n[-C -pbig.otp -oseg -s1G] [-l]\n[-C -pbig.otp -oparty -n4]\n[-C -pparty.000,party.001 -ojoined.otp]\n\n"
+#define USAGE_FMT5a "-S -ufsp\n[-S -u/run/er.sock]\n\n"
+#define USAGE_FMT6 "-v : Verbose output, -r : RNG device, -b : Pyx binary mode, -t : Pyx byte triple test, -f : Fill PD OTP, -j : JSON statistics\n-d : Resumable Generate, continued from <otp>.ckpt after an interruption\n-m : Huge page, memory locked buffers, -z : Compress before encrypting / Pyx LZ compressibility test\n-l : Legacy raw OTP, -a : Authenticate encrypted file, -w : Wipe used OTP after Encrypt/Decrypt\n-c : Condition RNG device output (von Neumann, XOR fold or SHA-256) for Generate/Encrypt\n-x : Pad reuse index for Generate/Encrypt/Serve (default $" ENV_REUSE_INDEX ")\n-n : Number of segments to Carve, or the one chunk to Decrypt\n-q : Chunk size of a chunked encrypted file, for parallel and single chunk Decrypt\n-k : Page cache policy (cache, stream or direct) for Generate/Encrypt/Decrypt/Pyx (default $" ENV_IO_POLICY ")\n-y : Pyx result cache, reused while a pad is unchanged (default $" ENV_PYX_CACHE ")\n-g : Pyx autocorrelation of lags 1 to lags (1 to 65536)\n"
 #define USAGE_FMT7 "%s : One Time Pad management to generate, encrypt, decrypt, assess and deny\n"
 
 #define VERB_FMT10 "%s : \"Encrypt Right\"/\"Enoch Root\"\n"
@@ -94,6 +126,8 @@
 #define VERB_FMT10b "(C)2021 Paul Rose <rose.apply@googlemail.com>\n"
 #define VERB_FMT11 "%s : v%s; libenoch : v%s\n\n"
 #define VERB_FMT12 "RNG device is %s\n"
+#define VERB_FMT12a "RNG output conditioned by %s\n"
+#define VERB_FMT12b "Page cache policy : %s\n"
 #define VERB_FMT13 "Command selected is %c : %s\n"
 #define VERB_FMT14 "Mode description :\n"
 #define VERB_FMT14a "Generate new OTP by size\n"
@@ -107,6 +141,10 @@
 #define VERB_FMT14g "Perform Pyx Assessment of input OTP (bitmode); detailed output to stdout\n"
 #define VERB_FMT14h "Perform Pyx Assessment of input OTP (bytemode); terse output to file\n"
 #define VERB_FMT14i "Perform Pyx Assessment of input OTP (bitmode); terse output to file\n"
+#define VERB_FMT14j "Serve E/D/G/P requests on a Unix socket until interrupted\n"
+#define VERB_FMT14k "Wipe the consumed (or first size bytes of) OTP in place\n"
+#define VERB_FMT14l "Carve the unused OTP into segments <output>.000 on\n"
+#define VERB_FMT14m "Join the unused data of several OTPs into one new OTP\n"
 #define VERB_FMT15 "\nInput fsp : <%s>\n"
 #define VERB_FMT16 "Output fsp : <%s>\n"
 #define VERB_FMT17 "Encrypted fsp <%s>\n"
@@ -114,11 +152,25 @@
 #define VERB_FMT19 "OTP size is <%s>\n"
 #define VERB_FMT20 "OTP fsp for plausible deniability : <%s>\n"
 #define VERB_FMT21 "OTP size for plausible deniability : <%s>\n"
+#define VERB_FMT21a "Socket fsp : <%s>\n"
+#define VERB_FMT22 "\nStatistics : %llu bytes in %.3f s (%.2f MB/s)\n"
+#define VERB_FMT23 "Time : RNG device %.3f s; file I/O %.3f s; compute %.3f s\n"
+#define VERB_FMT24 "%-10s : read %llu bytes in %llu calls; wrote %llu bytes in %llu calls; %.3f s\n"
+#define VERB_FMT25 "OTP container : ID %s; %llu bytes; %llu consumed; RNG device <%s>\n"
+#define VERB_FMT26 "OTP wiped : %llu bytes\n"
+#define VERB_FMT27 "OTP reflinked : %llu bytes (not copied)\n"
+#define VERB_FMT28 "Pyx results from cache : %llu pads (not read)\n"
+#define JSON_FMT1 "{\"cmd\":\"%c\",\"bytes\":%llu,\"total_seconds\":%.6f,\"rng_seconds\":%.6f,\"io_seconds\":%.6f,\"compute_seconds\":%.6f,\"throughput\":%.0f,\"streams\":{"
+#define JSON_FMT2 "%s\"%s\":{\"rbytes\":%llu,\"wbytes\":%llu,\"rcalls\":%llu,\"wcalls\":%llu,\"seconds\":%.6f}"
+#define JSON_FMT3 "}}\n"
 
 #define CMD_GENERATE "Generate"
 #define CMD_ENCRYPT "Encrypt"
 #define CMD_DECRYPT "Decrypt"
 #define CMD_PYX "Pyx Assessment"
+#define CMD_SERVE "Serve"
+#define CMD_WIPE "Wipe"
+#define CMD_CARVE "Carve"
 
 #define ERR_CLOSE "Error closing: "
 #define ERR_CLOSE_INPUT "Input fsp; "
@@ -130,8 +182,28 @@
 #define ERR_FOPEN_INPUT  "Can't open Input file specified (read)"
 #define ERR_FOPEN_OUTPUT "Can't open Output file specified (write)"
 #define ERR_FOPEN_OTP "Can't open OTP file specified"
+#define ERR_FOPEN_STRIPE "Can't open OTP stripe set (E/D/P/W; 2-16 pads, all containers or all raw)"
 #define ERR_FOPEN_ENCRYPTED "Can't open Encrypted dile specified"
 #define ERR_BINARY_SPECIFIED "Binary option only to be used with Pyx command"
+#define ERR_TRIPLES_SPECIFIED "Triple test option only to be used with Pyx command"
+#define ERR_LAGS_SPECIFIED "Autocorrelation option only to be used with Pyx command"
+#define ERR_RESUME_SPECIFIED "Resume option only to be used with Generate of a size"
+#define ERR_CHK_LAGS "Autocorrelation lags to be 1 to 65536"
+#define ERR_COMPRESS_SPECIFIED "Compress option only to be used with Encrypt/Pyx commands"
+#define ERR_RAW_SPECIFIED "Legacy OTP option only to be used with Generate/Carve commands"
+#define ERR_COUNT_SPECIFIED "Count option only to be used with Carve/Decrypt commands"
+#define ERR_CHK_CHUNKNO "Chunk number (-n) must be 1 or more"
+#define ERR_CHUNK_SPECIFIED "Chunk size option only to be used with Encrypt command"
+#define ERR_CHK_CHUNK "Chunk size (-q) must be a size BKMG"
+#define ERR_CHK_COUNT "Segment count (-n) must be 1 to 1000"
+#define ERR_AUTH_SPECIFIED "Authenticate option only to be used with Encrypt command"
+#define ERR_WIPE_SPECIFIED "Wipe option only to be used with Encrypt/Decrypt commands"
+#define ERR_REUSE_SPECIFIED "Reuse index option only to be used with Generate/Encrypt/Serve commands"
+#define ERR_PYXC_SPECIFIED "Pyx cache option only to be used with Pyx command"
+#define ERR_COND_SPECIFIED "Condition option only to be used with Generate/Encrypt commands"
+#define ERR_COND_NAME "Condition (-c) must be vn, xor, xor2 to xor8 or sha256"
+#define ERR_POLICY_SPECIFIED "Page cache policy only to be used with Generate/Encrypt/Decrypt/Pyx commands"
+#define ERR_POLICY_NAME "Page cache policy (-k or $" ENV_IO_POLICY ") must be cache, stream or direct"
 #define ERR_PADOTP_SPECIFIED "Fill OTP only to be used with Generate/plausible deniability command"
 #define ERR_CHK_DEV "Device specified cannot be opened"
 #define DEV_PREFIX_STR "/dev/"
@@ -141,6 +213,12 @@
 #define ERR_CHK_ECMD "Error : E (Encrypt) command usage is incorrect. Reference -h or manual"
 #define ERR_CHK_DCMD "Error : D (Decrypt) command usage is incorrect. Reference -h or manual"
 #define ERR_CHK_PCMD "Error : P (Pyx assessment) command usage is incorrect. Reference -h or manual"
+#define ERR_CHK_SCMD "Error : S (Serve) command usage is incorrect. Reference -h or manual"
+#define ERR_CHK_CCMD "Error : C (Carve) command usage is incorrect. Reference -h or manual"
+#define ERR_CHK_WCMD "Error : W (Wipe) command usage is incorrect. Reference -h or manual"
+#define ERR_PARAMSIZE_SOCK "Specified -u (socket) fsp is too long"
+#define ERR_PARAMSIZE_REUSE "Specified -x (reuse index) fsp is too long"
+#define ERR_PARAMSIZE_PYXC "Specified -y (Pyx cache) fsp is too long"
 #define ERR_CHK_ZCMD "Error : No valid command specified. Reference -h or manual"
 #define ERR_PARAMSIZE_INP "Specified -i (input) fsp is too long"
 #define ERR_PARAMSIZE_ENC "Specified -e (encrypted) fsp is too long"
@@ -155,33 +233,37 @@ extern char *optarg;
 extern int opterr, optind;
 
 void	verbose(int mode, char *ver, int cmd, char *progname, options_t *options);
+void	verbose_stream(const char *name, le_stream_t *stream, le_io_stats_t *st);
+void	stats_json(int cmd, options_t *options);
 int		validate_cli_multicmd(int opt, options_t *options, char *progname, int *cmd, int *onecmd, char *ver);
 int		validate_cli_options(int opt, options_t *options, char *progname, int *cmd, char *ver);
 int 	validate_cli_command(int cmd, options_t *options);
 void	usage(char *ver, char *progname);
 int		factor_suffix(options_t *options);
+int		io_policy_name(const char *name);
 int		tidy_up(FUNC *ptrfunc, options_t *options);
+void	serve_signals(void);
 
 int	main(int argc, char *argv[]) {
 	int opt, cmd, onecmd;
 	char ver[5];
 
-	FUNC *ptrfunc = (FUNC *)malloc(sizeof(FUNC) * 4);
+	FUNC *ptrfunc = (FUNC *)malloc(sizeof(FUNC) * 7);
 	
 	ptrfunc[0] = &g_generate;
     ptrfunc[1] = &e_encrypt;
 	ptrfunc[2] = &d_decrypt;
 	ptrfunc[3] = &p_pyx;
+	ptrfunc[4] = &s_serve;
+	ptrfunc[5] = &w_wipe;
+	ptrfunc[6] = &c_carve;
 
 	options_t options;
 	memset(&options, 0, sizeof(options));
 
-	options.input  = stdin;
-	options.output = stdout;
-	options.otp    = stdin;
-	options.encrypted = stdin;
 	options.cmd_index = ZCMD;
 	options.cmd_mode  = CMD_STD;
+	options.io_policy = -1;
 
 	opterr = onecmd = 0;
 	memset(options.devname,	'\0', DEV_PATH_MAX);
@@ -257,6 +339,9 @@ int	main(int argc, char *argv[]) {
 	else {
 		if (options.verbose == TRUE)
 			verbose(START, &(ver[0]), cmd, argv[0], &options);
+
+		if (options.cmd_index == SCMD)
+			serve_signals();
 			
 		if (ptrfunc[options.cmd_index](&options) != EXIT_SUCCESS) {
 			fprintf(stderr,"%s\n", options.errmsg);
@@ -269,6 +354,9 @@ int	main(int argc, char *argv[]) {
 
 		if (options.verbose == TRUE)
 			verbose(END, &(ver[0]), cmd, argv[0], &options);
+
+		if (options.stats_json == TRUE)
+			stats_json(cmd, &options);
 	}
 
 	if(tidy_up(ptrfunc, &options)!=EXIT_SUCCESS) {
@@ -281,6 +369,24 @@ int	main(int argc, char *argv[]) {
 	return(EXIT_SUCCESS);
 }
 
+void serve_stop(int sig)
+{
+	(void)sig;
+	le_serve_shutdown();
+}
+
+void serve_signals(void)
+{
+struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = serve_stop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+}
+
 int tidy_up(FUNC *ptrfunc, options_t *options) 
 {
 char compound_errors[ERR_MSG_MAXLEN];
@@ -289,25 +395,24 @@ char compound_errors[ERR_MSG_MAXLEN];
 	memset(options->errmsg,'\0', ERR_MSG_MAXLEN);
 	memset(compound_errors,'\0', ERR_MSG_MAXLEN);
 
-	if((options->input!=stdin)&&(options->input!=NULL))
-		if(fclose(options->input)==EOF)
-			strncat(compound_errors, ERR_CLOSE_INPUT, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
+	if(le_close(options->input)==-1)
+		strncat(compound_errors, ERR_CLOSE_INPUT, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
+
+	if(le_close(options->output)==-1)
+		strncat(compound_errors, ERR_CLOSE_OUTPUT, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
 
-	if((options->output!=stdout)&&(options->output!=NULL))
-		if(fclose(options->output)==EOF)
-			strncat(compound_errors, ERR_CLOSE_OUTPUT, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
+	if(le_close(options->otp)==-1)
+		strncat(compound_errors, ERR_CLOSE_OTP, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
 
-	if((options->otp!=stdin)&&(options->otp!=NULL))
-		if(fclose(options->otp)==EOF)
-			strncat(compound_errors, ERR_CLOSE_OTP, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
+	if(le_close(options->encrypted)==-1)
+		strncat(compound_errors, ERR_CLOSE_ENCRYPT, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
 
-	if((options->encrypted!=stdin)&&(options->encrypted!=NULL))
-		if(fclose(options->encrypted)==EOF)
-			strncat(compound_errors, ERR_CLOSE_ENCRYPT, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
+	options->input = options->output = options->otp = options->encrypted = NULL;
 
-	if(options->device >= 0)
-		if(close(options->device)==-1)
-			strncat(compound_errors, ERR_CLOSE_DEV, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
+	if(le_close(options->device)==-1)
+		strncat(compound_errors, ERR_CLOSE_DEV, ERR_MSG_MAXLEN - strlen(compound_errors) - 1);
+
+	options->device = NULL;
 
 	if(compound_errors[0]!='\0') {
 		snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CLOSE);
@@ -323,6 +428,8 @@ void verbose(int mode, char *ver, int cmd, char *progname, options_t *options)
 char desc[16];
 char mode_desc[81];
 char mode_desc2[40];
+char padid[33];
+int i;
 
 	memset(&(desc[0]),'\0', 16);
 	memset(&(mode_desc[0]),'\0', 81);
@@ -374,6 +481,27 @@ char mode_desc2[40];
 			}
 
 			break;
+
+		case 'S':
+			strncpy(&(desc[0]), CMD_SERVE, 16); 
+			strncpy(&(mode_desc[0]), VERB_FMT14j, 81); 
+
+			break;
+
+		case 'W':
+			strncpy(&(desc[0]), CMD_WIPE, 16); 
+			strncpy(&(mode_desc[0]), VERB_FMT14k, 81); 
+
+			break;
+
+		case 'C':
+			strncpy(&(desc[0]), CMD_CARVE, 16); 
+			if (strchr(options->otp_fsp, ',') == NULL)
+				strncpy(&(mode_desc[0]), VERB_FMT14l, 81); 
+			else
+				strncpy(&(mode_desc[0]), VERB_FMT14m, 81); 
+
+			break;
 	}
 
 	switch(mode) {
@@ -383,6 +511,10 @@ char mode_desc2[40];
 			fprintf(stdout, VERB_FMT10b);
 			fprintf(stdout, VERB_FMT11, progname?progname:DEFAULT_PROGNAME, ER_VERSION, ver);
 			fprintf(stdout, VERB_FMT12, options->devname);
+			if (options->condition != LE_COND_NONE)
+				fprintf(stdout, VERB_FMT12a, (options->condition == LE_COND_VN) ? "von Neumann" : (options->condition == LE_COND_XOR) ? "XOR fold" : "SHA-256");
+			if (options->io_policy > LE_IO_CACHE)
+				fprintf(stdout, VERB_FMT12b, (options->io_policy == LE_IO_STREAM) ? "stream" : "direct");
 			fprintf(stdout, VERB_FMT13, (char)cmd, &(desc[0]));
 			fprintf(stdout, VERB_FMT14);
 			fprintf(stdout, "%s", &(mode_desc[0]));
@@ -397,6 +529,8 @@ char mode_desc2[40];
 				fprintf(stdout, VERB_FMT16, options->output_fsp);
 			if(*options->encrypted_fsp!='\0')
 				fprintf(stdout, VERB_FMT17, options->encrypted_fsp);
+			if(*options->socket_fsp!='\0')
+				fprintf(stdout, VERB_FMT21a, options->socket_fsp);
 
 			if((cmd=='G')&&(options->cmd_mode==CMD_ALT)&&(*options->otp_fsp!='\0'))
 				fprintf(stdout, VERB_FMT20, options->otp_fsp);
@@ -406,12 +540,63 @@ char mode_desc2[40];
 
 			if(*options->sizestr!='\0')
 				fprintf(stdout, VERB_FMT19, options->sizestr);
+
+			if(options->pad.hdrlen) {
+				for (i = 0; i < (int) sizeof(options->pad.id); i++)
+					snprintf(&padid[2 * i], 3, "%02x", options->pad.id[i]);
+				fprintf(stdout, VERB_FMT25, padid, options->pad.length, options->pad.consumed, options->pad.device);
+			}
+
+			if(options->stats.wiped)
+				fprintf(stdout, VERB_FMT26, options->stats.wiped);
+
+			if(options->stats.cloned)
+				fprintf(stdout, VERB_FMT27, options->stats.cloned);
+
+			if(options->stats.cached)
+				fprintf(stdout, VERB_FMT28, options->stats.cached);
+
+			fprintf(stdout, VERB_FMT22, options->stats.bytes, options->stats.total_seconds, options->stats.throughput / 1048576.0);
+			fprintf(stdout, VERB_FMT23, options->stats.rng_seconds, options->stats.io_seconds, options->stats.compute_seconds);
+			verbose_stream("Input", options->input, &options->stats.input);
+			verbose_stream("Output", options->output, &options->stats.output);
+			verbose_stream("OTP", options->otp, &options->stats.otp);
+			verbose_stream("Encrypted", options->encrypted, &options->stats.encrypted);
+			verbose_stream("RNG device", options->device, &options->stats.device);
 		
 			break;
 
 	}
 }
 
+void verbose_stream(const char *name, le_stream_t *stream, le_io_stats_t *st)
+{
+	if (stream != NULL)
+		fprintf(stdout, VERB_FMT24, name, st->rbytes, st->rcalls, st->wbytes, st->wcalls, st->seconds);
+}
+
+void stats_json(int cmd, options_t *options)
+{
+const char *names[] = { "input", "output", "otp", "encrypted", "device" };
+le_stream_t *streams[5];
+le_io_stats_t *st[5];
+int i, first;
+
+	streams[0] = options->input;		st[0] = &options->stats.input;
+	streams[1] = options->output;		st[1] = &options->stats.output;
+	streams[2] = options->otp;			st[2] = &options->stats.otp;
+	streams[3] = options->encrypted;	st[3] = &options->stats.encrypted;
+	streams[4] = options->device;		st[4] = &options->stats.device;
+
+	fprintf(stdout, JSON_FMT1, (char)cmd, options->stats.bytes, options->stats.total_seconds, options->stats.rng_seconds, options->stats.io_seconds, options->stats.compute_seconds, options->stats.throughput);
+	for (i = 0, first = TRUE; i < 5; i++)
+		if (streams[i] != NULL) {
+			fprintf(stdout, JSON_FMT2, first ? "" : ",", names[i], st[i]->rbytes, st[i]->wbytes, st[i]->rcalls, st[i]->wcalls, st[i]->seconds);
+			first = FALSE;
+		}
+	fprintf(stdout, JSON_FMT3);
+}
+
 int validate_cli_multicmd(int opt, options_t *options, char *progname, int *cmd, int *onecmd, char *ver) {
 
 	switch(opt) {
@@ -419,6 +604,9 @@ int validate_cli_multicmd(int opt, options_t *options, char *progname, int *cmd,
 		case 'E':
 		case 'D':
 		case 'P':
+		case 'S':
+		case 'W':
+		case 'C':
 			*cmd=opt;
 			if (++(*onecmd)>1) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_MULTICMD);
@@ -439,12 +627,22 @@ int validate_cli_multicmd(int opt, options_t *options, char *progname, int *cmd,
 		case 'e':
 			break;
 
+		case 'u':
+			break;
+
 		case 'v':
 			break;
 
 		case 'b':
 			break;
 
+		case 't':
+			break;
+
+		case 'd':
+			options->resume = TRUE;		/* known before -p opens the OTP */
+			break;
+
 		case 'r':
 			break;
 
@@ -454,6 +652,45 @@ int validate_cli_multicmd(int opt, options_t *options, char *progname, int *cmd,
 		case 'f':
 			break;
 
+		case 'j':
+			break;
+
+		case 'm':
+			break;
+
+		case 'z':
+			break;
+
+		case 'l':
+			break;
+
+		case 'a':
+			break;
+
+		case 'w':
+			break;
+
+		case 'c':
+			break;
+
+		case 'x':
+			break;
+
+		case 'n':
+			break;
+
+		case 'q':
+			break;
+
+		case 'k':
+			break;
+
+		case 'y':
+			break;
+
+		case 'g':
+			break;
+
 		case 'h':
 		default:
 			usage(ver, basename(progname));
@@ -467,6 +704,7 @@ int validate_cli_multicmd(int opt, options_t *options, char *progname, int *cmd,
 int validate_cli_options(int opt, options_t *options, char *progname, int *cmd, char *ver) {
 struct stat st;
 size_t len;
+char *end;
 	switch(opt) {
 		case 'i':
 			if (strlen(optarg)>MAX_FSP_PATH) {
@@ -474,7 +712,7 @@ size_t len;
 				return(EXIT_FAILURE);
 			}
 
-			if (!(options->input = fopen(optarg, "r")) ) {
+			if (!(options->input = le_open_file(optarg, O_RDONLY)) ) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_FOPEN_INPUT);
 				return(EXIT_FAILURE);
 			}
@@ -487,7 +725,14 @@ size_t len;
 				return(EXIT_FAILURE);
 			}
 
-			if (!(options->output = fopen(optarg, "w")) ) {
+			/* C opens its outputs itself, a prefix when carving */
+
+			if (*cmd==(int)'C') {
+				snprintf(options->output_fsp, MAX_FSP_PATH, "%s", optarg);
+				break;
+			}
+
+			if (!(options->output = le_open_file(optarg, O_WRONLY | O_CREAT | O_TRUNC)) ) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_FOPEN_OUTPUT);
 				return(EXIT_FAILURE);
 			}
@@ -500,18 +745,46 @@ size_t len;
 				return(EXIT_FAILURE);
 			}
 
-			if (*cmd==(int)'E'&&(options->otp = fopen(optarg, "r"))) {
+			if (*cmd==(int)'C') {
 				snprintf(options->otp_fsp, MAX_FSP_PATH, "%s", optarg);
 				break;
-			} else
-				if (*cmd==(int)'E'&&(options->otp = fopen(optarg, "w"))) {
-					options->cmd_mode=CMD_ALT;
-					snprintf(options->otp_fsp, MAX_FSP_PATH, "%s", optarg);
-					break;
+			}
+
+			/* P of a directory, a glob or an @list assesses every pad in it */
+
+			if ((*cmd==(int)'P')&&((optarg[0]=='@')||(strpbrk(optarg, "*?[") != NULL)||((stat(optarg, &st) == 0)&&S_ISDIR(st.st_mode)))) {
+				snprintf(options->otp_fsp, MAX_FSP_PATH, "%s", optarg);
+				break;
+			}
+
+			if (strchr(optarg, ',') != NULL) {
+				if (((*cmd!=(int)'E')&&(*cmd!=(int)'D')&&(*cmd!=(int)'P')&&(*cmd!=(int)'W'))
+					|| !(options->otp = le_open_stripe(optarg, LE_STRIPE_WIDTH))) {
+					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_FOPEN_STRIPE);
+					return(EXIT_FAILURE);
 				}
+				snprintf(options->otp_fsp, MAX_FSP_PATH, "%s", optarg);
+				break;
+			}
+
+			/* E uses an existing pad, or makes a new one; an existing pad is never truncated */
+
+			if (*cmd==(int)'E') {
+				if (stat(optarg, &st) == 0)
+					options->otp = le_open_mmap(optarg);
+				else
+					if ((options->otp = le_open_file(optarg, O_WRONLY | O_CREAT | O_EXCL)))
+						options->cmd_mode=CMD_ALT;
+				if (!options->otp) {
+					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_FOPEN_OTP);
+					return(EXIT_FAILURE);
+				}
+				snprintf(options->otp_fsp, MAX_FSP_PATH, "%s", optarg);
+				break;
+			}
 
 			if (*cmd==(int)'G'&&(options->sizestr[0]!='\0')) {
-				if (!(options->otp = fopen(optarg, "w")) ) {
+				if (!(options->otp = le_open_file(optarg, options->resume ? (O_RDWR | O_CREAT) : (O_WRONLY | O_CREAT | O_TRUNC))) ) {
 					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_FOPEN_OTP);
 					return(EXIT_FAILURE);
 				}
@@ -519,13 +792,13 @@ size_t len;
 				break;
 			}
 			else
-				if (*cmd==(int)'G'&&(options->otp = fopen(optarg, "w"))) {
+				if (*cmd==(int)'G'&&(options->otp = le_open_file(optarg, O_WRONLY | O_CREAT | O_TRUNC))) {
 					options->cmd_mode=CMD_ALT;
 					snprintf(options->otp_fsp, MAX_FSP_PATH, "%s", optarg);
 					break;
 				}
 
-			if (!(options->otp = fopen(optarg, "r")) ) {
+			if (!(options->otp = le_open_mmap(optarg)) ) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_FOPEN_OTP);
 				return(EXIT_FAILURE);
 			}
@@ -538,17 +811,29 @@ size_t len;
 				return(EXIT_FAILURE);
 			}
 
-			if (!(options->encrypted = fopen(optarg, "r")) ) {
+			if (!(options->encrypted = le_open_file(optarg, O_RDONLY)) ) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_FOPEN_ENCRYPTED);
 				return(EXIT_FAILURE);
 			}
 			snprintf(options->encrypted_fsp, MAX_FSP_PATH, "%s", optarg);
 			break;
 			
+		case 'u':
+			if (strlen(optarg)>=MAX_FSP_PATH) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_PARAMSIZE_SOCK);
+				return(EXIT_FAILURE);
+			}
+
+			snprintf(options->socket_fsp, MAX_FSP_PATH, "%s", optarg);
+			break;
+
 		case 'G':
 		case 'E':
 		case 'D':
 		case 'P':
+		case 'S':
+		case 'W':
+		case 'C':
 
 			break;
 
@@ -556,6 +841,168 @@ size_t len;
 			options->verbose = TRUE;
 			break;
 
+		case 'j':
+			options->stats_json = TRUE;
+			break;
+
+		case 'm':
+			le_pool_config(LE_POOL_THP | LE_POOL_HUGETLB | LE_POOL_MLOCK);
+			break;
+
+		case 'z':
+			if ((*cmd!=(int)'E')&&(*cmd!=(int)'P')) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_COMPRESS_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			if (*cmd==(int)'P')
+				options->pyx_lz = TRUE;
+			else
+				options->compress = TRUE;
+			break;
+
+		case 'l':
+			if ((*cmd!=(int)'G')&&(*cmd!=(int)'C')) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_RAW_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			options->pad_raw = TRUE;
+			break;
+
+		case 'a':
+			if (*cmd!=(int)'E') {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_AUTH_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			options->auth = TRUE;
+			break;
+
+		case 'w':
+			if ((*cmd!=(int)'E')&&(*cmd!=(int)'D')) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_WIPE_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			options->wipe = TRUE;
+			break;
+
+		case 'c':
+			if ((*cmd!=(int)'G')&&(*cmd!=(int)'E')) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_COND_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			if (strcmp(optarg, "vn") == 0)
+				options->condition = LE_COND_VN;
+			else if (strcmp(optarg, "sha256") == 0)
+				options->condition = LE_COND_SHA256;
+			else if ((strncmp(optarg, "xor", 3) == 0) && ((optarg[3] == '\0')
+				|| ((optarg[3] >= '2') && (optarg[3] <= '0' + LE_COND_FOLD_MAX) && (optarg[4] == '\0')))) {
+				options->condition = LE_COND_XOR;
+				options->fold = (optarg[3] == '\0') ? LE_COND_FOLD : optarg[3] - '0';
+			}
+			else {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_COND_NAME);
+				return(EXIT_FAILURE);
+			}
+			break;
+
+		case 'x':
+			if ((*cmd!=(int)'G')&&(*cmd!=(int)'E')&&(*cmd!=(int)'S')) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_REUSE_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			if (strlen(optarg)>=MAX_FSP_PATH) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_PARAMSIZE_REUSE);
+				return(EXIT_FAILURE);
+			}
+			snprintf(options->reuse_fsp, MAX_FSP_PATH, "%s", optarg);
+			break;
+
+		case 'n':
+			if (*cmd==(int)'D') {
+				options->chunk_no = strtoull(optarg, &end, 10);
+				if ((options->chunk_no < 1) || (*end!='\0')) {
+					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_CHUNKNO);
+					return(EXIT_FAILURE);
+				}
+				break;
+			}
+			if (*cmd!=(int)'C') {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_COUNT_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			options->segments = atoi(optarg);
+			if ((options->segments < 1) || (options->segments > 1000)) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_COUNT);
+				return(EXIT_FAILURE);
+			}
+			break;
+
+		case 'q':
+			if (*cmd!=(int)'E') {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHUNK_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			options->chunk = strtoull(optarg, &end, 10);
+			switch ((char)toupper(*end)) {
+				case 'K':
+				options->chunk*=1024;
+				end++;
+				break;
+
+				case 'M':
+				options->chunk*=1048576;
+				end++;
+				break;
+
+				case 'G':
+				options->chunk*=1073741824;
+				end++;
+				break;
+
+				case 'B':
+				end++;
+				break;
+			}
+			if ((options->chunk == 0) || (*end!='\0')) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_CHUNK);
+				return(EXIT_FAILURE);
+			}
+			break;
+
+		case 'k':
+			if ((*cmd!=(int)'G')&&(*cmd!=(int)'E')&&(*cmd!=(int)'D')&&(*cmd!=(int)'P')) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_POLICY_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			if ((options->io_policy = io_policy_name(optarg)) < 0) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_POLICY_NAME);
+				return(EXIT_FAILURE);
+			}
+			break;
+
+		case 'y':
+			if (*cmd!=(int)'P') {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_PYXC_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			if (strlen(optarg)>=MAX_FSP_PATH) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_PARAMSIZE_PYXC);
+				return(EXIT_FAILURE);
+			}
+			snprintf(options->pyx_cache_fsp, MAX_FSP_PATH, "%s", optarg);
+			break;
+
+		case 'g':
+			if (*cmd!=(int)'P') {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_LAGS_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			options->pyx_lags = atoi(optarg);
+			if ((options->pyx_lags < 1) || (options->pyx_lags > 65536)) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_LAGS);
+				return(EXIT_FAILURE);
+			}
+			break;
+
 		case 'b':
 			if (*cmd!=(int)'P') {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_BINARY_SPECIFIED);
@@ -564,6 +1011,21 @@ size_t len;
 			options->pyx_binary = TRUE;
 			break;
 
+		case 't':
+			if (*cmd!=(int)'P') {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_TRIPLES_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			options->pyx_triples = TRUE;
+			break;
+
+		case 'd':
+			if (*cmd!=(int)'G') {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_RESUME_SPECIFIED);
+				return(EXIT_FAILURE);
+			}
+			break;
+
 		case 'r':
     			if (optarg == NULL) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_DEV);
@@ -589,14 +1051,14 @@ size_t len;
 				}
 			}
 
-			options->device = open(options->devname, O_RDONLY | O_CLOEXEC);
+			options->device = le_open_device(options->devname);
 
-    			if (options->device < 0 ) {
+    			if (options->device == NULL ) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_DEV);
         			return(EXIT_FAILURE);
     			}
 
-			if (fstat(options->device, &st) != 0 || !S_ISCHR(st.st_mode)) {
+			if (fstat(options->device->fd, &st) != 0 || !S_ISCHR(st.st_mode)) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_DEV);
         			return(EXIT_FAILURE);
 			}
@@ -631,22 +1093,90 @@ size_t len;
 }
 
 int	validate_cli_command(int cmd, options_t *options) {
+char *reuse, *policy, *cache;
+
+	/* G, E and S keep the reuse index named in the environment unless -x names one */
+
+	if (((cmd=='G')||(cmd=='E')||(cmd=='S'))&&(options->reuse_fsp[0]=='\0')&&((reuse = getenv(ENV_REUSE_INDEX))!=NULL)) {
+		if (strlen(reuse)>=MAX_FSP_PATH) {
+			snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_PARAMSIZE_REUSE);
+			return(EXIT_FAILURE);
+		}
+		snprintf(options->reuse_fsp, MAX_FSP_PATH, "%s", reuse);
+	}
+
+	/* P keeps its results in the cache named in the environment unless -y names one */
+
+	if ((cmd=='P')&&(options->pyx_cache_fsp[0]=='\0')&&((cache = getenv(ENV_PYX_CACHE))!=NULL)) {
+		if (strlen(cache)>=MAX_FSP_PATH) {
+			snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_PARAMSIZE_PYXC);
+			return(EXIT_FAILURE);
+		}
+		snprintf(options->pyx_cache_fsp, MAX_FSP_PATH, "%s", cache);
+	}
+
+	/* G, E, D and P take the page cache policy from the environment unless -k sets one */
+
+	if (options->io_policy < 0) {
+		options->io_policy = LE_IO_CACHE;
+		if (((cmd=='G')||(cmd=='E')||(cmd=='D')||(cmd=='P'))&&((policy = getenv(ENV_IO_POLICY))!=NULL)&&(policy[0]!='\0')
+			&&((options->io_policy = io_policy_name(policy)) < 0)) {
+			snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_POLICY_NAME);
+			return(EXIT_FAILURE);
+		}
+	}
+
+	if ((cmd!='S')&&(options->socket_fsp[0]!='\0')) {
+		snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_SCMD);
+		return(EXIT_FAILURE);
+	}
 
 	switch(cmd) {
+		case 'S':
+			if ((options->socket_fsp[0]=='\0')||(options->input!=NULL)||(options->output!=NULL)||(options->otp!=NULL)||(options->encrypted!=NULL)) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_SCMD);
+				return(EXIT_FAILURE);
+			}
+
+			options->cmd_index = SCMD;
+
+			break;
+
+		case 'C':
+			if ((options->otp_fsp[0]=='\0')||(options->output_fsp[0]=='\0')||(options->input!=NULL)||(options->encrypted!=NULL)
+				||((strchr(options->otp_fsp, ',')!=NULL) ? ((options->sizestr[0]!='\0')||(options->segments!=0)) : ((options->sizestr[0]!='\0')==(options->segments!=0)))) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_CCMD);
+				return(EXIT_FAILURE);
+			}
+
+			options->cmd_index = CCMD;
+
+			break;
+
+		case 'W':
+			if ((options->otp==NULL)||(options->input!=NULL)||(options->output!=NULL)||(options->encrypted!=NULL)) {
+				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_WCMD);
+				return(EXIT_FAILURE);
+			}
+
+			options->cmd_index = WCMD;
+
+			break;
+
 		case 'P':
-			if ((options->input!=stdin)||(options->otp==stdin)||(options->encrypted!=stdin)) {
+			if ((options->input!=NULL)||((options->otp==NULL)&&(options->otp_fsp[0]=='\0'))||(options->encrypted!=NULL)) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_PCMD);
 				return(EXIT_FAILURE);
 			}
 
 			options->cmd_index = PCMD;
-			if (options->output!=stdout)
+			if (options->output!=NULL)
 				options->cmd_mode=CMD_ALT;
 
 			break;
 
 		case 'D':
-			if (((options->input==stdin)||(options->otp==stdin)||(options->output==stdout))||(options->encrypted!=stdin)) {
+			if (((options->input==NULL)||(options->otp==NULL)||(options->output==NULL))||(options->encrypted!=NULL)) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_DCMD);
 				return(EXIT_FAILURE);
 			}
@@ -656,7 +1186,7 @@ int	validate_cli_command(int cmd, options_t *options) {
 			break;
 
 		case 'E':
-			if ((options->input==stdin)||(options->output==stdout)||(options->otp==stdin)) {
+			if ((options->input==NULL)||(options->output==NULL)||(options->otp==NULL)) {
 				snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_ECMD);
 				return(EXIT_FAILURE);
 			}
@@ -669,21 +1199,25 @@ int	validate_cli_command(int cmd, options_t *options) {
 
 		case 'G':
 			if (options->sizestr[0]!='\0') {
-				if (options->otp==stdin) {
+				if (options->otp==NULL) {
 					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_GCMD);
 					return(EXIT_FAILURE);
 				}
 
-				if ((options->output!=stdout)||(options->encrypted!=stdin)||(options->input!=stdin)) {
+				if ((options->output!=NULL)||(options->encrypted!=NULL)||(options->input!=NULL)) {
 					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_GCMD);
 					return(EXIT_FAILURE);
 				}
 			}
 			else {
-				if ((options->input==stdin)||(options->encrypted==stdin)||(options->otp==stdin)||(options->output!=stdout)) {
+				if ((options->input==NULL)||(options->encrypted==NULL)||(options->otp==NULL)||(options->output!=NULL)) {
 					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_CHK_GCMD);
 					return(EXIT_FAILURE);
 				}
+				if (options->resume) {
+					snprintf(options->errmsg, ERR_MSG_MAXLEN, "%s", ERR_RESUME_SPECIFIED);
+					return(EXIT_FAILURE);
+				}
 				options->cmd_mode=CMD_ALT;
 			}
 
@@ -702,6 +1236,9 @@ void usage(char *ver, char *progname) {
 	fprintf(stdout, USAGE_FMT3);
 	fprintf(stdout, USAGE_FMT4);
 	fprintf(stdout, USAGE_FMT5);
+	fprintf(stdout, USAGE_FMT5a);
+	fprintf(stdout, USAGE_FMT5b);
+	fprintf(stdout, USAGE_FMT5c);
 	fprintf(stdout, USAGE_FMT6);
 	fprintf(stdout, USAGE_FMT7, progname?progname:DEFAULT_PROGNAME);
 }
@@ -732,3 +1269,14 @@ int factor;
 
 	return(EXIT_SUCCESS);
 }
+
+int io_policy_name(const char *name) {
+
+	if (strcmp(name, "cache") == 0)
+		return(LE_IO_CACHE);
+	if (strcmp(name, "stream") == 0)
+		return(LE_IO_STREAM);
+	if (strcmp(name, "direct") == 0)
+		return(LE_IO_DIRECT);
+	return(-1);
+}
@@ -26,6 +26,103 @@
 #define ERR_MSG_MAXLEN	80
 #define ERR_MSG_SUFFIX	66
 #define MAX_FSP_PATH	128
+#define LE_POOL_THP		1
+#define LE_POOL_HUGETLB	2
+#define LE_POOL_MLOCK	4
+#define LE_PAD_PYX		1
+#define LE_STRIPE_WIDTH	1048576		/* default stripe unit */
+#define LE_COND_NONE	0			/* device bytes used as read */
+#define LE_COND_VN		1			/* von Neumann debiasing */
+#define LE_COND_XOR		2			/* XOR fold of fold device bytes */
+#define LE_COND_SHA256	3			/* SHA-256 compression, 64 bytes to 32 */
+#define LE_COND_FOLD	2			/* default and ... */
+#define LE_COND_FOLD_MAX 8			/* ... largest XOR fold */
+#define LE_IO_CACHE		0			/* page cache used as the kernel sees fit */
+#define LE_IO_STREAM	1			/* readahead, release behind the cursor */
+#define LE_IO_DIRECT	2			/* O_DIRECT reads, else LE_IO_STREAM */
+
+typedef struct le_stream le_stream_t;
+
+typedef struct {
+	unsigned long long		rbytes;		/* bytes read */
+	unsigned long long		wbytes;		/* bytes written */
+	unsigned long long		rcalls;		/* backend read calls (syscalls for fd/device) */
+	unsigned long long		wcalls;		/* backend write calls */
+	double					seconds;	/* time spent inside the backend */
+} le_io_stats_t;
+
+typedef struct {
+	le_io_stats_t			input;
+	le_io_stats_t			output;
+	le_io_stats_t			otp;
+	le_io_stats_t			encrypted;
+	le_io_stats_t			device;
+	unsigned long long		bytes;		/* payload bytes processed */
+	unsigned long long		wiped;		/* OTP bytes wiped by W, or by E and D with wipe */
+	unsigned long long		cloned;		/* C: bytes shared by reflink rather than copied */
+	unsigned long long		cached;		/* P: pads answered from the Pyx result cache */
+	double					rng_seconds;	/* waiting on the RNG device */
+	double					io_seconds;		/* file and stream I/O */
+	double					compute_seconds;	/* XOR, Pyx accumulation, overhead */
+	double					total_seconds;
+	double					throughput;	/* payload bytes per second */
+} le_stats_t;
+
+typedef struct {
+	const char	*name;
+	ssize_t		(*read)(le_stream_t *stream, void *buf, size_t len);
+	ssize_t		(*write)(le_stream_t *stream, const void *buf, size_t len);
+	ssize_t		(*pread)(le_stream_t *stream, void *buf, size_t len, unsigned long long offset);
+	long long	(*size)(le_stream_t *stream);
+	int			(*close)(le_stream_t *stream);
+} le_stream_ops_t;
+
+struct le_stream {
+	const le_stream_ops_t	*ops;
+	void					*handle;	/* custom backend state */
+	FILE					*fp;		/* stdio backend */
+	int						fd;			/* fd, device and mmap backends */
+	int						owned;		/* close/free the underlying resource */
+	unsigned char			*base;		/* mmap and memory backends */
+	unsigned long long		length;
+	unsigned long long		capacity;
+	unsigned long long		offset;		/* current read/write position */
+	le_io_stats_t			stats;		/* reset at the start of each command */
+	int						bounded;	/* reads limited to remain bytes */
+	unsigned long long		remain;
+	unsigned long long		position;	/* bytes from the start (or last le_seek) */
+	int						policy;		/* LE_IO_ page cache policy, see io_policy */
+	unsigned long long		ahead;		/* readahead requested up to */
+	unsigned long long		synced;		/* writeback started up to */
+	unsigned long long		dropped;	/* page cache released up to */
+	unsigned long long		written;	/* bytes written through le_write */
+	const char				*role;		/* "input", "otp"... while a command runs, for probes */
+};
+
+typedef struct {
+	unsigned char			id[16];		/* random pad ID */
+	unsigned int			flags;		/* LE_PAD_PYX when the summary is set */
+	unsigned int			hdrlen;		/* data offset; 0 for a legacy raw pad */
+	unsigned int			block_size;	/* data bytes per index checksum */
+	unsigned long long		length;		/* pad data bytes */
+	unsigned long long		consumed;	/* data bytes already used by E */
+	unsigned long long		created;	/* seconds since the epoch */
+	unsigned long long		index_offset;
+	char					device[32];	/* RNG device used by G */
+	double					ent, chisq, mean, montepi, scc;	/* Pyx summary */
+} le_pad_t;
+
+typedef struct le_job le_job_t;
+
+typedef struct {
+	unsigned long long	done;		/* bytes processed so far */
+	unsigned long long	total;		/* bytes expected, 0 when unknown */
+	double				elapsed;	/* seconds since the job started */
+	double				rate;		/* bytes per second */
+	double				eta;		/* seconds remaining, -1 when unknown */
+} le_progress_t;
+
+typedef void (*le_progress_fn)(const le_progress_t *progress, void *arg);
 
 typedef struct {
 	int						verbose;
@@ -37,17 +134,47 @@ typedef struct {
 	int						cmd_mode;
 	int						pyx_binary;
 	int						padout_pdotp;
-	FILE					*input;
-	FILE					*output;
-	FILE					*otp;
-	FILE					*encrypted;
-	int						device;
+	le_stream_t				*input;
+	le_stream_t				*output;
+	le_stream_t				*otp;
+	le_stream_t				*encrypted;
+	le_stream_t				*device;
 	char					input_fsp[MAX_FSP_PATH];
 	char					output_fsp[MAX_FSP_PATH];
 	char					otp_fsp[MAX_FSP_PATH];
 	char					encrypted_fsp[MAX_FSP_PATH];
+	le_job_t				*job;		/* set while run by le_job_start */
+	int						stats_json;
+	le_stats_t				stats;		/* filled by every command */
+	char					socket_fsp[MAX_FSP_PATH];
+	int						compress;	/* E: LZ compress the clear input before XOR */
+	le_pad_t				pad;		/* OTP container header, set by G, E, D and P */
+	int						pad_raw;	/* G: write a legacy raw pad */
+	int						auth;		/* E: append a one-time MAC */
+	int						wipe;		/* E, D: wipe the OTP bytes used */
+	int						condition;	/* G, E: extractor on device output (LE_COND_) */
+	int						fold;		/* LE_COND_XOR: device bytes per output byte */
+	char					reuse_fsp[MAX_FSP_PATH];	/* G, E: pad reuse index, "" for none */
+	int						segments;	/* C: segments to carve, 0 to cut by size */
+	int						io_policy;	/* G, E, D, P: page cache policy (LE_IO_) */
+	char					pyx_cache_fsp[MAX_FSP_PATH];	/* P: Pyx result cache, "" for none */
+	int						pyx_triples;	/* P: byte triple serial test too */
+	int						pyx_lags;	/* P: autocorrelation lags, 0 for none */
+	int						resume;		/* G: checkpoint, continue an interrupted pad */
+	unsigned long long		chunk;		/* E: clear bytes per chunk, 0 for no chunk index */
+	unsigned long long		chunk_no;	/* D: the one chunk to decrypt (from 1), 0 for all */
+	int						pyx_lz;		/* P: LZ compressibility test too */
 } options_t;
 
+typedef struct {
+	unsigned int			magic;		/* LE_SERVE_MAGIC */
+	unsigned char			op;			/* request: 'E', 'D', 'G', 'P'; reply: echoed */
+	unsigned char			flags;		/* request: LE_SERVE_BINARY; reply: 0 ok, 1 failed */
+	unsigned short			pathlen;	/* pad path bytes following the header */
+	unsigned long long		offset;		/* pad offset for D; E reply: offset used */
+	unsigned long long		length;		/* payload bytes following the path (G: bytes wanted) */
+} le_msg_t;
+
 typedef int (*FUNC)(options_t *options);
 
 extern int set_default_device(options_t *options);
@@ -55,5 +182,42 @@ extern int g_generate(options_t *options);
 extern int e_encrypt(options_t *options);
 extern int d_decrypt(options_t *options);
 extern int p_pyx(options_t *options);
+extern int s_serve(options_t *options);
+extern int w_wipe(options_t *options);
+extern int c_carve(options_t *options);
+extern void le_serve_shutdown(void);
+extern int le_connect(const char *fsp);
+extern int le_call(int sock, le_msg_t *msg, const char *pad_fsp, const void *payload, void *reply, size_t reply_max);
 
 extern int enoch(char *version);
+
+extern le_stream_t *le_open_custom(const le_stream_ops_t *ops, void *handle);
+extern le_stream_t *le_open_stdio(FILE *fp, int owned);
+extern le_stream_t *le_open_fd(int fd, int owned);
+extern le_stream_t *le_open_file(const char *fsp, int flags);
+extern le_stream_t *le_open_mmap(const char *fsp);
+extern le_stream_t *le_open_stripe(const char *fsps, unsigned long long width);
+extern le_stream_t *le_open_mem(void *buf, size_t len, size_t capacity);
+extern le_stream_t *le_open_device(const char *devname);
+extern int le_close(le_stream_t *stream);
+extern ssize_t le_read(le_stream_t *stream, void *buf, size_t len);
+extern ssize_t le_write(le_stream_t *stream, const void *buf, size_t len);
+extern ssize_t le_pread(le_stream_t *stream, void *buf, size_t len, unsigned long long offset);
+extern long long le_size(le_stream_t *stream);
+extern int le_seek(le_stream_t *stream, unsigned long long offset);
+extern int le_printf(le_stream_t *stream, const char *fmt, ...);
+
+extern le_job_t *le_job_start(FUNC func, options_t *options, le_progress_fn callback, void *arg, double interval);
+extern void le_job_cancel(le_job_t *job);
+extern int le_job_finished(le_job_t *job);
+extern void le_job_progress(le_job_t *job, le_progress_t *progress);
+extern int le_job_wait(le_job_t *job);
+extern void le_pool_config(int flags);
+extern void *le_buf_get(size_t size);
+extern void le_buf_put(void *buf);
+extern int le_pool_release(void);
+extern int le_pad_read(le_stream_t *stream, le_pad_t *pad);
+extern int le_pad_info(const char *fsp, le_pad_t *pad);
+extern int le_pad_seek(le_stream_t *stream, const le_pad_t *pad, unsigned long long offset);
+extern int le_pad_check_block(le_stream_t *stream, const le_pad_t *pad, unsigned long long n);
+extern int le_pad_verify(le_stream_t *stream, const le_pad_t *pad, int threads, unsigned long long *bad);
@@ -22,6 +22,8 @@
  */
 
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -29,10 +31,34 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <dirent.h>
+#include <glob.h>
+#include <poll.h>
+#include <signal.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if !defined(LE_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define LE_HAVE_SDT		1
+#endif
+#endif
 
-#define LE_VERSION		"0.1"
+#define LE_VERSION		"0.2"
 #define FALSE 			0
 #define TRUE  			1
 #define log2of10 		3.32192809488736234787
@@ -41,6 +67,7 @@
 #define	I_SQRT_PI		0.5641895835477562869480795 /* 1 / sqrt (pi) */
 #define	BIGX			20.0         /* max value to represent exp (x) */
 #define	ex(x)			(((x) < -BIGX) ? 0.0 : exp(x))
+#define	WH_DF			1000		/* above, pochisq uses Wilson-Hilferty */
 #define MONTEN			6		/* Bytes used as Monte Carlo
 								co-ordinates. This should be no more
 								bits than the mantissa of your
@@ -60,6 +87,9 @@
 #define ERR_READ_STAT	"Error reading encrypted file statistics"
 #define ERR_OTP_STAT	"Error reading OTP file statistics"
 #define ERR_GET_DEV 	"Error reading RNG device"
+#define ERR_HEALTH_RCT	"RNG device failed its repetition count health test"
+#define ERR_HEALTH_APT	"RNG device failed its adaptive proportion health test"
+#define ERR_COND_YIELD	"RNG device output too biased to condition"
 #define ERR_ENC_SHORT 	"Encrypted file is too short"
 #define ERR_ENC_SIZE 	"Size specified is larger than input encrypted file"
 #define ERR_OTP_SIZE 	"Size specified is larger than OTP file"
@@ -67,10 +97,242 @@
 #define ERR_WRITE_ENC 	"Error writing encrypted file"
 #define ERR_OTP_SHORT 	"Warning - OTP file is short for input encrypted file"
 #define ERR_WRITE_DEC 	"Error writing decrypted file"
+#define ERR_READ_OTP 	"Error reading OTP file"
+#define ERR_BLOCK_ALLOC	"Error allocating I/O block buffers"
+#define ERR_CANCELLED	"Operation cancelled"
+#define ERR_CT_FLAGS	"Encrypted file uses unsupported container features"
+#define ERR_PD_PLAIN	"A PD OTP can only be fitted to plain ciphertext"
+#define ERR_CT_CORRUPT	"Encrypted file is corrupt or does not match the OTP"
+#define ERR_PAD_HEADER	"OTP file header is corrupt"
+#define ERR_PAD_UPDATE	"Can't update the OTP file consumed offset"
+#define ERR_PAD_ID		"Encrypted file was not made with this OTP file"
+#define ERR_PAD_BLOCK	"OTP file block %llu fails its checksum"
+#define ERR_WIPE_OPEN	"Can't open OTP file for wiping"
+#define ERR_WIPE_WRITE	"Error wiping OTP file"
+#define ERR_CARVE_OPEN	"Can't open and lock the OTP files to carve"
+#define ERR_CARVE_SIZE	"Segment size or count does not fit the unused OTP"
+#define ERR_CARVE_WRITE	"Error writing OTP segment"
+#define ERR_CARVE_RAW	"Only container OTP files can be carved"
+#define ERR_REUSE_OPEN	"Can't open or update the pad reuse index"
+#define ERR_REUSE_HIT	"OTP bytes were used before - pad reuse refused"
+#define ERR_REUSE_DUP	"New OTP repeats material already in the pad reuse index"
+#define ERR_PYX_LIST	"Can't list the OTP files specified"
+#define ERR_PYX_FAILED	"%d of %d OTP files fail Pyx assessment"
+#define ERR_PYXC_OPEN	"Can't open or update the Pyx result cache"
+#define ERR_CKPT_OPEN	"Can't open, lock or update the OTP checkpoint file"
+#define ERR_CKPT_STALE	"OTP checkpoint does not match this OTP and size"
+#define ERR_CT_AUTH		"Encrypted file fails authentication - discard the decrypted output"
+#define ERR_CT_CHUNKAUTH	"Chunked encrypted files cannot also be authenticated"
+#define ERR_CT_SEEK		"Chunked encrypted file must be read from a seekable file"
+#define ERR_CT_NOCHUNK	"Encrypted file has no such chunk"
 #define PI				3.14159265358979323846
 #define PASS			"PASS"
 #define FAIL			"FAIL"
+#define PYX_ACF_COLUMNS	",Autocorrelation,Autocorrelation-Lag"
+#define PYX_LZ_COLUMNS	",LZ-Saving,LZ-Repeat-Segments"
+#define LE_BLOCK_SIZE	65536		/* Bytes moved per block operation */
+#define LE_PRINTF_MAX	512
+#define LE_LZ_HASHLOG	12
+#define LE_LZ_HASH		(1 << LE_LZ_HASHLOG)
+#define LE_LZ_MINMATCH	4
+#define LE_CT_MAGIC		"ERC1"		/* ciphertext container header */
+#define LE_CT_BASE		8			/* magic, flags, header length */
+#define LE_CT_LZ		0x0001		/* body is LZ compressed blocks */
+#define LE_CT_PAD		0x0002		/* header carries pad ID and offset */
+#define LE_CT_AUTH		0x0004		/* body carries a one-time MAC tag */
+#define LE_CT_CHUNK		0x0008		/* body is chunks listed by a trailing index */
+#define LE_CT_KNOWN		(LE_CT_LZ | LE_CT_PAD | LE_CT_AUTH | LE_CT_CHUNK)
+#define LE_CT_FRAMED	(LE_CT_LZ | LE_CT_AUTH)	/* body is length-framed blocks */
+#define LE_CT_PADHDR	32			/* header length with LE_CT_PAD */
+#define LE_CT_RAW		0x80000000U	/* block stored uncompressed */
+#define LE_CT_BLOCKS	5			/* block buffers used by the container paths */
+#define LE_CT_IMAGIC	"ERCI"		/* chunk index trailer */
+#define LE_CT_ENTRY		32			/* index entry: offset, length, clear length, xxh64 */
+#define LE_CT_TRAILER	32			/* magic, count, index offset, xxh64 */
+#define LE_CT_CHUNK_MIN	(16 * LE_BLOCK_SIZE)	/* smallest chunk, 1M */
+#define LE_CT_THREADS	16			/* most chunk decrypt workers */
+#define LE_PIPE_SLOTS	8			/* blocks in flight in the E pipeline */
+#define LE_MAC_KEY		32			/* pad bytes keying one MAC */
+#define LE_MAC_TAG		16
+#define LE_MAC_CHUNK	256			/* bytes XORed then hashed at a time */
+#define LE_WIPE_CHUNK	1048576		/* bytes per wipe write */
+#define LE_STRIPE_WIDTH	1048576		/* default stripe unit */
+#define LE_COND_NONE	0			/* device bytes used as read */
+#define LE_COND_VN		1			/* von Neumann debiasing */
+#define LE_COND_XOR		2			/* XOR fold of fold device bytes */
+#define LE_COND_SHA256	3			/* SHA-256 compression, 64 bytes to 32 */
+#define LE_COND_FOLD	2			/* default and ... */
+#define LE_COND_FOLD_MAX 8			/* ... largest XOR fold */
+#define LE_IO_CACHE		0			/* page cache used as the kernel sees fit */
+#define LE_IO_STREAM	1			/* readahead, release behind the cursor */
+#define LE_IO_DIRECT	2			/* O_DIRECT reads, else LE_IO_STREAM */
+#define LE_IO_STEP		8388608		/* bytes released (and synced) at a time */
+#define LE_IO_AHEAD		2			/* steps kept requested ahead of the cursor */
+#define LE_STRIPE_MAX	16			/* most pads in a stripe set */
+#define LE_STRIPE_AHEAD	4			/* rows of every member requested ahead */
+#define LE_PAD_MAGIC	"ERP1"		/* pad container header */
+#define LE_PAD_INDEX	"ERPI"		/* pad container trailer index */
+#define LE_PAD_VERSION	1
+#define LE_PAD_HDR		4096		/* header bytes; keeps pad data page aligned */
+#define LE_PAD_ID		16
+#define LE_PAD_SUM		136			/* header checksum offset */
+#define LE_PAD_PYX		1			/* header holds the Pyx summary */
+#define LE_PAD_THREADS	16			/* most verify workers */
+#define LE_PYX_WORKERS	16			/* most pads assessed at once */
+#define LE_PYX_PAIRS_DF	65280		/* serial test degrees of freedom, 256^2 - 256 */
+#define LE_PYX_TRIPLES_DF	16711680	/* and 256^3 - 256^2 */
+#define LE_PYX_NGRAM_MIN	5			/* expected count per bin for a serial test */
+#define LE_PYX_TBATCH	16384		/* triples held per leading byte before counting */
+#define LE_PYX_LZ_SEG	(16 * LE_BLOCK_SIZE)	/* bytes per compressibility segment */
+#define LE_PYX_LZ_HASHLOG	17			/* match table of 1 << 17 positions */
+#define LE_PYX_LZ_STEP	8			/* every 8th position goes in the table */
+#define LE_PYX_LZ_MARGIN	64			/* bytes saved that mark a segment as structured */
+#define LE_PYXC_MAGIC	"ERPC"		/* Pyx result cache */
+#define LE_PYXC_HDR		8			/* magic, record count */
+#define LE_PYXC_REC		152			/* bytes per cached result */
+#define LE_PYXC_KEY		48			/* leading record bytes compared */
+#define LE_PYXC_MAX		4096		/* results kept; the oldest are dropped */
+#define LE_PYXC_SAMPLES	16			/* 4K samples in the content fingerprint */
+#define LE_CKPT_MAGIC	"ERCK"		/* G resume checkpoint */
+#define LE_CKPT_LEN		64			/* checkpoint record bytes */
+#define LE_CKPT_STEP	(64 * LE_BLOCK_SIZE)	/* pad data between checkpoints */
+#define LE_HEALTH_H		2			/* assumed min-entropy, bits per device byte */
+#define LE_HEALTH_ALPHA	20			/* false alarm rate 2^-20 per test */
+#define LE_HEALTH_W		512			/* adaptive proportion window */
+#define LE_COND_CHUNK	65536		/* raw device bytes conditioned at a time */
+#define LE_CARVE_MAX	1000		/* most segments carved at once */
+#define LE_CLONE_ALIGN	4096		/* reflink offsets and lengths */
+#define LE_REUSE_MAGIC	"ERRX"		/* pad reuse index */
+#define LE_REUSE_HDR	4096
+#define LE_REUSE_SLOTS	65536		/* initial table slots */
+#define LE_REUSE_A		0x45		/* chunks end at the byte pair A B, */
+#define LE_REUSE_B		0x52		/* 64K apart on average in random data */
+#define LE_REUSE_MIN	256			/* shorter chunks are not indexed */
+#define LE_REUSE_MAX	1048576		/* longest chunk */
+#define LE_POOL_ALIGN	4096		/* O_DIRECT compatible alignment */
+#define LE_POOL_HUGE	2097152		/* huge page size */
+#define LE_POOL_ARENA	(2 * LE_POOL_HUGE)	/* default arena size */
+#define LE_POOL_CLASSES	32			/* buffer sizes LE_POOL_ALIGN << 0..31, 4K to 8T */
+#define LE_POOL_THP		1			/* madvise(MADV_HUGEPAGE) arenas */
+#define LE_POOL_HUGETLB	2			/* explicit MAP_HUGETLB arenas */
+#define LE_POOL_MLOCK	4			/* lock arenas in memory */
+#define LE_SERVE_MAGIC	0x31535245	/* "ERS1" */
+#define LE_SERVE_BINARY	1			/* request flag: Pyx bit mode */
+#define LE_SERVE_PADS	16			/* pads kept mapped by the server */
+#define LE_SERVE_CLIENTS 64
+#define LE_SERVE_MAX	(64ULL * 1048576)	/* largest request payload */
+#define LE_SERVE_TIMEOUT 5			/* seconds a reply may wait on a client */
+#define ERR_SOCKET		"Error creating server socket"
+#define ERR_SOCK_PATH	"Server socket path is too long"
+#define ERR_SERVE_OP	"Unknown server request"
+#define ERR_SERVE_SIZE	"Server request is too large"
+#define ERR_SERVE_PAD	"Can't open OTP file requested"
+#define ERR_SERVE_OFFSET "Requested offset is beyond the OTP file"
+#define ERR_SERVE_RAW	"Server encrypts only with container OTP files"
+
+
+/*  Tracing  --  USDT probes, provider "libenoch", for bpftrace, perf and
+	SystemTap.  With <sys/sdt.h> (systemtap-sdt-dev) each probe is one
+	nop and an ELF note, costing nothing until something attaches;
+	without it, or built with -DLE_NO_PROBES, they compile away.  The
+	commands fire generate_, encrypt_, decrypt_ and pyx_ start and done
+	(return code, payload bytes); each block fires read_, pread_ and
+	write_ start and done (stream role, bytes asked for or moved) and
+	xor_ and pyx_add_ start and done (bytes).  */
+
+#ifdef LE_HAVE_SDT
+#define LE_PROBE0(name)			DTRACE_PROBE(libenoch, name)
+#define LE_PROBE1(name, a)		DTRACE_PROBE1(libenoch, name, a)
+#define LE_PROBE2(name, a, b)	DTRACE_PROBE2(libenoch, name, a, b)
+#else
+#define LE_PROBE0(name)			do { } while (0)
+#define LE_PROBE1(name, a)		do { (void) (a); } while (0)
+#define LE_PROBE2(name, a, b)	do { (void) (a); (void) (b); } while (0)
+#endif
+#define LE_ROLE(stream)			((stream)->role ? (stream)->role : "stream")
+
+typedef struct le_stream le_stream_t;
+
+typedef struct {
+	unsigned long long		rbytes;		/* bytes read */
+	unsigned long long		wbytes;		/* bytes written */
+	unsigned long long		rcalls;		/* backend read calls (syscalls for fd/device) */
+	unsigned long long		wcalls;		/* backend write calls */
+	double					seconds;	/* time spent inside the backend */
+} le_io_stats_t;
+
+typedef struct {
+	le_io_stats_t			input;
+	le_io_stats_t			output;
+	le_io_stats_t			otp;
+	le_io_stats_t			encrypted;
+	le_io_stats_t			device;
+	unsigned long long		bytes;		/* payload bytes processed */
+	unsigned long long		wiped;		/* OTP bytes wiped by W, or by E and D with wipe */
+	unsigned long long		cloned;		/* C: bytes shared by reflink rather than copied */
+	unsigned long long		cached;		/* P: pads answered from the Pyx result cache */
+	double					rng_seconds;	/* waiting on the RNG device */
+	double					io_seconds;		/* file and stream I/O */
+	double					compute_seconds;	/* XOR, Pyx accumulation, overhead */
+	double					total_seconds;
+	double					throughput;	/* payload bytes per second */
+} le_stats_t;
+
+typedef struct {
+	const char	*name;
+	ssize_t		(*read)(le_stream_t *stream, void *buf, size_t len);
+	ssize_t		(*write)(le_stream_t *stream, const void *buf, size_t len);
+	ssize_t		(*pread)(le_stream_t *stream, void *buf, size_t len, unsigned long long offset);
+	long long	(*size)(le_stream_t *stream);
+	int			(*close)(le_stream_t *stream);
+} le_stream_ops_t;
+
+struct le_stream {
+	const le_stream_ops_t	*ops;
+	void					*handle;	/* custom backend state */
+	FILE					*fp;		/* stdio backend */
+	int						fd;			/* fd, device and mmap backends */
+	int						owned;		/* close/free the underlying resource */
+	unsigned char			*base;		/* mmap and memory backends */
+	unsigned long long		length;
+	unsigned long long		capacity;
+	unsigned long long		offset;		/* current read/write position */
+	le_io_stats_t			stats;		/* reset at the start of each command */
+	int						bounded;	/* reads limited to remain bytes */
+	unsigned long long		remain;
+	unsigned long long		position;	/* bytes from the start (or last le_seek) */
+	int						policy;		/* LE_IO_ page cache policy, see io_policy */
+	unsigned long long		ahead;		/* readahead requested up to */
+	unsigned long long		synced;		/* writeback started up to */
+	unsigned long long		dropped;	/* page cache released up to */
+	unsigned long long		written;	/* bytes written through le_write */
+	const char				*role;		/* "input", "otp"... while a command runs, for probes */
+};
+
+typedef struct {
+	unsigned char			id[16];		/* random pad ID */
+	unsigned int			flags;		/* LE_PAD_PYX when the summary is set */
+	unsigned int			hdrlen;		/* data offset; 0 for a legacy raw pad */
+	unsigned int			block_size;	/* data bytes per index checksum */
+	unsigned long long		length;		/* pad data bytes */
+	unsigned long long		consumed;	/* data bytes already used by E */
+	unsigned long long		created;	/* seconds since the epoch */
+	unsigned long long		index_offset;
+	char					device[32];	/* RNG device used by G */
+	double					ent, chisq, mean, montepi, scc;	/* Pyx summary */
+} le_pad_t;
+
+typedef struct le_job le_job_t;
+
+typedef struct {
+	unsigned long long	done;		/* bytes processed so far */
+	unsigned long long	total;		/* bytes expected, 0 when unknown */
+	double				elapsed;	/* seconds since the job started */
+	double				rate;		/* bytes per second */
+	double				eta;		/* seconds remaining, -1 when unknown */
+} le_progress_t;
 
+typedef void (*le_progress_fn)(const le_progress_t *progress, void *arg);
 
 typedef struct {
 	int						verbose;
@@ -82,28 +344,79 @@ typedef struct {
 	int						cmd_mode;
 	int						pyx_binary;
 	int						padout_pdotp;
-	FILE					*input;
-	FILE					*output;
-	FILE					*otp;
-	FILE					*encrypted;
-	int						device;
+	le_stream_t				*input;
+	le_stream_t				*output;
+	le_stream_t				*otp;
+	le_stream_t				*encrypted;
+	le_stream_t				*device;
 	char					input_fsp[MAX_FSP_PATH];
 	char					output_fsp[MAX_FSP_PATH];
 	char					otp_fsp[MAX_FSP_PATH];
 	char					encrypted_fsp[MAX_FSP_PATH];
+	le_job_t				*job;		/* set while run by le_job_start */
+	int						stats_json;
+	le_stats_t				stats;		/* filled by every command */
+	char					socket_fsp[MAX_FSP_PATH];
+	int						compress;	/* E: LZ compress the clear input before XOR */
+	le_pad_t				pad;		/* OTP container header, set by G, E, D and P */
+	int						pad_raw;	/* G: write a legacy raw pad */
+	int						auth;		/* E: append a one-time MAC */
+	int						wipe;		/* E, D: wipe the OTP bytes used */
+	int						condition;	/* G, E: extractor on device output (LE_COND_) */
+	int						fold;		/* LE_COND_XOR: device bytes per output byte */
+	char					reuse_fsp[MAX_FSP_PATH];	/* G, E: pad reuse index, "" for none */
+	int						segments;	/* C: segments to carve, 0 to cut by size */
+	int						io_policy;	/* G, E, D, P: page cache policy (LE_IO_) */
+	char					pyx_cache_fsp[MAX_FSP_PATH];	/* P: Pyx result cache, "" for none */
+	int						pyx_triples;	/* P: byte triple serial test too */
+	int						pyx_lags;	/* P: autocorrelation lags, 0 for none */
+	int						resume;		/* G: checkpoint, continue an interrupted pad */
+	unsigned long long		chunk;		/* E: clear bytes per chunk, 0 for no chunk index */
+	unsigned long long		chunk_no;	/* D: the one chunk to decrypt (from 1), 0 for all */
+	int						pyx_lz;		/* P: LZ compressibility test too */
 } options_t;
 
+typedef struct {
+	unsigned int			magic;		/* LE_SERVE_MAGIC */
+	unsigned char			op;			/* request: 'E', 'D', 'G', 'P'; reply: echoed */
+	unsigned char			flags;		/* request: LE_SERVE_BINARY; reply: 0 ok, 1 failed */
+	unsigned short			pathlen;	/* pad path bytes following the header */
+	unsigned long long		offset;		/* pad offset for D; E reply: offset used */
+	unsigned long long		length;		/* payload bytes following the path (G: bytes wanted) */
+} le_msg_t;
+
+typedef int (*FUNC)(options_t *options);
+
 
-static int binary = FALSE;		/* Treat input as a byte stream */
-static long	ccount[256],		/* Bins to count occurrences of values */
-			totalc = 0;			/* Total bytes counted */
-static double prob[256];		/* Probabilities per bin for entropy */
-static int mp, sccfirst;
-static unsigned int monte[MONTEN];
-static long inmont, mcount;
-static double	cexp, incirc, montex, montey, montepi,
-				scc, sccun, sccu0, scclast, scct1, scct2, scct3,
-				ent, chisq, datasum;
+/*  Pyx accumulator state.  Each assessment owns one, so pads can be
+	assessed on several threads; pyx_init, pyx_add and pyx_end keep
+	working on a library wide instance.  */
+
+typedef struct {
+	int				binary;			/* Treat input as a byte stream */
+	long			ccount[256],	/* Bins to count occurrences of values */
+					totalc;			/* Total bytes counted */
+	double			prob[256];		/* Probabilities per bin for entropy */
+	int				mp, sccfirst;
+	unsigned int	monte[MONTEN];
+	long			inmont, mcount;
+	double			cexp, incirc, montex, montey, montepi,
+					scc, sccun, sccu0, scclast, scct1, scct2, scct3,
+					ent, chisq, datasum;
+	unsigned int	pair[65536];	/* Overlapping byte pairs, first byte high */
+	unsigned int	*triple;		/* Overlapping byte triples, NULL unless wanted */
+	unsigned short	*tbuf;			/* Triples waiting, LE_PYX_TBATCH per first byte */
+	unsigned int	tfill[256];
+	unsigned long long	bytes;		/* Bytes in the pairs and triples */
+	unsigned char	head[2], tail[2];	/* First and last bytes, for the wrap */
+	double			*awin;			/* Autocorrelation window, NULL unless wanted */
+	double			*afft, *aacc, *atw, *afirst;	/* within the awin allocation */
+	double			asum;			/* Sum of the centred bytes */
+	unsigned long long	abytes;
+	int				alags, an, afill;
+} pyx_t;
+
+static pyx_t pyx_state;
 
 /*FUNCTION poz: probability of normal z value */
 
@@ -170,6 +483,9 @@ static double poz(const double z)
 		Collected Algorithms for the CACM 1967 p. 243
 	Updated for rounding errors based on remark in
 		ACM TOMS June 1985, page 185
+	The series takes df / 2 terms, so above WH_DF degrees of freedom
+	the Wilson-Hilferty cube root transform to a normal z is used;
+	its error there is well below poz's six digits.
 */
 
 double pochisq(
@@ -186,6 +502,11 @@ double pochisq(
 	if (x <= 0.0 || df < 1)
 		return 1.0;
 
+	if (df > WH_DF) {
+		a = 2.0 / (9.0 * df);
+		return (poz(-(cbrt(x / df) - (1.0 - a)) / sqrt(a)));
+	}
+
 	a = 0.5 * x;
 	even = (2 * (df / 2)) == df;
 	if (df > 1)
@@ -232,94 +553,450 @@ int enoch(char *version)
 	return TRUE;
 }
 
-/*  pyx_init  --  initialise random test counters.  */
+/*  pyx_ctx_init  --  initialise random test counters.  */
 
-void pyx_init(int binmode)
+static void pyx_ctx_init(pyx_t *px, int binmode)
 {
 	int i;
 
-	binary = binmode;		/* Set binary / byte mode */
+	px->binary = binmode;		/* Set binary / byte mode */
 
 	/* Initialise for calculations */
 
-	ent = 0.0;				/* Clear entropy accumulator */
-	chisq = 0.0;			/* Clear Chi-Square */
-	datasum = 0.0;			/* Clear sum of bytes for arithmetic mean */
+	px->ent = 0.0;				/* Clear entropy accumulator */
+	px->chisq = 0.0;			/* Clear Chi-Square */
+	px->datasum = 0.0;			/* Clear sum of bytes for arithmetic mean */
 
-	mp = 0;					/* Reset Monte Carlo accumulator pointer */
-	mcount = 0;				/* Clear Monte Carlo tries */
-	inmont = 0;				/* Clear Monte Carlo inside count */
-	incirc = 65535.0 * 65535.0;/* In-circle distance for Monte Carlo */
+	px->mp = 0;					/* Reset Monte Carlo accumulator pointer */
+	px->mcount = 0;				/* Clear Monte Carlo tries */
+	px->inmont = 0;				/* Clear Monte Carlo inside count */
+	px->incirc = 65535.0 * 65535.0;/* In-circle distance for Monte Carlo */
 
-	sccfirst = TRUE;		/* Mark first time for serial correlation */
-	scct1 = scct2 = scct3 = 0.0; /* Clear serial correlation terms */
+	px->sccfirst = TRUE;		/* Mark first time for serial correlation */
+	px->scct1 = px->scct2 = px->scct3 = 0.0; /* Clear serial correlation terms */
 
-	incirc = pow(pow(256.0, (double) (MONTEN / 2)) - 1, 2.0);
+	px->incirc = pow(pow(256.0, (double) (MONTEN / 2)) - 1, 2.0);
 
 	for (i = 0; i < 256; i++) {
-		ccount[i] = 0;
+		px->ccount[i] = 0;
 	}
-	totalc = 0;
+	px->totalc = 0;
+
+	memset(px->pair, 0, sizeof(px->pair));
+	memset(px->tfill, 0, sizeof(px->tfill));
+	px->triple = NULL;
+	px->tbuf = NULL;
+	px->bytes = 0;
+	px->tail[0] = px->tail[1] = 0;
+	px->awin = NULL;
 }
 
-/*  pyx_add  --	add one or more bytes to accumulation.	*/
+/*  Serial tests  --  byte pairs and triples.
 
-void pyx_add(void *buf, int bufl)
+	The Chi-Square above sees only how often each byte occurs, so a pad
+	whose bytes follow each other in a pattern passes it.  Every byte
+	also counts the overlapping pair it ends, and with pyx_ctx_triples
+	the triple, the stream taken circularly so that all n of each are
+	counted.  Overlapping counts are not independent, so their plain
+	chi-square is not chi-square distributed; Good's serial statistic,
+	the m-gram chi-square less the (m-1)-gram one, is, with 256^m -
+	256^(m-1) degrees of freedom (Good 1953, as in NIST SP 800-22).
+
+	The pair table is 256K and stays in the L2 cache.  The triple table
+	is 64M, where each increment would be a cache and TLB miss, so
+	triples are first queued by their leading byte and counted
+	LE_PYX_TBATCH at a time into that byte's 256K slice of the table.
+	A test needs LE_PYX_NGRAM_MIN expected counts per bin (320K bytes
+	for pairs, 80M for triples); below that it is not run.  */
+
+/*  pyx_ctx_free  --  release the triple and autocorrelation tables.  */
+
+static void pyx_ctx_free(pyx_t *px)
+{
+	free(px->triple);
+	free(px->tbuf);
+	free(px->awin);
+	px->triple = NULL;
+	px->tbuf = NULL;
+	px->awin = NULL;
+}
+
+/*  pyx_ctx_triples  --  add the triple test to px.  */
+
+static int pyx_ctx_triples(pyx_t *px)
+{
+	px->triple = calloc(65536 * 256, sizeof(unsigned int));
+	px->tbuf = malloc(256 * LE_PYX_TBATCH * sizeof(unsigned short));
+	if ((px->triple == NULL) || (px->tbuf == NULL)) {
+		pyx_ctx_free(px);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  pyx_tflush  --  count the triples queued under leading byte a.  */
+
+static void pyx_tflush(pyx_t *px, unsigned int a)
+{
+	unsigned int *slice = px->triple + ((size_t) a << 16);
+	unsigned short *q = px->tbuf + (size_t) a * LE_PYX_TBATCH;
+	unsigned int i, n = px->tfill[a];
+
+	for (i = 0; i < n; i++)
+		slice[q[i]]++;
+	px->tfill[a] = 0;
+}
+
+static inline void pyx_tpush(pyx_t *px, unsigned int a, unsigned int bc)
+{
+	px->tbuf[(size_t) a * LE_PYX_TBATCH + px->tfill[a]++] = (unsigned short) bc;
+	if (px->tfill[a] == LE_PYX_TBATCH)
+		pyx_tflush(px, a);
+}
+
+/*  pyx_ngram_add  --  count the pairs and triples ending in buf.  */
+
+static void pyx_ngram_add(pyx_t *px, const unsigned char *buf, int len)
+{
+	unsigned int a = px->tail[0], b = px->tail[1], p, c;
+	int i, k;
+
+	for (i = 0; (i < len) && (px->bytes < 2); i++) {
+		c = buf[i];
+		px->head[px->bytes] = (unsigned char) c;
+		if (px->bytes++ == 1)
+			px->pair[(b << 8) | c]++;
+		a = b;
+		b = c;
+	}
+	px->bytes += (unsigned long long) (len - i);
+
+	for (p = b, k = i; k < len; k++) {
+		c = buf[k];
+		px->pair[(p << 8) | c]++;
+		p = c;
+	}
+	if (px->triple != NULL)
+		for (k = i; k < len; k++) {
+			pyx_tpush(px, a, (b << 8) | buf[k]);
+			a = b;
+			b = buf[k];
+		}
+	else
+		for (k = (i > len - 2) ? i : len - 2; k < len; k++) {
+			a = b;
+			b = buf[k];
+		}
+	px->tail[0] = (unsigned char) a;
+	px->tail[1] = (unsigned char) b;
+}
+
+/*  pyx_psi  --  chi-square of n counts over bins equally likely.  */
+
+static double pyx_psi(const unsigned int *bins, size_t nbins, unsigned long long n)
+{
+	double e = (double) n / nbins, a, s = 0.0;
+	size_t i;
+
+	for (i = 0; i < nbins; i++) {
+		a = bins[i] - e;
+		s += a * a;
+	}
+	return(s / e);
+}
+
+/*  pyx_ctx_ngram  --  complete the serial tests; pairs and triples
+	receive their statistics, or -1 when not run.  */
+
+static void pyx_ctx_ngram(pyx_t *px, double *r_pairs, double *r_triples)
+{
+	unsigned long long n = px->bytes, count;
+	double psi1 = 0.0, psi2, e, a;
+	unsigned int i, j;
+
+	*r_pairs = *r_triples = -1.0;
+	if (n < LE_PYX_NGRAM_MIN * 65536ULL)
+		return;
+
+	/* Close the circle: the pair and triples across the end */
+
+	px->pair[(px->tail[1] << 8) | px->head[0]]++;
+	e = n / 256.0;
+	for (i = 0; i < 256; i++) {
+		for (count = 0, j = 0; j < 256; j++)
+			count += px->pair[(i << 8) | j];
+		a = count - e;
+		psi1 += a * a / e;
+	}
+	psi2 = pyx_psi(px->pair, 65536, n);
+	*r_pairs = psi2 - psi1;
+
+	if ((px->triple == NULL) || (n < LE_PYX_NGRAM_MIN * 16777216ULL))
+		return;
+	pyx_tpush(px, px->tail[0], (px->tail[1] << 8) | px->head[0]);
+	pyx_tpush(px, px->tail[1], (px->head[0] << 8) | px->head[1]);
+	for (i = 0; i < 256; i++)
+		pyx_tflush(px, i);
+	*r_triples = pyx_psi(px->triple, 16777216, n) - psi2;
+}
+
+/*  Autocorrelation  --  serial correlation at lags 1 to alags.
+
+	The serial correlation coefficient looks at neighbouring bytes
+	only, while a device that buffers its output tends to repeat itself
+	hundreds or thousands of bytes apart.  With pyx_ctx_lags the bytes,
+	less 127.5, also feed sums of x[i] * x[i + k] for every lag up to
+	alags, which a loop would take alags multiply-adds per byte to
+	form.  Instead each hop of an - alags bytes and the window of an
+	bytes starting with it go into one complex FFT of size an (the hop
+	as the real part, the window as the imaginary), and the product of
+	their spectra is summed; one inverse FFT at the end yields every
+	lag at once, about log2(an) butterflies per byte.  an is at least
+	four times alags, so a hop is most of the FFT.
+
+	The sums are corrected for the sample mean and divided by the
+	variance.  For random bytes each coefficient times the square root
+	of the pairs behind it is close to a standard normal, so the
+	largest of them is judged against alags independent ones.  */
+
+/*  pyx_fft  --  in place radix-2 FFT of n complex values (re, im
+	interleaved).  tw holds each stage's twiddles in turn, cos and -sin
+	of 2 pi k / len for k < len / 2, so a stage reads them in order.  */
+
+static void pyx_fft(double *z, const double *tw, int n)
+{
+	double t, wr, wi, ur, ui, vr, vi;
+	int i, j, k, bit, len, half;
+
+	for (i = 1, j = 0; i < n; i++) {
+		for (bit = n >> 1; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			t = z[2 * i], z[2 * i] = z[2 * j], z[2 * j] = t;
+			t = z[2 * i + 1], z[2 * i + 1] = z[2 * j + 1], z[2 * j + 1] = t;
+		}
+	}
+	for (len = 2; len <= n; tw += len, len <<= 1) {
+		half = len >> 1;
+		for (i = 0; i < n; i += len)
+			for (k = 0; k < half; k++) {
+				wr = tw[2 * k];
+				wi = tw[2 * k + 1];
+				ur = z[2 * (i + k)];
+				ui = z[2 * (i + k) + 1];
+				vr = z[2 * (i + k + half)] * wr - z[2 * (i + k + half) + 1] * wi;
+				vi = z[2 * (i + k + half)] * wi + z[2 * (i + k + half) + 1] * wr;
+				z[2 * (i + k)] = ur + vr;
+				z[2 * (i + k) + 1] = ui + vi;
+				z[2 * (i + k + half)] = ur - vr;
+				z[2 * (i + k + half) + 1] = ui - vi;
+			}
+	}
+}
+
+/*  pyx_ctx_lags  --  add the autocorrelation of lags 1 to lags to px.  */
+
+static int pyx_ctx_lags(pyx_t *px, int lags)
+{
+	double *tw;
+	int n = 4096, k, len;
+
+	while (n < 4 * lags)
+		n <<= 1;
+	if ((px->awin = calloc((size_t) n * 7 + (size_t) lags, sizeof(double))) == NULL)
+		return(EXIT_FAILURE);
+	px->afft = px->awin + n;
+	px->aacc = px->afft + 2 * n;
+	px->atw = px->aacc + 2 * n;
+	px->afirst = px->atw + 2 * n;
+	for (tw = px->atw, len = 2; len <= n; tw += len, len <<= 1)
+		for (k = 0; k < len / 2; k++) {
+			tw[2 * k] = cos(2.0 * PI * k / len);
+			tw[2 * k + 1] = -sin(2.0 * PI * k / len);
+		}
+	px->alags = lags;
+	px->an = n;
+	px->afill = 0;
+	px->abytes = 0;
+	px->asum = 0.0;
+	return(EXIT_SUCCESS);
+}
+
+/*  pyx_acf_hop  --  add the products of the m window values from at
+	with those up to alags after them; the window ends at afill.  m is
+	at most an - alags, so no product wraps round the FFT.  */
+
+static void pyx_acf_hop(pyx_t *px, int at, int m)
+{
+	double *z = px->afft, *acc = px->aacc;
+	double ar, ai, br, bi, zr, zi, mr, mi;
+	int n = px->an, j;
+
+	for (j = 0; j < n; j++) {
+		z[2 * j] = (j < m) ? px->awin[at + j] : 0.0;
+		z[2 * j + 1] = (at + j < px->afill) ? px->awin[at + j] : 0.0;
+	}
+	pyx_fft(z, px->atw, n);
+
+	/* Split the spectra of the hop (A) and the window (B); sum conj(A) B */
+
+	for (j = 0; j < n; j++) {
+		zr = z[2 * j];
+		zi = z[2 * j + 1];
+		mr = z[2 * ((n - j) & (n - 1))];
+		mi = z[2 * ((n - j) & (n - 1)) + 1];
+		ar = 0.5 * (zr + mr);
+		ai = 0.5 * (zi - mi);
+		br = 0.5 * (zi + mi);
+		bi = -0.5 * (zr - mr);
+		acc[2 * j] += ar * br + ai * bi;
+		acc[2 * j + 1] += ar * bi - ai * br;
+	}
+}
+
+static void pyx_acf_add(pyx_t *px, const unsigned char *buf, int len)
+{
+	double y;
+	int i, hop = px->an - px->alags;
+
+	for (i = 0; i < len; i++) {
+		y = buf[i] - 127.5;
+		if (px->abytes < (unsigned long long) px->alags)
+			px->afirst[px->abytes] = y;
+		px->abytes++;
+		px->asum += y;
+		px->awin[px->afill++] = y;
+		if (px->afill == px->an) {
+			pyx_acf_hop(px, 0, hop);
+			memmove(px->awin, px->awin + hop, (size_t) px->alags * sizeof(double));
+			px->afill = px->alags;
+		}
+	}
+}
+
+/*  pyx_ctx_acf  --  complete the autocorrelation; r_acf receives the
+	coefficient that is largest for its lag and r_lag that lag, 0 when
+	there are fewer than twice alags bytes or all bytes are equal.  */
+
+static void pyx_ctx_acf(pyx_t *px, double *r_acf, int *r_lag)
+{
+	double *c = px->afft, mean, var, first, last, r, z, best = -1.0;
+	unsigned long long n = px->abytes;
+	int k, lags = px->alags;
+
+	*r_acf = 0.0;
+	*r_lag = 0;
+	if (n < 2 * (unsigned long long) lags)
+		return;
+
+	/* The rest ends with the data; afill holds at least alags, and
+	   more than a hop goes as a hop and the remainder */
+
+	if (px->afill > px->an - lags) {
+		pyx_acf_hop(px, 0, px->an - lags);
+		pyx_acf_hop(px, px->an - lags, px->afill - (px->an - lags));
+	} else
+		pyx_acf_hop(px, 0, px->afill);
+
+	/* Inverse FFT by conjugating; the sums are real */
+
+	for (k = 0; k < px->an; k++) {
+		c[2 * k] = px->aacc[2 * k];
+		c[2 * k + 1] = -px->aacc[2 * k + 1];
+	}
+	pyx_fft(c, px->atw, px->an);
+
+	mean = px->asum / n;
+	var = c[0] / px->an - n * mean * mean;
+	if (var <= 0.0)
+		return;
+	for (first = last = 0.0, k = 1; k <= lags; k++) {
+		first += px->afirst[k - 1];
+		last += px->awin[px->afill - k];
+		r = (c[2 * k] / px->an - mean * ((px->asum - last) + (px->asum - first)) + (n - k) * mean * mean) / var;
+		z = fabs(r) * sqrt((double) (n - k));
+		if (z > best) {
+			best = z;
+			*r_acf = r;
+			*r_lag = k;
+		}
+	}
+}
+
+/*  pyx_acf_p  --  the chance that the largest of lags normal
+	coefficients of n bytes is as far out as r at lag.  */
+
+static double pyx_acf_p(double r, int lag, int lags, unsigned long long n)
+{
+	double q = 2.0 * poz(-fabs(r) * sqrt((double) (n - lag)));
+
+	return(-expm1(lags * log1p(-q)));
+}
+
+/*  pyx_ctx_add  --	add one or more bytes to accumulation.	*/
+
+static void pyx_ctx_add(pyx_t *px, void *buf, int bufl)
 {
 	unsigned char *bp = buf;
-	int oc, c, bean, mj;
+	int oc, c, bean, mj, n = bufl;
 
+	LE_PROBE1(pyx_add_start, n);
+	pyx_ngram_add(px, buf, bufl);
+	if (px->awin != NULL)
+		pyx_acf_add(px, buf, bufl);
 	while (bean = 0, (bufl-- > 0)) {
 		oc = *bp++;
 
 		do {
-			if (binary) {
+			if (px->binary) {
 				c = !!(oc & 0x80);
 			} else {
 				c = oc;
 			}
-		ccount[c]++;		/* Update counter for this bin */
-		totalc++;
+		px->ccount[c]++;		/* Update counter for this bin */
+		px->totalc++;
 
 		/* Update inside / outside circle counts for Monte Carlo
 		computation of PI */
 
 		if (bean == 0) {
-			monte[mp++] = oc;       /* Save character for Monte Carlo */
-			if (mp >= MONTEN) {     /* Calculate every MONTEN character */
-				mp = 0;
-				mcount++;
-				montex = montey = 0;
+			px->monte[px->mp++] = oc;       /* Save character for Monte Carlo */
+			if (px->mp >= MONTEN) {     /* Calculate every MONTEN character */
+				px->mp = 0;
+				px->mcount++;
+				px->montex = px->montey = 0;
 				for (mj = 0; mj < MONTEN / 2; mj++) {
-					montex = (montex * 256.0) + monte[mj];
-					montey = (montey * 256.0) + monte[(MONTEN / 2) + mj];
+					px->montex = (px->montex * 256.0) + px->monte[mj];
+					px->montey = (px->montey * 256.0) + px->monte[(MONTEN / 2) + mj];
 				}
-				if ((montex * montex + montey *  montey) <= incirc)
-					inmont++;
+				if ((px->montex * px->montex + px->montey *  px->montey) <= px->incirc)
+					px->inmont++;
 			}
 		}	
 
 	/* Update calculation of serial correlation coefficient */
 
-		sccun = c;
-		if (sccfirst) {
-			sccfirst = FALSE;
-			scclast = 0;
-			sccu0 = sccun;
+		px->sccun = c;
+		if (px->sccfirst) {
+			px->sccfirst = FALSE;
+			px->scclast = 0;
+			px->sccu0 = px->sccun;
 		} else
-			scct1 = scct1 + scclast * sccun;
+			px->scct1 = px->scct1 + px->scclast * px->sccun;
 
-		scct2 = scct2 + sccun;
-		scct3 = scct3 + (sccun * sccun);
-		scclast = sccun;
+		px->scct2 = px->scct2 + px->sccun;
+		px->scct3 = px->scct3 + (px->sccun * px->sccun);
+		px->scclast = px->sccun;
 		oc <<= 1;
-		} while (binary && (++bean < 8));
+		} while (px->binary && (++bean < 8));
     }
+	LE_PROBE1(pyx_add_done, n);
 }
 
-/*  pyx_end  --	complete calculation and return results.  */
+/*  pyx_ctx_end  --	complete calculation and return results.  */
 
-void pyx_end	(double *r_ent, double *r_chisq, double *r_mean,
+static void pyx_ctx_end(pyx_t *px, double *r_ent, double *r_chisq, double *r_mean,
 				double *r_montepicalc, double *r_scc)
 {
 	int i;
@@ -327,13 +1004,13 @@ void pyx_end	(double *r_ent, double *r_chisq, double *r_mean,
 
 	/* Complete calculation of serial correlation coefficient */
 
-	scct1 = scct1 + scclast * sccu0;
-	scct2 = scct2 * scct2;
-	scc = totalc * scct3 - scct2;
-	if (scc == 0.0)
-		scc = -100000;
+	px->scct1 = px->scct1 + px->scclast * px->sccu0;
+	px->scct2 = px->scct2 * px->scct2;
+	px->scc = px->totalc * px->scct3 - px->scct2;
+	if (px->scc == 0.0)
+		px->scc = -100000;
 	else {
-		scc = (totalc * scct1 - scct2) / scc;
+		px->scc = (px->totalc * px->scct1 - px->scct2) / px->scc;
     }
 
 	/* 	Scan bins and calculate probability for each bin and
@@ -342,342 +1019,6795 @@ void pyx_end	(double *r_ent, double *r_chisq, double *r_mean,
 		we sum of all the data which will be used to compute the
 		mean. */
        
-	cexp = totalc / (binary ? 2.0 : 256.0);  /* Expected count per bin */
-	for (i = 0; i < (binary ? 2 : 256); i++) {
-		a = ccount[i] - cexp;;
+	px->cexp = px->totalc / (px->binary ? 2.0 : 256.0);  /* Expected count per bin */
+	for (i = 0; i < (px->binary ? 2 : 256); i++) {
+		a = px->ccount[i] - px->cexp;;
 
-		prob[i] = ((double) ccount[i]) / totalc;       
-		chisq += (a * a) / cexp;
-		datasum += ((double) i) * ccount[i];
+		px->prob[i] = ((double) px->ccount[i]) / px->totalc;       
+		px->chisq += (a * a) / px->cexp;
+		px->datasum += ((double) i) * px->ccount[i];
     }
 
 	/* Calculate entropy */
 
-	for (i = 0; i < (binary ? 2 : 256); i++) {
-		if (prob[i] > 0.0)
-			ent += prob[i] * pyx_log2(1 / prob[i]);
+	for (i = 0; i < (px->binary ? 2 : 256); i++) {
+		if (px->prob[i] > 0.0)
+			px->ent += px->prob[i] * pyx_log2(1 / px->prob[i]);
     }
 
 	/* 	Calculate Monte Carlo value for PI from percentage of hits
 		within the circle */
-	if (mcount == 0)
-		montepi = 0.0;
+	if (px->mcount == 0)
+		px->montepi = 0.0;
 	else
-		montepi = 4.0 * (((double) inmont) / mcount);
+		px->montepi = 4.0 * (((double) px->inmont) / px->mcount);
 
 	/* Return results through arguments */
 
-	*r_ent = ent;
-	*r_chisq = chisq;
-	*r_mean = datasum / totalc;
-	*r_montepicalc = montepi;
-	*r_scc = scc;
+	*r_ent = px->ent;
+	*r_chisq = px->chisq;
+	*r_mean = px->datasum / px->totalc;
+	*r_montepicalc = px->montepi;
+	*r_scc = px->scc;
 }
 
-int set_default_device(options_t *options) 
+/*  pyx_init, pyx_add, pyx_end  --  the same on the library wide state.  */
+
+void pyx_init(int binmode)
 {
-	snprintf(options->devname, sizeof(options->devname), "%s", DEV_DEFAULT_1);
-	if ((options->device = open(options->devname, O_RDONLY | O_CLOEXEC)) < 0) {
-		snprintf(options->devname, sizeof(options->devname), "%s", DEV_DEFAULT_2);
+	pyx_ctx_init(&pyx_state, binmode);
+}
 
-		if ((options->device = open(options->devname, O_RDONLY | O_CLOEXEC)) < 0) {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_DEF_DEV);
-			return(EXIT_FAILURE);
-		}    
+void pyx_add(void *buf, int bufl)
+{
+	pyx_ctx_add(&pyx_state, buf, bufl);
+}
 
+void pyx_end(double *r_ent, double *r_chisq, double *r_mean, double *r_montepicalc, double *r_scc)
+{
+	pyx_ctx_end(&pyx_state, r_ent, r_chisq, r_mean, r_montepicalc, r_scc);
+}
 
+/*  Streams  --  pluggable block source/sink backends.
 
-	}
+	Every command moves data through le_stream_t objects rather than
+	raw FILE pointers and descriptors.  A backend supplies a small
+	operations table (read block, write block, positional read, size
+	hint, close); the built-in backends cover stdio, raw descriptors,
+	read-only file mappings, memory buffers and RNG devices.  Any op
+	may be NULL, in which case the helpers fail with EBADF (read/write)
+	or ESPIPE (positional read), and the size hint reports -1.  */
 
-	return(EXIT_SUCCESS);
+static double now_seconds(void)
+{
+	struct timespec ts;
 
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((double) ts.tv_sec + ts.tv_nsec / 1e9);
 }
 
-/* G -s<size BKMG> -pfsp || G -ifsp -efsp -pfsp -f */
-/* [G -s1M -pnew.otp] */
-/* [G -iclear.in -eexisting.enc -pnew.otp -f] */
-
-int	g_generate(options_t *options)
+static ssize_t stdio_read(le_stream_t *stream, void *buf, size_t len)
 {
-unsigned long long keep_count, i;
-char byte;
-int clear_ch, enc_ch;
-struct stat sb;
+	size_t n;
 
-	keep_count=i=0;
+	n = fread(buf, 1, len, stream->fp);
+	if ((n == 0) && ferror(stream->fp))
+		return(-1);
+	return((ssize_t) n);
+}
 
-	switch (options->cmd_mode) {
-		case CMD_STD:
+static ssize_t stdio_write(le_stream_t *stream, const void *buf, size_t len)
+{
+	size_t n;
 
-		keep_count = options->size;
+	n = fwrite(buf, 1, len, stream->fp);
+	if ((n == 0) && (len > 0))
+		return(-1);
+	return((ssize_t) n);
+}
 
-		while (keep_count-- > 0) {
-			if (read(options->device, &byte, 1) > 0) {
-				if (fputc(byte, options->otp) == EOF) {
-					snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
-					return(EXIT_FAILURE);
-				}
-			} else {
-				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_GET_DEV);
-				return(EXIT_FAILURE);
-			}
-		}
+static ssize_t stdio_pread(le_stream_t *stream, void *buf, size_t len, unsigned long long offset)
+{
+	return(pread(fileno(stream->fp), buf, len, (off_t) offset));
+}
 
-		break;
+static long long fd_size_of(int fd)
+{
+	struct stat sb;
 
-		case CMD_ALT:
+	if ((fstat(fd, &sb) == -1) || !S_ISREG(sb.st_mode))
+		return(-1);
+	return((long long) sb.st_size);
+}
 
-		while ((clear_ch = fgetc(options->input) ) != EOF) {
-			keep_count++;
-			if ((enc_ch = fgetc(options->encrypted) ) != EOF) {
-				if (fputc((clear_ch^enc_ch), options->otp) == EOF) {
-					snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_PDOTP);
-					return(EXIT_FAILURE);
-				}
-			} else {
-				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_ENC_SHORT);
-				return(EXIT_FAILURE);
-			}
-		}
+static long long stdio_size(le_stream_t *stream)
+{
+	return(fd_size_of(fileno(stream->fp)));
+}
 
-		if (keep_count == 0) {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_INPUT);
-			return(EXIT_FAILURE);
-		} else
-			if(options->padout_pdotp) {
-				if (stat(options->encrypted_fsp, &sb)==-1) {
-					snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_STAT);
-					return(EXIT_FAILURE);
-				}			
-				for(i=keep_count; i<(unsigned long long)sb.st_size; i++) {
-					if (read(options->device, &byte, 1) > 0) {
-						if (fputc(byte, options->otp) == EOF) {
-							snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
-							return(EXIT_FAILURE);
-						}
-					}
-				}
-			}
-		break;
-	}
-	return(EXIT_SUCCESS);
+static int stdio_close(le_stream_t *stream)
+{
+	if (!stream->owned || (stream->fp == stdin) || (stream->fp == stdout) || (stream->fp == stderr))
+		return(fflush(stream->fp) == EOF ? -1 : 0);
+	return(fclose(stream->fp) == EOF ? -1 : 0);
 }
 
-/* E -ifsp -pfsp -ofsp  || E -ifsp -pnewfsp -ofsp */
-/* [E -iclear.in -pexisting.otp -oencrypted.out] */
-/* [E -iclear.in -pnew.otp -oencrypted.out] */
+/*  fd_direct  --  set or clear O_DIRECT on a descriptor stream.  */
 
-int	e_encrypt(options_t *options)
+static int fd_direct(le_stream_t *stream, int on)
 {
-char byte;
-int clear_ch, otp_ch;
-int inp_fine = FALSE;
-	
-	switch (options->cmd_mode) {
-		case CMD_STD:
+	int flags;
 
-		while ((clear_ch = fgetc(options->input) ) != EOF) {
-			inp_fine = TRUE;
-			if ((otp_ch = fgetc(options->otp) ) != EOF) {
-				if ((fputc((clear_ch^otp_ch), options->output)) == EOF) {
-					snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_ENC);
-					return(EXIT_FAILURE);
-				}
-			} else {
-				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
-				return(EXIT_FAILURE);
-			}
-		}
+	if ((flags = fcntl(stream->fd, F_GETFL)) == -1)
+		return(-1);
+	if (((flags & O_DIRECT) != 0) == (on != 0))
+		return(0);
+	return(fcntl(stream->fd, F_SETFL, on ? (flags | O_DIRECT) : (flags & ~O_DIRECT)));
+}
 
-		if (inp_fine == FALSE) {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_INPUT);
-			return(EXIT_FAILURE);
-		}
+/*  fd_refused  --  a read the device would not take directly (EINVAL:
+	unaligned buffer, offset or length); the stream carries on through
+	the page cache under LE_IO_STREAM.  */
 
-		break;
+static int fd_refused(le_stream_t *stream)
+{
+	if ((errno != EINVAL) || (stream->policy != LE_IO_DIRECT) || (fd_direct(stream, FALSE) == -1))
+		return(FALSE);
+	stream->policy = LE_IO_STREAM;
+	return(TRUE);
+}
 
-		case CMD_ALT:
+static ssize_t fd_read(le_stream_t *stream, void *buf, size_t len)
+{
+	ssize_t n;
 
-		while ((clear_ch = fgetc(options->input) ) != EOF) {
-			if (read(options->device, &byte, 1) > 0) {
-				if (fputc(byte, options->otp) == EOF) {
-					snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
-					return(EXIT_FAILURE);
-				}
-				if (fputc(clear_ch^byte, options->output) == EOF) {
-					snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_ENC);
-					return(EXIT_FAILURE);
-				}
-			} else {
-				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_GET_DEV);
-				return(EXIT_FAILURE);
-			}
-		}
+	if (((n = read(stream->fd, buf, len)) < 0) && fd_refused(stream))
+		n = read(stream->fd, buf, len);
+	return(n);
+}
 
-		break;
-	}
-	return(EXIT_SUCCESS);
+static ssize_t fd_write(le_stream_t *stream, const void *buf, size_t len)
+{
+	return(write(stream->fd, buf, len));
 }
 
-/* D -ifsp -pfsp -ofsp || D -ifsp -pfsp -ofsp -s<size BKMG> */
-/* [D -iencrypted.in -pexisting.otp -oclear.out] */ 
-/* [D -iencrypted.in -pexisting.otp -oclear.out -s1M] */ 
+static ssize_t fd_pread(le_stream_t *stream, void *buf, size_t len, unsigned long long offset)
+{
+	ssize_t n;
 
-int	d_decrypt(options_t *options)
+	if (((n = pread(stream->fd, buf, len, (off_t) offset)) < 0) && fd_refused(stream))
+		n = pread(stream->fd, buf, len, (off_t) offset);
+	return(n);
+}
+
+static long long fd_size(le_stream_t *stream)
 {
-int enc_ch, otp_ch;
-int inp_fine = FALSE;
-unsigned long long keep_count;
-struct stat sb;
+	return(fd_size_of(stream->fd));
+}
 
-	keep_count=0;
+static int fd_close(le_stream_t *stream)
+{
+	if (!stream->owned)
+		return(0);
+	return(close(stream->fd));
+}
 
-	if(options->size>0) {
-		if (stat(options->input_fsp, &sb)==-1) {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_STAT);
-			return(EXIT_FAILURE);
-		}
+/*  Device health state, kept with each le_open_device stream (see
+	harvest).  */
 
-		if(options->size>(unsigned long long)sb.st_size) {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_ENC_SIZE);
-			return(EXIT_FAILURE);
-		}
+typedef struct {
+	int						rct_cutoff, apt_cutoff;	/* 0 until first use */
+	int						last, run;	/* repetition count */
+	int						first, count, seen;	/* adaptive proportion window */
+	const char				*failed;	/* latched error */
+} health_t;
 
-		if (stat(options->otp_fsp, &sb)==-1) {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_STAT);
-			return(EXIT_FAILURE);
-		}
+static int device_close(le_stream_t *stream)
+{
+	free(stream->handle);
+	return(fd_close(stream));
+}
 
-		if(options->size>(unsigned long long)sb.st_size) {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SIZE);
-			return(EXIT_FAILURE);
-		}
-	}
+static ssize_t mem_read(le_stream_t *stream, void *buf, size_t len)
+{
+	unsigned long long left;
 
-	while ((enc_ch = fgetc(options->input) ) != EOF) {
+	left = stream->length - stream->offset;
+	if (len > left)
+		len = (size_t) left;
+	if (len == 0)
+		return(0);
+	memcpy(buf, stream->base + stream->offset, len);
+	stream->offset += len;
+	return((ssize_t) len);
+}
+
+static ssize_t mem_pread(le_stream_t *stream, void *buf, size_t len, unsigned long long offset)
+{
+	if (offset >= stream->length)
+		return(0);
+	if (len > stream->length - offset)
+		len = (size_t) (stream->length - offset);
+	memcpy(buf, stream->base + offset, len);
+	return((ssize_t) len);
+}
+
+static ssize_t mem_write(le_stream_t *stream, const void *buf, size_t len)
+{
+	unsigned long long want;
+	unsigned char *grown;
+
+	want = stream->offset + len;
+	if (want > stream->capacity) {
+		if (!stream->owned) {
+			len = (size_t) (stream->capacity - stream->offset);
+			if (len == 0) {
+				errno = ENOSPC;
+				return(-1);
+			}
+		} else {
+			if (want < 2 * stream->capacity)
+				want = 2 * stream->capacity;
+			if ((grown = realloc(stream->base, (size_t) want)) == NULL)
+				return(-1);
+			stream->base = grown;
+			stream->capacity = want;
+		}
+	}
+	memcpy(stream->base + stream->offset, buf, len);
+	stream->offset += len;
+	if (stream->offset > stream->length)
+		stream->length = stream->offset;
+	return((ssize_t) len);
+}
+
+static long long mem_size(le_stream_t *stream)
+{
+	return((long long) stream->length);
+}
+
+static int mem_close(le_stream_t *stream)
+{
+	if (stream->owned)
+		free(stream->base);
+	return(0);
+}
+
+static int mmap_close(le_stream_t *stream)
+{
+	int rc = 0;
+
+	if ((stream->base != NULL) && (munmap(stream->base, (size_t) stream->length) == -1))
+		rc = -1;
+	if (close(stream->fd) == -1)
+		rc = -1;
+	return(rc);
+}
+
+static const le_stream_ops_t stdio_ops = {
+	"stdio", stdio_read, stdio_write, stdio_pread, stdio_size, stdio_close
+};
+
+static const le_stream_ops_t fd_ops = {
+	"fd", fd_read, fd_write, fd_pread, fd_size, fd_close
+};
+
+static const le_stream_ops_t mmap_ops = {
+	"mmap", mem_read, NULL, mem_pread, mem_size, mmap_close
+};
+
+static const le_stream_ops_t mem_ops = {
+	"memory", mem_read, mem_write, mem_pread, mem_size, mem_close
+};
+
+static const le_stream_ops_t device_ops = {
+	"device", fd_read, NULL, NULL, NULL, device_close
+};
+
+static const le_stream_ops_t stripe_ops;	/* stripe sets, see le_open_stripe */
+
+/*  le_open_custom  --  wrap a caller supplied backend.  */
+
+le_stream_t *le_open_custom(const le_stream_ops_t *ops, void *handle)
+{
+	le_stream_t *stream;
+
+	if ((stream = calloc(1, sizeof(le_stream_t))) == NULL)
+		return(NULL);
+	stream->ops = ops;
+	stream->handle = handle;
+	stream->fd = -1;
+	return(stream);
+}
+
+/*  le_open_stdio  --  stream over an open FILE; stdin/stdout are never closed.  */
+
+le_stream_t *le_open_stdio(FILE *fp, int owned)
+{
+	le_stream_t *stream;
+
+	if ((stream = le_open_custom(&stdio_ops, NULL)) == NULL)
+		return(NULL);
+	stream->fp = fp;
+	stream->fd = fileno(fp);
+	stream->owned = owned;
+	return(stream);
+}
+
+/*  le_open_fd  --  stream over a raw file descriptor.  */
+
+le_stream_t *le_open_fd(int fd, int owned)
+{
+	le_stream_t *stream;
+
+	if ((stream = le_open_custom(&fd_ops, NULL)) == NULL)
+		return(NULL);
+	stream->fd = fd;
+	stream->owned = owned;
+	return(stream);
+}
+
+/*  le_open_file  --  open a file by name as a raw descriptor stream.  */
+
+le_stream_t *le_open_file(const char *fsp, int flags)
+{
+	le_stream_t *stream;
+	int fd;
+
+	if ((fd = open(fsp, flags | O_CLOEXEC, 0644)) < 0)
+		return(NULL);
+	if ((stream = le_open_fd(fd, TRUE)) == NULL)
+		close(fd);
+	return(stream);
+}
+
+/*  le_open_mmap  --  map a whole file read-only; falls back to a plain
+	descriptor stream when the file cannot be mapped (pipes, devices,
+	or a pad larger than the address space allows).  */
+
+le_stream_t *le_open_mmap(const char *fsp)
+{
+	le_stream_t *stream;
+	long long len;
+	void *base = NULL;
+	int fd;
+
+	if ((fd = open(fsp, O_RDONLY | O_CLOEXEC)) < 0)
+		return(NULL);
+	if ((len = fd_size_of(fd)) < 0) {
+		if ((stream = le_open_fd(fd, TRUE)) == NULL)
+			close(fd);
+		return(stream);
+	}
+	if ((len > 0) && ((base = mmap(NULL, (size_t) len, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)) {
+		if ((stream = le_open_fd(fd, TRUE)) == NULL)
+			close(fd);
+		return(stream);
+	}
+	if ((stream = le_open_custom(&mmap_ops, NULL)) == NULL) {
+		if (base != NULL)
+			munmap(base, (size_t) len);
+		close(fd);
+		return(NULL);
+	}
+	stream->fd = fd;
+	stream->owned = TRUE;
+	stream->base = base;
+	stream->length = stream->capacity = (unsigned long long) len;
+	return(stream);
+}
+
+/*  le_open_mem  --  memory buffer source (buf, len) or sink.  With buf NULL
+	the stream owns a buffer that grows on write; base/length hold the data.  */
+
+le_stream_t *le_open_mem(void *buf, size_t len, size_t capacity)
+{
+	le_stream_t *stream;
+
+	if ((stream = le_open_custom(&mem_ops, NULL)) == NULL)
+		return(NULL);
+	stream->base = buf;
+	stream->length = len;
+	stream->capacity = (capacity > len) ? capacity : len;
+	stream->owned = (buf == NULL);
+	return(stream);
+}
+
+/*  le_open_device  --  open an RNG device for harvesting.  */
+
+le_stream_t *le_open_device(const char *devname)
+{
+	le_stream_t *stream;
+	health_t *health;
+	int fd;
+
+	if ((fd = open(devname, O_RDONLY | O_CLOEXEC)) < 0)
+		return(NULL);
+	if ((health = calloc(1, sizeof(health_t))) == NULL) {
+		close(fd);
+		return(NULL);
+	}
+	if ((stream = le_open_custom(&device_ops, health)) == NULL) {
+		free(health);
+		close(fd);
+		return(NULL);
+	}
+	stream->fd = fd;
+	stream->owned = TRUE;
+	return(stream);
+}
+
+/*  le_close  --  close and release a stream; NULL is accepted.  */
+
+int le_close(le_stream_t *stream)
+{
+	int rc = 0;
+
+	if (stream == NULL)
+		return(0);
+	if (stream->ops->close != NULL)
+		rc = stream->ops->close(stream);
+	free(stream);
+	return(rc);
+}
+
+/*  Page cache policy  --  how much of the page cache a run may hold.
+
+	A pad is read once and never again, yet under LE_IO_CACHE (the
+	default) a multi-GB E, D or P leaves the pad, its input and its
+	output in the page cache, evicting the working set of everything
+	else on the host.  io_policy sets options->io_policy on the file
+	streams of a command (pipes, stdio and devices are left alone).
+	LE_IO_STREAM tells the kernel the access is sequential, keeps
+	LE_IO_AHEAD steps of LE_IO_STEP bytes requested ahead of the read
+	cursor (POSIX_FADV_WILLNEED, MADV_WILLNEED for a mapped pad) and
+	releases everything behind it a step at a time (POSIX_FADV_DONTNEED,
+	after MADV_DONTNEED unmaps it from a mapped pad).  Written data
+	cannot be released while dirty, so each step's writeback is started
+	with sync_file_range as the step completes and waited for one step
+	later, just before that step is released; the writes overlap the
+	disk and a stream holds two or three steps of the cache.
+	LE_IO_DIRECT opens read-only descriptor streams O_DIRECT so their
+	reads skip the cache altogether; a stream falls back to LE_IO_STREAM
+	at the first read the device refuses (an unaligned buffer, offset or
+	length, or a filesystem without O_DIRECT), which for D's input is
+	the read of the ciphertext header.  Writes, and mapped pads, are
+	always handled as with LE_IO_STREAM: O_DIRECT writes of a block at
+	a time would wait for the disk on every block.  */
+
+/*  io_release  --  drop len bytes at off of a file stream from the page
+	cache.  Only touches the stream's descriptor and mapping, so the
+	pad_verify workers may call it concurrently.  */
+
+static void io_release(le_stream_t *stream, unsigned long long off, unsigned long long len)
+{
+	unsigned long long page, end;
+
+	page = (unsigned long long) sysconf(_SC_PAGESIZE);
+	end = off + len;
+	off -= off % page;
+	if (stream->base != NULL) {
+		if (end > stream->length)
+			end = stream->length;
+		if (end > off)
+			madvise(stream->base + off, (size_t) (end - off), MADV_DONTNEED);
+	}
+	if (end > off)
+		posix_fadvise(stream->fd, (off_t) off, (off_t) (end - off), POSIX_FADV_DONTNEED);
+}
+
+/*  io_advise  --  apply the stream's policy once bytes lo to hi have
+	been read (or, with wrote, written).  */
+
+static void io_advise(le_stream_t *stream, unsigned long long lo, unsigned long long hi, int wrote)
+{
+	unsigned long long from, to;
+
+	if (stream->policy != LE_IO_STREAM)
+		return;
+	if (wrote) {
+		to = hi / LE_IO_STEP * LE_IO_STEP;
+		if (to <= stream->synced)
+			return;
+		sync_file_range(stream->fd, (off_t) stream->synced, (off_t) (to - stream->synced), SYNC_FILE_RANGE_WRITE);
+		if (stream->synced > stream->dropped) {
+			sync_file_range(stream->fd, (off_t) stream->dropped, (off_t) (stream->synced - stream->dropped),
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+			io_release(stream, stream->dropped, stream->synced - stream->dropped);
+			stream->dropped = stream->synced;
+		}
+		stream->synced = to;
+		return;
+	}
+
+	to = (hi / LE_IO_STEP + LE_IO_AHEAD) * LE_IO_STEP;
+	if (stream->ahead < to) {
+		from = (stream->ahead > lo) ? stream->ahead : lo / LE_IO_STEP * LE_IO_STEP;
+		if (stream->base == NULL)
+			posix_fadvise(stream->fd, (off_t) from, (off_t) (to - from), POSIX_FADV_WILLNEED);
+		else
+			if (from < stream->length)
+				madvise(stream->base + from, (size_t) (((to < stream->length) ? to : stream->length) - from), MADV_WILLNEED);
+		stream->ahead = to;
+	}
+	to = hi / LE_IO_STEP * LE_IO_STEP;
+	if (to > stream->dropped) {
+		io_release(stream, stream->dropped, to - stream->dropped);
+		stream->dropped = to;
+	}
+}
+
+/*  le_read  --  read up to len bytes, retrying short reads from devices
+	and pipes.  Returns the count read (less than len only at end of
+	stream) or -1 on error.  */
+
+ssize_t le_read(le_stream_t *stream, void *buf, size_t len)
+{
+	unsigned char *bp = buf;
+	size_t total = 0;
+	ssize_t n;
+	double t0;
+
+	if (stream->ops->read == NULL) {
+		errno = EBADF;
+		return(-1);
+	}
+	if (stream->bounded && (len > stream->remain))
+		len = (size_t) stream->remain;
+	LE_PROBE2(read_start, LE_ROLE(stream), len);
+	t0 = now_seconds();
+	while (total < len) {
+		stream->stats.rcalls++;
+		if ((n = stream->ops->read(stream, bp + total, len - total)) < 0) {
+			if (errno == EINTR)
+				continue;
+			total = (size_t) -1;
+			break;
+		}
+		if (n == 0)
+			break;
+		total += (size_t) n;
+	}
+	stream->stats.seconds += now_seconds() - t0;
+	LE_PROBE2(read_done, LE_ROLE(stream), (ssize_t) total);
+	if (total == (size_t) -1)
+		return(-1);
+	stream->stats.rbytes += total;
+	stream->position += total;
+	if (stream->bounded)
+		stream->remain -= total;
+	if (stream->policy != LE_IO_CACHE)
+		io_advise(stream, stream->position - total, stream->position, FALSE);
+	return((ssize_t) total);
+}
+
+/*  le_write  --  write all len bytes or fail with -1.  */
+
+ssize_t le_write(le_stream_t *stream, const void *buf, size_t len)
+{
+	const unsigned char *bp = buf;
+	size_t total = 0;
+	ssize_t n;
+	double t0;
+
+	if (stream->ops->write == NULL) {
+		errno = EBADF;
+		return(-1);
+	}
+	LE_PROBE2(write_start, LE_ROLE(stream), len);
+	t0 = now_seconds();
+	while (total < len) {
+		stream->stats.wcalls++;
+		if ((n = stream->ops->write(stream, bp + total, len - total)) <= 0) {
+			if ((n < 0) && (errno == EINTR))
+				continue;
+			stream->stats.seconds += now_seconds() - t0;
+			LE_PROBE2(write_done, LE_ROLE(stream), (ssize_t) -1);
+			return(-1);
+		}
+		total += (size_t) n;
+	}
+	stream->stats.seconds += now_seconds() - t0;
+	LE_PROBE2(write_done, LE_ROLE(stream), (ssize_t) total);
+	stream->stats.wbytes += total;
+	stream->written += total;
+	if (stream->policy != LE_IO_CACHE)
+		io_advise(stream, stream->written - total, stream->written, TRUE);
+	return((ssize_t) total);
+}
+
+/*  le_pread  --  positional read; does not move the stream position.  */
+
+ssize_t le_pread(le_stream_t *stream, void *buf, size_t len, unsigned long long offset)
+{
+	unsigned char *bp = buf;
+	size_t total = 0;
+	ssize_t n;
+
+	double t0;
+
+	if (stream->ops->pread == NULL) {
+		errno = ESPIPE;
+		return(-1);
+	}
+	LE_PROBE2(pread_start, LE_ROLE(stream), len);
+	t0 = now_seconds();
+	while (total < len) {
+		stream->stats.rcalls++;
+		if ((n = stream->ops->pread(stream, bp + total, len - total, offset + total)) < 0) {
+			if (errno == EINTR)
+				continue;
+			total = (size_t) -1;
+			break;
+		}
+		if (n == 0)
+			break;
+		total += (size_t) n;
+	}
+	stream->stats.seconds += now_seconds() - t0;
+	LE_PROBE2(pread_done, LE_ROLE(stream), (ssize_t) total);
+	if (total == (size_t) -1)
+		return(-1);
+	stream->stats.rbytes += total;
+	return((ssize_t) total);
+}
+
+/*  stream_pread  --  le_pread without the statistics, for worker threads
+	sharing a stream; the caller accounts for the bytes.  */
+
+static ssize_t stream_pread(le_stream_t *stream, void *buf, size_t len, unsigned long long offset)
+{
+	unsigned char *bp = buf;
+	size_t total = 0;
+	ssize_t n;
+
+	LE_PROBE2(pread_start, LE_ROLE(stream), len);
+	while (total < len) {
+		if ((n = stream->ops->pread(stream, bp + total, len - total, offset + total)) < 0) {
+			if (errno == EINTR)
+				continue;
+			LE_PROBE2(pread_done, LE_ROLE(stream), (ssize_t) -1);
+			return(-1);
+		}
+		if (n == 0)
+			break;
+		total += (size_t) n;
+	}
+	LE_PROBE2(pread_done, LE_ROLE(stream), (ssize_t) total);
+	return((ssize_t) total);
+}
+
+/*  le_size  --  size hint in bytes, or -1 when unknown (pipes, devices).
+	A bounded stream reports the bytes it has left.  */
+
+long long le_size(le_stream_t *stream)
+{
+	if (stream->bounded)
+		return((long long) stream->remain);
+	if (stream->ops->size == NULL)
+		return(-1);
+	return(stream->ops->size(stream));
+}
+
+/*  le_seek  --  set the position of a memory, mapped, stdio or seekable
+	descriptor stream and lift any read bound.  */
+
+int le_seek(le_stream_t *stream, unsigned long long offset)
+{
+	stream->bounded = FALSE;
+	if ((stream->ops == &mmap_ops) || (stream->ops == &mem_ops) || (stream->ops == &stripe_ops)) {
+		if (offset > stream->length)
+			return(EXIT_FAILURE);
+		stream->offset = offset;
+	} else
+		if (stream->fp != NULL) {
+			if (fseeko(stream->fp, (off_t) offset, SEEK_SET) != 0)
+				return(EXIT_FAILURE);
+		} else
+			if ((stream->fd < 0) || (lseek(stream->fd, (off_t) offset, SEEK_SET) == (off_t) -1))
+				return(EXIT_FAILURE);
+	stream->position = offset;
+	return(EXIT_SUCCESS);
+}
+
+/*  le_printf  --  formatted write of a short line to a stream.  */
+
+int le_printf(le_stream_t *stream, const char *fmt, ...)
+{
+	char line[LE_PRINTF_MAX];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return(-1);
+	if (n >= (int) sizeof(line))
+		n = sizeof(line) - 1;
+	return(le_write(stream, line, (size_t) n) == n ? n : -1);
+}
+
+/*  xor_block  --  dst ^= src over len bytes.  */
+
+static void xor_block(unsigned char *dst, const unsigned char *src, size_t len)
+{
+	size_t i;
+
+	LE_PROBE1(xor_start, len);
+	for (i = 0; i < len; i++)
+		dst[i] ^= src[i];
+	LE_PROBE1(xor_done, len);
+}
+
+/*  Jobs  --  asynchronous command execution.
+
+	le_job_start runs any command (g_generate, e_encrypt, d_decrypt,
+	p_pyx) on its own thread and returns a handle at once.  Commands
+	report each completed block through tick(); the job turns those
+	into progress snapshots (bytes done, throughput, ETA) delivered to
+	the callback at most once per interval, plus once on completion.
+	le_job_cancel makes the next tick fail, so the command releases its
+	buffers and returns EXIT_FAILURE with ERR_CANCELLED; a read already
+	blocked on a slow RNG device completes first.  Every started job
+	must be collected with le_job_wait, which also frees the handle.  */
+
+struct le_job {
+	pthread_t				thread;
+	pthread_mutex_t			lock;
+	FUNC					func;
+	options_t				*options;
+	le_progress_fn			callback;
+	void					*arg;
+	double					interval;
+	double					started;
+	double					reported;
+	le_progress_t			progress;
+	int						cancelled;
+	int						finished;
+	int						result;
+};
+
+/*  job_update  --  refresh the progress snapshot; caller holds the lock.  */
+
+static void job_update(le_job_t *job, double now)
+{
+	le_progress_t *pg = &job->progress;
+
+	pg->elapsed = now - job->started;
+	pg->rate = (pg->elapsed > 0.0) ? pg->done / pg->elapsed : 0.0;
+	if ((pg->total > 0) && (pg->rate > 0.0))
+		pg->eta = (pg->total > pg->done) ? (pg->total - pg->done) / pg->rate : 0.0;
+	else
+		pg->eta = -1.0;
+}
+
+/*  tick_total  --  announce the expected byte count (0 when unknown).  */
+
+static void tick_total(options_t *options, long long total)
+{
+	le_job_t *job = options->job;
+
+	if (job == NULL)
+		return;
+	pthread_mutex_lock(&job->lock);
+	job->progress.total = (total > 0) ? (unsigned long long) total : 0;
+	pthread_mutex_unlock(&job->lock);
+}
+
+/*  tick  --  account for a completed block; fails once cancelled.  */
+
+static int tick(options_t *options, unsigned long long bytes)
+{
+	le_job_t *job = options->job;
+	le_progress_t snap;
+	int report = FALSE;
+	double now;
+
+	options->stats.bytes += bytes;
+
+	if (job == NULL)
+		return(EXIT_SUCCESS);
+
+	if (__atomic_load_n(&job->cancelled, __ATOMIC_RELAXED)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CANCELLED);
+		return(EXIT_FAILURE);
+	}
+
+	now = now_seconds();
+	pthread_mutex_lock(&job->lock);
+	job->progress.done += bytes;
+	if ((job->callback != NULL) && (now - job->reported >= job->interval)) {
+		job->reported = now;
+		job_update(job, now);
+		snap = job->progress;
+		report = TRUE;
+	}
+	pthread_mutex_unlock(&job->lock);
+
+	if (report)
+		job->callback(&snap, job->arg);
+	return(EXIT_SUCCESS);
+}
+
+static void *job_main(void *arg)
+{
+	le_job_t *job = arg;
+	le_progress_t snap;
+	int result;
+
+	result = job->func(job->options);
+
+	pthread_mutex_lock(&job->lock);
+	job_update(job, now_seconds());
+	job->progress.eta = 0.0;
+	snap = job->progress;
+	pthread_mutex_unlock(&job->lock);
+
+	if (job->callback != NULL)
+		job->callback(&snap, job->arg);
+
+	pthread_mutex_lock(&job->lock);
+	job->result = result;
+	job->finished = TRUE;
+	pthread_mutex_unlock(&job->lock);
+	return(NULL);
+}
+
+/*  le_job_start  --  run func(options) asynchronously.  callback may be
+	NULL; interval is the minimum number of seconds between reports.  */
+
+le_job_t *le_job_start(FUNC func, options_t *options, le_progress_fn callback, void *arg, double interval)
+{
+	le_job_t *job;
+
+	if ((job = calloc(1, sizeof(le_job_t))) == NULL)
+		return(NULL);
+	job->func = func;
+	job->options = options;
+	job->callback = callback;
+	job->arg = arg;
+	job->interval = interval;
+	job->started = job->reported = now_seconds();
+	job->progress.eta = -1.0;
+	pthread_mutex_init(&job->lock, NULL);
+	options->job = job;
+
+	if (pthread_create(&job->thread, NULL, job_main, job) != 0) {
+		options->job = NULL;
+		pthread_mutex_destroy(&job->lock);
+		free(job);
+		return(NULL);
+	}
+	return(job);
+}
+
+/*  le_job_cancel  --  request cancellation; returns immediately.  */
+
+void le_job_cancel(le_job_t *job)
+{
+	__atomic_store_n(&job->cancelled, TRUE, __ATOMIC_RELAXED);
+}
+
+/*  le_job_finished  --  non-blocking poll for completion.  */
+
+int le_job_finished(le_job_t *job)
+{
+	int finished;
+
+	pthread_mutex_lock(&job->lock);
+	finished = job->finished;
+	pthread_mutex_unlock(&job->lock);
+	return(finished);
+}
+
+/*  le_job_progress  --  take a progress snapshot.  */
+
+void le_job_progress(le_job_t *job, le_progress_t *progress)
+{
+	pthread_mutex_lock(&job->lock);
+	if (!job->finished)
+		job_update(job, now_seconds());
+	*progress = job->progress;
+	pthread_mutex_unlock(&job->lock);
+}
+
+/*  le_job_wait  --  wait for completion, free the handle and return the
+	command result; options->errmsg holds the reason on failure.  */
+
+int le_job_wait(le_job_t *job)
+{
+	int result;
+
+	pthread_join(job->thread, NULL);
+	result = job->result;
+	job->options->job = NULL;
+	pthread_mutex_destroy(&job->lock);
+	free(job);
+	return(result);
+}
+
+int set_default_device(options_t *options) 
+{
+	snprintf(options->devname, sizeof(options->devname), "%s", DEV_DEFAULT_1);
+	if ((options->device = le_open_device(options->devname)) == NULL) {
+		snprintf(options->devname, sizeof(options->devname), "%s", DEV_DEFAULT_2);
+
+		if ((options->device = le_open_device(options->devname)) == NULL) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_DEF_DEV);
+			return(EXIT_FAILURE);
+		}    
+
+
+
+	}
+
+	return(EXIT_SUCCESS);
+
+}
+
+/*  Buffer pool  --  library-wide arena of aligned I/O buffers.
+
+	Buffers are carved from large anonymous arenas, so they are page
+	aligned (usable with O_DIRECT) and, when the arenas are huge-page
+	backed, cost few TLB entries on multi-GB passes.  Sizes are rounded
+	up to a power of two class of LE_POOL_ALIGN << k, and a buffer
+	returned with le_buf_put goes on the free list of its class, linked
+	through the free buffers themselves, for the next le_buf_get of that
+	class.  Freed space is always reused, never forgotten, so commands,
+	jobs and a long-running server reach a steady state with no malloc
+	or mmap in the hot path however their sizes vary; memory grows only
+	with the most buffers of a class out at once.  Classes up to
+	LE_POOL_ARENA share arenas and larger ones get an arena each.  Each
+	arena keeps one byte per page naming the class of the buffer that
+	starts there, which is how le_buf_put finds the class.
+	le_pool_config selects transparent huge pages (default), explicit
+	MAP_HUGETLB pages and mlock for arenas mapped afterwards; each falls
+	back silently when the kernel or limits refuse.  */
+
+typedef struct {
+	unsigned char			*base;
+	size_t					size;
+	size_t					used;
+	unsigned char			*cls;		/* class of the buffer at each page carved */
+} pool_arena_t;
+
+static struct {
+	pthread_mutex_t			lock;
+	int						flags;
+	int						arenas;
+	int						max_arenas;
+	pool_arena_t			*arena;
+	unsigned char			*free[LE_POOL_CLASSES];	/* free lists, linked through the buffers */
+	int						out;		/* buffers handed out */
+} pool = { PTHREAD_MUTEX_INITIALIZER, LE_POOL_THP, 0, 0, NULL, { NULL }, 0 };
+
+/*  le_pool_config  --  choose backing for arenas mapped from now on.  */
+
+void le_pool_config(int flags)
+{
+	int i;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.flags = flags;
+	if (flags & LE_POOL_MLOCK)
+		for (i = 0; i < pool.arenas; i++)
+			mlock(pool.arena[i].base, pool.arena[i].size);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static unsigned char *pool_map(size_t size, int flags)
+{
+	void *p = MAP_FAILED;
+
+	if (flags & LE_POOL_HUGETLB)
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p == MAP_FAILED) {
+		p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			return(NULL);
+		if (flags & (LE_POOL_THP | LE_POOL_HUGETLB))
+			madvise(p, size, MADV_HUGEPAGE);
+	}
+	if (flags & LE_POOL_MLOCK)
+		mlock(p, size);
+	return(p);
+}
+
+/*  pool_arena_new  --  map an arena of size bytes; the lock is held.  */
+
+static pool_arena_t *pool_arena_new(size_t size)
+{
+	pool_arena_t *grown, *ar;
+	unsigned char *base;
+
+	if (pool.arenas == pool.max_arenas) {
+		if ((grown = realloc(pool.arena, (size_t) (pool.max_arenas + 16) * sizeof(pool_arena_t))) == NULL)
+			return(NULL);
+		pool.arena = grown;
+		pool.max_arenas += 16;
+	}
+	ar = &pool.arena[pool.arenas];
+	if ((ar->cls = malloc(size / LE_POOL_ALIGN)) == NULL)
+		return(NULL);
+	if ((base = pool_map(size, pool.flags)) == NULL) {
+		free(ar->cls);
+		return(NULL);
+	}
+	ar->base = base;
+	ar->size = size;
+	ar->used = 0;
+	pool.arenas++;
+	return(ar);
+}
+
+/*  le_buf_get  --  aligned buffer of at least size bytes, or NULL.  */
+
+void *le_buf_get(size_t size)
+{
+	unsigned char *buf = NULL;
+	pool_arena_t *ar = NULL;
+	size_t want;
+	int k, a;
+
+	for (k = 0, want = LE_POOL_ALIGN; (want < size) && (k < LE_POOL_CLASSES); k++)
+		want <<= 1;
+	if (k == LE_POOL_CLASSES)
+		return(NULL);
+
+	pthread_mutex_lock(&pool.lock);
+	if ((buf = pool.free[k]) != NULL) {
+		memcpy(&pool.free[k], buf, sizeof(unsigned char *));
+		pool.out++;
+		goto out;
+	}
+
+	if (want <= LE_POOL_ARENA)
+		for (a = pool.arenas - 1; (a >= 0) && (ar == NULL); a--)
+			if (pool.arena[a].size - pool.arena[a].used >= want)
+				ar = &pool.arena[a];
+	if ((ar == NULL) && ((ar = pool_arena_new((want < LE_POOL_ARENA) ? LE_POOL_ARENA : want)) == NULL))
+		goto out;
+	buf = ar->base + ar->used;
+	ar->cls[ar->used / LE_POOL_ALIGN] = (unsigned char) k;
+	ar->used += want;
+	pool.out++;
+
+out:
+	pthread_mutex_unlock(&pool.lock);
+	return(buf);
+}
+
+/*  le_buf_put  --  return a buffer to the free list of its class; NULL is
+	accepted.  */
+
+void le_buf_put(void *buf)
+{
+	unsigned char *p = buf;
+	pool_arena_t *ar;
+	int a, k;
+
+	if (p == NULL)
+		return;
+	pthread_mutex_lock(&pool.lock);
+	for (a = pool.arenas - 1; a >= 0; a--) {
+		ar = &pool.arena[a];
+		if ((p >= ar->base) && (p < ar->base + ar->used)) {
+			k = ar->cls[(size_t) (p - ar->base) / LE_POOL_ALIGN];
+			memcpy(p, &pool.free[k], sizeof(unsigned char *));
+			pool.free[k] = p;
+			pool.out--;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/*  le_pool_release  --  unmap every arena; fails while buffers are out.  */
+
+int le_pool_release(void)
+{
+	int i;
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.out > 0) {
+		pthread_mutex_unlock(&pool.lock);
+		return(EXIT_FAILURE);
+	}
+	for (i = 0; i < pool.arenas; i++) {
+		munmap(pool.arena[i].base, pool.arena[i].size);
+		free(pool.arena[i].cls);
+	}
+	pool.arenas = 0;
+	memset(pool.free, 0, sizeof(pool.free));
+	pthread_mutex_unlock(&pool.lock);
+	return(EXIT_SUCCESS);
+}
+
+/*  alloc_blocks  --  claim n I/O block buffers of LE_BLOCK_SIZE bytes.  */
+
+static unsigned char *alloc_blocks(options_t *options, int n)
+{
+	unsigned char *blocks;
+
+	if ((blocks = le_buf_get((size_t) n * LE_BLOCK_SIZE)) == NULL)
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+	return(blocks);
+}
+
+/*  Health tests  --  SP 800-90B continuous tests on device output.
+
+	Every byte harvested from an le_open_device stream goes through the
+	repetition count test (fails when one value repeats rct_cutoff times
+	in a row) and the adaptive proportion test (fails when the first
+	value of a LE_HEALTH_W byte window recurs apt_cutoff times in it).
+	Cutoffs follow 90B section 4.4 for an assumed min-entropy of
+	LE_HEALTH_H bits per byte and a false alarm rate of 2^-LE_HEALTH_ALPHA,
+	so a healthy full entropy source practically never trips them while
+	a stuck or heavily biased one is caught within a window.  A failure
+	is latched: the device yields nothing more until it is reopened.  */
+
+/*  health_critbinom  --  smallest k with P(Binomial(n, p) <= k) >= 1 - alpha.  */
+
+static int health_critbinom(int n, double p, double alpha)
+{
+	double pmf, cdf;
+	int k;
+
+	pmf = pow(1.0 - p, n);
+	for (k = 0, cdf = pmf; (cdf < 1.0 - alpha) && (k < n); k++) {
+		pmf *= ((double) (n - k) / (double) (k + 1)) * (p / (1.0 - p));
+		cdf += pmf;
+	}
+	return(k);
+}
+
+/*  health_check  --  run both tests over buf.  Eight bytes are taken at
+	a time: the window count adds the zero bytes of word ^ first, and a
+	word with no two equal neighbours (the usual case) ends any run, so
+	only words holding a repeat are walked byte by byte.  */
+
+static const char *health_check(health_t *h, const unsigned char *buf, size_t len)
+{
+	const unsigned long long ones = 0x0101010101010101ULL, lows = 0x7f7f7f7f7f7f7f7fULL, highs = 0x8080808080808080ULL;
+	unsigned long long w, x;
+	size_t i, j, k, n, end;
+
+	if (h->rct_cutoff == 0) {
+		h->rct_cutoff = 1 + (LE_HEALTH_ALPHA + LE_HEALTH_H - 1) / LE_HEALTH_H;
+		h->apt_cutoff = 1 + health_critbinom(LE_HEALTH_W, 1.0 / (1 << LE_HEALTH_H), ldexp(1.0, -LE_HEALTH_ALPHA));
+		h->last = -1;
+	}
+
+	for (i = 0; (i < len) && (h->failed == NULL); i += n) {
+		if (h->seen == 0) {
+			h->first = buf[i];
+			h->count = 0;
+		}
+		if ((n = (size_t) (LE_HEALTH_W - h->seen)) > len - i)
+			n = len - i;
+
+		/* adaptive proportion: bytes of this window equal to its first */
+
+		for (j = 0; j + 8 <= n; j += 8) {
+			memcpy(&w, buf + i + j, 8);
+			x = w ^ (ones * (unsigned long long) h->first);
+			h->count += __builtin_popcountll(~(((x & lows) + lows) | x) & highs);
+		}
+		for (; j < n; j++)
+			h->count += (buf[i + j] == h->first);
+		if (h->count >= h->apt_cutoff)
+			h->failed = ERR_HEALTH_APT;
+		h->seen = (h->seen + (int) n) % LE_HEALTH_W;
+
+		/* repetition count */
+
+		for (j = 0; j < n; j = end) {
+			end = (j + 8 < n) ? j + 8 : n;
+			if ((end == j + 8) && (i + j > 0)) {
+				memcpy(&w, buf + i + j, 8);
+				memcpy(&x, buf + i + j - 1, 8);
+				x ^= w;
+				if (((x - ones) & ~x & highs) == 0) {
+					h->last = buf[i + end - 1];
+					h->run = 1;
+					continue;
+				}
+			}
+			for (k = j; k < end; k++)
+				if (buf[i + k] != h->last) {
+					h->last = buf[i + k];
+					h->run = 1;
+				} else
+					if (++h->run >= h->rct_cutoff)
+						h->failed = ERR_HEALTH_RCT;
+		}
+	}
+	return(h->failed);
+}
+
+/*  harvest_raw  --  fill buf with exactly len bytes from the RNG device,
+	health testing them on the way.  */
+
+static int harvest_raw(options_t *options, unsigned char *buf, size_t len)
+{
+	const char *failed;
+
+	if (le_read(options->device, buf, len) != (ssize_t) len) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_GET_DEV);
+		return(EXIT_FAILURE);
+	}
+	if ((options->device->ops == &device_ops)
+		&& ((failed = health_check(options->device->handle, buf, len)) != NULL)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", failed);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  Conditioning  --  extractors between the RNG device and the pad.
+
+	A cheap raw source that is slightly biased can still make pads that
+	pass Pyx once its output is conditioned.  options->condition picks
+	the extractor: von Neumann debiasing (LE_COND_VN) keeps the first bit
+	of every unequal bit pair, removing any bias from independent bits
+	at a cost of at least 4 raw bytes per output byte; XOR folding
+	(LE_COND_XOR) XORs fold raw bytes into each output byte, shrinking a
+	bit bias e to 2^(fold-1) e^fold; and LE_COND_SHA256 runs the SHA-256
+	compression function over each 64 raw bytes to give 32.  The health
+	tests always see the raw bytes.  Each extractor works a word or a
+	block at a time, using BMI2 PEXT and the SHA extensions where the CPU
+	has them, so it runs well ahead of any hardware RNG.  */
+
+static const unsigned int sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const unsigned int sha256_iv[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#define ROR32(x, n)		(((x) >> (n)) | ((x) << (32 - (n))))
+
+/*  sha256_block  --  one SHA-256 compression of the 64 bytes at p into state.  */
+
+static void sha256_block(unsigned int state[8], const unsigned char *p)
+{
+	unsigned int w[64], s[8], t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = ((unsigned int) p[4 * i] << 24) | ((unsigned int) p[4 * i + 1] << 16) | ((unsigned int) p[4 * i + 2] << 8) | p[4 * i + 3];
+	for (; i < 64; i++)
+		w[i] = (ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7]
+			+ (ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+	memcpy(s, state, sizeof(s));
+	for (i = 0; i < 64; i++) {
+		t1 = s[7] + (ROR32(s[4], 6) ^ ROR32(s[4], 11) ^ ROR32(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha256_k[i] + w[i];
+		t2 = (ROR32(s[0], 2) ^ ROR32(s[0], 13) ^ ROR32(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+		memmove(s + 1, s, 7 * sizeof(unsigned int));
+		s[4] += t1;
+		s[0] = t1 + t2;
+	}
+	for (i = 0; i < 8; i++)
+		state[i] += s[i];
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LE_HAVE_SHANI	1
+#define LE_HAVE_PEXT	1
+
+/*  sha256_block_shani  --  sha256_block with the SHA extensions.  The
+	state is kept as ABEF/CDGH lane pairs; each pass does four rounds
+	and extends the message schedule by four words.  */
+
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_block_shani(unsigned int state[8], const unsigned char *p)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i st0, st1, save0, save1, tmp, m[4];
+	int i;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0xb1);
+	st1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (state + 4)), 0x1b);
+	st0 = _mm_alignr_epi8(tmp, st1, 8);
+	st1 = _mm_blend_epi16(st1, tmp, 0xf0);
+	save0 = st0;
+	save1 = st1;
+
+	for (i = 0; i < 4; i++)
+		m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (p + 16 * i)), mask);
+	for (i = 0; i < 16; i++) {
+		tmp = _mm_add_epi32(m[i & 3], _mm_loadu_si128((const __m128i *) (sha256_k + 4 * i)));
+		st1 = _mm_sha256rnds2_epu32(st1, st0, tmp);
+		st0 = _mm_sha256rnds2_epu32(st0, st1, _mm_shuffle_epi32(tmp, 0x0e));
+		if (i < 12) {
+			tmp = _mm_add_epi32(_mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]), _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4));
+			m[i & 3] = _mm_sha256msg2_epu32(tmp, m[(i + 3) & 3]);
+		}
+	}
+
+	st0 = _mm_add_epi32(st0, save0);
+	st1 = _mm_add_epi32(st1, save1);
+	tmp = _mm_shuffle_epi32(st0, 0x1b);
+	st1 = _mm_shuffle_epi32(st1, 0xb1);
+	_mm_storeu_si128((__m128i *) state, _mm_blend_epi16(tmp, st1, 0xf0));
+	_mm_storeu_si128((__m128i *) (state + 4), _mm_alignr_epi8(st1, tmp, 8));
+}
+
+/*  vn_word_bmi2  --  von Neumann bits of one 64 bit word: PEXT gathers
+	the first bit of each unequal pair.  */
+
+__attribute__((target("bmi2,popcnt")))
+static unsigned long long vn_word_bmi2(unsigned long long w, int *n)
+{
+	unsigned long long m;
+
+	m = (w ^ (w >> 1)) & 0x5555555555555555ULL;
+	*n = __builtin_popcountll(m);
+	return(_pext_u64(w, m));
+}
+#endif
+
+/*  vn_word  --  vn_word_bmi2 without PEXT, a byte (four pairs) at a time.  */
+
+static unsigned long long vn_word(unsigned long long w, int *n)
+{
+	unsigned long long bits = 0;
+	unsigned int b;
+	int i, j, c = 0;
+
+	for (i = 0; i < 64; i += 8) {
+		b = (unsigned int) (w >> i) & 0xff;
+		for (j = 0; j < 8; j += 2)
+			if (((b >> j) ^ (b >> (j + 1))) & 1)
+				bits |= (unsigned long long) ((b >> j) & 1) << c++;
+	}
+	*n = c;
+	return(bits);
+}
+
+/*  condition_vn  --  von Neumann debias until len bytes are made.  Fails
+	rather than spin once a chunk's worth of raw bytes in a row yields
+	nothing (a stuck source the health tests did not see, as with a
+	custom stream).  */
+
+static int condition_vn(options_t *options, unsigned char *buf, size_t len, unsigned char *raw)
+{
+	unsigned long long (*word)(unsigned long long, int *) = vn_word;
+	unsigned long long w, acc = 0;
+	size_t out = 0, want, dry = 0, got, i;
+	int nb = 0, n;
+
+#ifdef LE_HAVE_PEXT
+	if (__builtin_cpu_supports("bmi2"))
+		word = vn_word_bmi2;
+#endif
+	while (out < len) {
+		want = (len - out) * 4 + 8;
+		want = (want < LE_COND_CHUNK) ? (want + 7) & ~(size_t) 7 : LE_COND_CHUNK;
+		if (harvest_raw(options, raw, want) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		for (i = got = 0; (i < want) && (out < len); i += 8) {
+			memcpy(&w, raw + i, 8);
+			acc |= word(w, &n) << nb;
+			got += (size_t) n;
+			for (nb += n; (nb >= 8) && (out < len); nb -= 8, acc >>= 8)
+				buf[out++] = (unsigned char) acc;
+		}
+		if ((dry = (got == 0) ? dry + want : 0) >= LE_COND_CHUNK) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_COND_YIELD);
+			return(EXIT_FAILURE);
+		}
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  condition_xor  --  each output byte is the XOR of fold raw bytes,
+	taken as fold consecutive slices of the raw chunk.  */
+
+static int condition_xor(options_t *options, unsigned char *buf, size_t len, unsigned char *raw)
+{
+	unsigned long long a, b;
+	size_t out, n, i;
+	int fold, k;
+
+	fold = (options->fold >= 2) && (options->fold <= LE_COND_FOLD_MAX) ? options->fold : LE_COND_FOLD;
+	for (out = 0; out < len; out += n) {
+		n = (len - out < LE_COND_CHUNK / (size_t) fold) ? len - out : LE_COND_CHUNK / (size_t) fold;
+		if (harvest_raw(options, raw, n * (size_t) fold) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		for (i = 0; i + 8 <= n; i += 8) {
+			memcpy(&a, raw + i, 8);
+			for (k = 1; k < fold; k++) {
+				memcpy(&b, raw + (size_t) k * n + i, 8);
+				a ^= b;
+			}
+			memcpy(buf + out + i, &a, 8);
+		}
+		for (; i < n; i++)
+			for (buf[out + i] = raw[i], k = 1; k < fold; k++)
+				buf[out + i] ^= raw[(size_t) k * n + i];
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  condition_sha256  --  each 32 output bytes are the SHA-256 compression
+	of 64 raw bytes from the standard initial state.  */
+
+static int condition_sha256(options_t *options, unsigned char *buf, size_t len, unsigned char *raw)
+{
+	void (*block)(unsigned int *, const unsigned char *) = sha256_block;
+	unsigned int state[8];
+	size_t out, n, i;
+	int j;
+
+#ifdef LE_HAVE_SHANI
+	if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+		block = sha256_block_shani;
+#endif
+	for (out = 0; out < len; out += n) {
+		n = (len - out < LE_COND_CHUNK / 2) ? len - out : LE_COND_CHUNK / 2;
+		if (harvest_raw(options, raw, (n + 31) / 32 * 64) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		for (i = 0; i < n; i += 32) {
+			memcpy(state, sha256_iv, sizeof(state));
+			block(state, raw + 2 * i);
+			for (j = 0; (j < 32) && (i + (size_t) j < n); j++)
+				buf[out + i + (size_t) j] = (unsigned char) (state[j / 4] >> (24 - 8 * (j % 4)));
+		}
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  harvest  --  fill buf with exactly len bytes of (conditioned) RNG
+	output.  The raw scratch of an extractor comes from the buffer pool,
+	so a steady run of calls allocates nothing.  */
+
+static int harvest(options_t *options, unsigned char *buf, size_t len)
+{
+	unsigned char *raw;
+	int result;
+
+	if ((options->condition <= LE_COND_NONE) || (options->condition > LE_COND_SHA256))
+		return(harvest_raw(options, buf, len));
+	if ((raw = le_buf_get(LE_COND_CHUNK)) == NULL) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		return(EXIT_FAILURE);
+	}
+	switch (options->condition) {
+		case LE_COND_VN:
+			result = condition_vn(options, buf, len, raw);
+			break;
+		case LE_COND_XOR:
+			result = condition_xor(options, buf, len, raw);
+			break;
+		default:
+			result = condition_sha256(options, buf, len, raw);
+			break;
+	}
+	le_buf_put(raw);
+	return(result);
+}
+
+/*  Compression  --  LZ77 block codec for compress-before-encrypt.
+
+	A byte-oriented LZ in the LZ4 style: each sequence is a token (high
+	nibble literal count, low nibble match length - 4, 15 meaning more
+	length bytes follow, 255-chained), the literals, then a 16 bit
+	little-endian match offset.  The last sequence carries literals
+	only.  Matches are found through a 4096 entry hash of 4 byte
+	prefixes, skipping faster over incompressible input, so random
+	data costs little more than a copy.  The decoder bounds-checks
+	everything: a wrong pad yields garbage, never an overrun.  */
+
+static unsigned int get32(const unsigned char *p)
+{
+	return((unsigned int) p[0] | ((unsigned int) p[1] << 8) | ((unsigned int) p[2] << 16) | ((unsigned int) p[3] << 24));
+}
+
+static void put32(unsigned char *p, unsigned int v)
+{
+	p[0] = (unsigned char) v;
+	p[1] = (unsigned char) (v >> 8);
+	p[2] = (unsigned char) (v >> 16);
+	p[3] = (unsigned char) (v >> 24);
+}
+
+static void put16(unsigned char *p, unsigned int v)
+{
+	p[0] = (unsigned char) v;
+	p[1] = (unsigned char) (v >> 8);
+}
+
+static unsigned int get16(const unsigned char *p)
+{
+	return((unsigned int) p[0] | ((unsigned int) p[1] << 8));
+}
+
+static size_t lz_length(unsigned char *dst, size_t op, size_t cap, size_t len)
+{
+	while (len >= 255) {
+		if (op >= cap)
+			return(0);
+		dst[op++] = 255;
+		len -= 255;
+	}
+	if (op >= cap)
+		return(0);
+	dst[op++] = (unsigned char) len;
+	return(op);
+}
+
+/*  lz_sequence  --  emit literals src[anchor..ip) and an optional match.  */
+
+static size_t lz_sequence(unsigned char *dst, size_t op, size_t cap, const unsigned char *lit, size_t nlit, size_t offset, size_t mlen)
+{
+	unsigned char *token;
+
+	if (op >= cap)
+		return(0);
+	token = &dst[op++];
+	*token = (unsigned char) (((nlit >= 15) ? 15 : nlit) << 4);
+	if ((nlit >= 15) && ((op = lz_length(dst, op, cap, nlit - 15)) == 0))
+		return(0);
+	if (op + nlit > cap)
+		return(0);
+	memcpy(dst + op, lit, nlit);
+	op += nlit;
+	if (mlen == 0)
+		return(op);
+
+	mlen -= LE_LZ_MINMATCH;
+	*token |= (unsigned char) ((mlen >= 15) ? 15 : mlen);
+	if (op + 2 > cap)
+		return(0);
+	put16(dst + op, (unsigned int) offset);
+	op += 2;
+	if ((mlen >= 15) && ((op = lz_length(dst, op, cap, mlen - 15)) == 0))
+		return(0);
+	return(op);
+}
+
+/*  lz_compress  --  compress n bytes into at most cap bytes.  Returns the
+	compressed size, or 0 when the output would not be smaller.  */
+
+static size_t lz_compress(const unsigned char *src, size_t n, unsigned char *dst, size_t cap)
+{
+	unsigned int table[LE_LZ_HASH];
+	size_t ip = 0, anchor = 0, op = 0, ref, mlen;
+	unsigned int seq, h;
+
+	if (cap >= n)
+		cap = (n > 0) ? n - 1 : 0;
+	memset(table, 0, sizeof(table));
+
+	while (ip + LE_LZ_MINMATCH <= n) {
+		seq = get32(src + ip);
+		h = (seq * 2654435761U) >> (32 - LE_LZ_HASHLOG);
+		ref = table[h];
+		table[h] = (unsigned int) ip;
+		if ((ref < ip) && (ip - ref <= 65535) && (get32(src + ref) == seq)) {
+			for (mlen = LE_LZ_MINMATCH; (ip + mlen < n) && (src[ref + mlen] == src[ip + mlen]); mlen++)
+				;
+			if ((op = lz_sequence(dst, op, cap, src + anchor, ip - anchor, ip - ref, mlen)) == 0)
+				return(0);
+			ip += mlen;
+			anchor = ip;
+		} else
+			ip += 1 + ((ip - anchor) >> 6);
+	}
+
+	if ((op = lz_sequence(dst, op, cap, src + anchor, n - anchor, 0, 0)) == 0)
+		return(0);
+	return(op);
+}
+
+/*  lz_decompress  --  expand n bytes into at most cap bytes.  Returns the
+	expanded size or -1 when the input is malformed.  */
+
+static long lz_decompress(const unsigned char *src, size_t n, unsigned char *dst, size_t cap)
+{
+	size_t ip = 0, op = 0, len, offset;
+	unsigned char token, b;
+
+	while (ip < n) {
+		token = src[ip++];
+		len = token >> 4;
+		if (len == 15)
+			do {
+				if (ip >= n)
+					return(-1);
+				b = src[ip++];
+				len += b;
+			} while (b == 255);
+		if ((len > n - ip) || (len > cap - op))
+			return(-1);
+		memcpy(dst + op, src + ip, len);
+		ip += len;
+		op += len;
+		if (ip == n)
+			break;
+
+		if (ip + 2 > n)
+			return(-1);
+		offset = get16(src + ip);
+		ip += 2;
+		if ((offset == 0) || (offset > op))
+			return(-1);
+		len = (token & 15);
+		if (len == 15)
+			do {
+				if (ip >= n)
+					return(-1);
+				b = src[ip++];
+				len += b;
+			} while (b == 255);
+		len += LE_LZ_MINMATCH;
+		if (len > cap - op)
+			return(-1);
+		for (; len > 0; len--, op++)
+			dst[op] = dst[op - offset];
+	}
+	return((long) op);
+}
+
+/*  Pyx compressibility  --  an LZ pass over the pad for P.
+
+	The optimum compression P derives from the entropy counts single
+	bytes, so a pad that repeats a block, or cycles with some period,
+	still scores 8 bits per byte.  With options->pyx_lz the pad is also
+	cut into LE_PYX_LZ_SEG segments and each is parsed as lz_compress
+	would, costing the output instead of writing it.  The codec only
+	reaches 64K back and keeps 4K positions, so lz_measure lets an
+	offset reach the whole segment (at a third byte) and keeps every
+	LE_PYX_LZ_STEP'th position in a table large enough to span the
+	segment, while still looking up every position: any repeat of
+	LE_PYX_LZ_STEP + LE_LZ_MINMATCH bytes or more within a segment is
+	matched.  A segment that costs LE_PYX_LZ_MARGIN bytes less than its
+	bytes stored as literals holds structure; chance 4 byte matches in
+	random data save a byte or two at most.  Up to LE_PYX_WORKERS
+	threads measure segments while the reader goes on.  */
+
+typedef struct {
+	pthread_mutex_t			lock;
+	pthread_cond_t			queued, freed;
+	pthread_t				tid[LE_PYX_WORKERS];
+	int						threads;	/* workers running, 0 to measure inline */
+	int						workers;	/* tables handed out */
+	int						stop;
+	int						nslots, fill;	/* segments, the one being filled */
+	unsigned char			*seg;		/* nslots * LE_PYX_LZ_SEG */
+	size_t					len[2 * LE_PYX_WORKERS];
+	int						state[2 * LE_PYX_WORKERS];	/* LE_LZ_FREE ... */
+	unsigned int			*table;		/* one per worker, or the one used inline */
+	unsigned long long		bytes, stored;	/* in, and out at the smaller of LZ or raw */
+	long					segs, structured;
+} pyx_lz_t;
+
+enum { LE_LZ_FREE, LE_LZ_FILLING, LE_LZ_QUEUED, LE_LZ_BUSY };
+
+/*  lz_cost  --  bytes lz_sequence would emit for one sequence.  */
+
+static size_t lz_cost(size_t nlit, size_t offset, size_t mlen)
+{
+	size_t cost = 1 + nlit;
+
+	if (nlit >= 15)
+		cost += (nlit - 15) / 255 + 1;
+	if (mlen == 0)
+		return(cost);
+	cost += (offset > 65535) ? 3 : 2;
+	mlen -= LE_LZ_MINMATCH;
+	if (mlen >= 15)
+		cost += (mlen - 15) / 255 + 1;
+	return(cost);
+}
+
+/*  lz_measure  --  the LZ compressed size of n bytes, offsets reaching
+	all of src.  table holds 1 << LE_PYX_LZ_HASHLOG positions.  */
+
+static size_t lz_measure(const unsigned char *src, size_t n, unsigned int *table)
+{
+	size_t ip = 0, anchor = 0, cost = 0, ref, mlen;
+	unsigned int seq, h;
+
+	memset(table, 0, sizeof(unsigned int) << LE_PYX_LZ_HASHLOG);
+
+	while (ip + LE_LZ_MINMATCH <= n) {
+		seq = get32(src + ip);
+		h = (seq * 2654435761U) >> (32 - LE_PYX_LZ_HASHLOG);
+		ref = table[h];
+		if ((ip & (LE_PYX_LZ_STEP - 1)) == 0)
+			table[h] = (unsigned int) ip;
+		if ((ref < ip) && (get32(src + ref) == seq)) {
+			for (mlen = LE_LZ_MINMATCH; (ip + mlen < n) && (src[ref + mlen] == src[ip + mlen]); mlen++)
+				;
+			cost += lz_cost(ip - anchor, ip - ref, mlen);
+			ip += mlen;
+			anchor = ip;
+		} else
+			ip++;
+	}
+	return(cost + lz_cost(n - anchor, 0, 0));
+}
+
+/*  pyx_lz_segment  --  measure segment i and count it; takes the lock
+	only when there are workers.  */
+
+static void pyx_lz_segment(pyx_lz_t *lz, int i, unsigned int *table)
+{
+	size_t n = lz->len[i], cost, raw;
+
+	cost = lz_measure(lz->seg + (size_t) i * LE_PYX_LZ_SEG, n, table);
+	raw = lz_cost(n, 0, 0);
+
+	if (lz->threads > 0)
+		pthread_mutex_lock(&lz->lock);
+	lz->bytes += n;
+	lz->stored += (cost < n) ? cost : n;
+	lz->segs++;
+	if (cost + LE_PYX_LZ_MARGIN <= raw)
+		lz->structured++;
+	lz->state[i] = LE_LZ_FREE;
+	if (lz->threads > 0) {
+		pthread_cond_signal(&lz->freed);
+		pthread_mutex_unlock(&lz->lock);
+	}
+}
+
+static void *pyx_lz_main(void *arg)
+{
+	pyx_lz_t *lz = arg;
+	unsigned int *table;
+	int i;
+
+	pthread_mutex_lock(&lz->lock);
+	table = lz->table + ((size_t) lz->workers++ << LE_PYX_LZ_HASHLOG);
+	for (;;) {
+		for (i = 0; (i < lz->nslots) && (lz->state[i] != LE_LZ_QUEUED); i++)
+			;
+		if (i < lz->nslots) {
+			lz->state[i] = LE_LZ_BUSY;
+			pthread_mutex_unlock(&lz->lock);
+			pyx_lz_segment(lz, i, table);
+			pthread_mutex_lock(&lz->lock);
+		} else
+			if (lz->stop)
+				break;
+			else
+				pthread_cond_wait(&lz->queued, &lz->lock);
+	}
+	pthread_mutex_unlock(&lz->lock);
+	return(NULL);
+}
+
+/*  pyx_lz_init  --  start the test with up to threads workers; with 0
+	segments are measured inline as they fill.  */
+
+static int pyx_lz_init(pyx_lz_t *lz, int threads)
+{
+	int i;
+
+	memset(lz, 0, sizeof(pyx_lz_t));
+	if (threads > LE_PYX_WORKERS)
+		threads = LE_PYX_WORKERS;
+	lz->nslots = (threads > 0) ? 2 * threads : 1;
+	lz->seg = malloc((size_t) lz->nslots * LE_PYX_LZ_SEG);
+	lz->table = malloc((size_t) ((threads > 0) ? threads : 1) * (sizeof(unsigned int) << LE_PYX_LZ_HASHLOG));
+	if ((lz->seg == NULL) || (lz->table == NULL)) {
+		free(lz->seg);
+		free(lz->table);
+		lz->seg = NULL;
+		lz->table = NULL;
+		return(EXIT_FAILURE);
+	}
+	lz->state[0] = LE_LZ_FILLING;
+	pthread_mutex_init(&lz->lock, NULL);
+	pthread_cond_init(&lz->queued, NULL);
+	pthread_cond_init(&lz->freed, NULL);
+	for (i = 0; i < threads; i++)
+		if (pthread_create(&lz->tid[lz->threads], NULL, pyx_lz_main, lz) == 0)
+			lz->threads++;
+	return(EXIT_SUCCESS);
+}
+
+/*  pyx_lz_queue  --  hand the filled segment on and take a free one.  */
+
+static void pyx_lz_queue(pyx_lz_t *lz)
+{
+	int i;
+
+	if (lz->threads == 0) {
+		pyx_lz_segment(lz, lz->fill, lz->table);
+		lz->state[lz->fill] = LE_LZ_FILLING;
+		lz->len[lz->fill] = 0;
+		return;
+	}
+	pthread_mutex_lock(&lz->lock);
+	lz->state[lz->fill] = LE_LZ_QUEUED;
+	pthread_cond_signal(&lz->queued);
+	for (;;) {
+		for (i = 0; (i < lz->nslots) && (lz->state[i] != LE_LZ_FREE); i++)
+			;
+		if (i < lz->nslots)
+			break;
+		pthread_cond_wait(&lz->freed, &lz->lock);
+	}
+	lz->state[i] = LE_LZ_FILLING;
+	lz->len[i] = 0;
+	lz->fill = i;
+	pthread_mutex_unlock(&lz->lock);
+}
+
+/*  pyx_lz_add  --  add bufl bytes to the segment being filled.  */
+
+static void pyx_lz_add(pyx_lz_t *lz, const unsigned char *buf, size_t bufl)
+{
+	size_t take;
+
+	while (bufl > 0) {
+		take = LE_PYX_LZ_SEG - lz->len[lz->fill];
+		if (take > bufl)
+			take = bufl;
+		memcpy(lz->seg + (size_t) lz->fill * LE_PYX_LZ_SEG + lz->len[lz->fill], buf, take);
+		lz->len[lz->fill] += take;
+		buf += take;
+		bufl -= take;
+		if (lz->len[lz->fill] == LE_PYX_LZ_SEG)
+			pyx_lz_queue(lz);
+	}
+}
+
+/*  pyx_lz_free  --  stop the workers and release the segments.  */
+
+static void pyx_lz_free(pyx_lz_t *lz)
+{
+	int i;
+
+	if (lz->seg == NULL)
+		return;
+	pthread_mutex_lock(&lz->lock);
+	lz->stop = TRUE;
+	pthread_cond_broadcast(&lz->queued);
+	pthread_mutex_unlock(&lz->lock);
+	for (i = 0; i < lz->threads; i++)
+		pthread_join(lz->tid[i], NULL);
+	pthread_cond_destroy(&lz->queued);
+	pthread_cond_destroy(&lz->freed);
+	pthread_mutex_destroy(&lz->lock);
+	free(lz->seg);
+	free(lz->table);
+	lz->seg = NULL;
+	lz->table = NULL;
+}
+
+/*  pyx_lz_end  --  measure the last segment, wait for the rest and
+	return the percent saved and the segments holding structure.  */
+
+static void pyx_lz_end(pyx_lz_t *lz, double *r_saving, long *r_structured)
+{
+	if (lz->len[lz->fill] > 0)
+		pyx_lz_queue(lz);
+	pyx_lz_free(lz);
+	*r_saving = (lz->bytes > 0) ? 100.0 * (double) (lz->bytes - lz->stored) / (double) lz->bytes : 0.0;
+	*r_structured = lz->structured;
+}
+
+/*  Pad container  --  self-describing OTP files.
+
+	A container pad is a LE_PAD_HDR byte header, the pad data and a
+	trailer index.  The header holds the magic "ERP1", version, flags,
+	header length, index block size, a random 16 byte pad ID, the data
+	length, the consumed offset (pad bytes already used by E), the
+	creation time, the index offset, the RNG device name and, when
+	LE_PAD_PYX is set, the Pyx summary of the data taken by G; an XXH64
+	of the header guards it.  The index is "ERPI", a block count and
+	one XXH64 per LE_BLOCK_SIZE data block, so any block can be checked
+	on its own and the whole pad in parallel.  Files without the magic
+	are legacy raw pads and are used from byte 0 as before.  */
+
+static unsigned long long get64(const unsigned char *p)
+{
+	return((unsigned long long) get32(p) | ((unsigned long long) get32(p + 4) << 32));
+}
+
+static void put64(unsigned char *p, unsigned long long v)
+{
+	put32(p, (unsigned int) v);
+	put32(p + 4, (unsigned int) (v >> 32));
+}
+
+static unsigned long long getd(const double d)
+{
+	unsigned long long v;
+
+	memcpy(&v, &d, sizeof(v));
+	return(v);
+}
+
+static double setd(unsigned long long v)
+{
+	double d;
+
+	memcpy(&d, &v, sizeof(d));
+	return(d);
+}
+
+/*  xxh64  --  XXH64 hash (Yann Collet's xxHash, 64 bit variant).  */
+
+#define XXH_P1	11400714785074694791ULL
+#define XXH_P2	14029467366897019727ULL
+#define XXH_P3	1609587929392839161ULL
+#define XXH_P4	9650029242287828579ULL
+#define XXH_P5	2870177450012600261ULL
+#define XXH_ROTL(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+static unsigned long long xxh_round(unsigned long long acc, unsigned long long input)
+{
+	acc += input * XXH_P2;
+	acc = XXH_ROTL(acc, 31);
+	return(acc * XXH_P1);
+}
+
+static unsigned long long xxh_merge(unsigned long long acc, unsigned long long val)
+{
+	acc ^= xxh_round(0, val);
+	return(acc * XXH_P1 + XXH_P4);
+}
+
+static unsigned long long xxh64(const unsigned char *p, size_t len, unsigned long long seed)
+{
+	const unsigned char *end = p + len;
+	unsigned long long h, v1, v2, v3, v4;
+
+	if (len >= 32) {
+		v1 = seed + XXH_P1 + XXH_P2;
+		v2 = seed + XXH_P2;
+		v3 = seed;
+		v4 = seed - XXH_P1;
+		do {
+			v1 = xxh_round(v1, get64(p));
+			v2 = xxh_round(v2, get64(p + 8));
+			v3 = xxh_round(v3, get64(p + 16));
+			v4 = xxh_round(v4, get64(p + 24));
+			p += 32;
+		} while (p + 32 <= end);
+		h = XXH_ROTL(v1, 1) + XXH_ROTL(v2, 7) + XXH_ROTL(v3, 12) + XXH_ROTL(v4, 18);
+		h = xxh_merge(h, v1);
+		h = xxh_merge(h, v2);
+		h = xxh_merge(h, v3);
+		h = xxh_merge(h, v4);
+	} else
+		h = seed + XXH_P5;
+
+	h += (unsigned long long) len;
+	for (; p + 8 <= end; p += 8) {
+		h ^= xxh_round(0, get64(p));
+		h = XXH_ROTL(h, 27) * XXH_P1 + XXH_P4;
+	}
+	if (p + 4 <= end) {
+		h ^= (unsigned long long) get32(p) * XXH_P1;
+		h = XXH_ROTL(h, 23) * XXH_P2 + XXH_P3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= (*p) * XXH_P5;
+		h = XXH_ROTL(h, 11) * XXH_P1;
+	}
+	h ^= h >> 33;
+	h *= XXH_P2;
+	h ^= h >> 29;
+	h *= XXH_P3;
+	h ^= h >> 32;
+	return(h);
+}
+
+static void pad_encode(const le_pad_t *pad, unsigned char *hdr)
+{
+	memset(hdr, 0, LE_PAD_HDR);
+	memcpy(hdr, LE_PAD_MAGIC, 4);
+	put16(hdr + 4, LE_PAD_VERSION);
+	put16(hdr + 6, pad->flags);
+	put32(hdr + 8, pad->hdrlen);
+	put32(hdr + 12, pad->block_size);
+	memcpy(hdr + 16, pad->id, LE_PAD_ID);
+	put64(hdr + 32, pad->length);
+	put64(hdr + 40, pad->consumed);
+	put64(hdr + 48, pad->created);
+	put64(hdr + 56, pad->index_offset);
+	memcpy(hdr + 64, pad->device, sizeof(pad->device));
+	put64(hdr + 96, getd(pad->ent));
+	put64(hdr + 104, getd(pad->chisq));
+	put64(hdr + 112, getd(pad->mean));
+	put64(hdr + 120, getd(pad->montepi));
+	put64(hdr + 128, getd(pad->scc));
+	put64(hdr + LE_PAD_SUM, xxh64(hdr, LE_PAD_SUM, 0));
+}
+
+/*  pad_decode  --  TRUE for a valid container header, FALSE for a
+	legacy pad, -1 when the magic is present but the header is bad.  */
+
+static int pad_decode(le_pad_t *pad, const unsigned char *hdr, size_t len)
+{
+	memset(pad, 0, sizeof(le_pad_t));
+	if ((len < LE_PAD_HDR) || (memcmp(hdr, LE_PAD_MAGIC, 4) != 0))
+		return(FALSE);
+	if ((get16(hdr + 4) != LE_PAD_VERSION) || (get32(hdr + 8) != LE_PAD_HDR)
+		|| (get64(hdr + LE_PAD_SUM) != xxh64(hdr, LE_PAD_SUM, 0)))
+		return(-1);
+	pad->flags = get16(hdr + 6);
+	pad->hdrlen = get32(hdr + 8);
+	pad->block_size = get32(hdr + 12);
+	memcpy(pad->id, hdr + 16, LE_PAD_ID);
+	pad->length = get64(hdr + 32);
+	pad->consumed = get64(hdr + 40);
+	pad->created = get64(hdr + 48);
+	pad->index_offset = get64(hdr + 56);
+	memcpy(pad->device, hdr + 64, sizeof(pad->device));
+	pad->device[sizeof(pad->device) - 1] = '\0';
+	pad->ent = setd(get64(hdr + 96));
+	pad->chisq = setd(get64(hdr + 104));
+	pad->mean = setd(get64(hdr + 112));
+	pad->montepi = setd(get64(hdr + 120));
+	pad->scc = setd(get64(hdr + 128));
+	if ((pad->block_size == 0) || (pad->consumed > pad->length)
+		|| (pad->index_offset != pad->hdrlen + pad->length))
+		return(-1);
+	return(TRUE);
+}
+
+/*  le_pad_read  --  read the pad header of a stream (no position change).
+	Returns TRUE for a container, FALSE for a legacy raw pad (length
+	then holds the stream size, 0 when unknown) or -1 if the header is
+	corrupt.  */
+
+int le_pad_read(le_stream_t *stream, le_pad_t *pad)
+{
+	unsigned char hdr[LE_PAD_HDR];
+	ssize_t n;
+	long long sz;
+	int rc;
+
+	if ((n = le_pread(stream, hdr, sizeof(hdr), 0)) < 0)
+		n = 0;
+	if ((rc = pad_decode(pad, hdr, (size_t) n)) == FALSE)
+		pad->length = ((sz = le_size(stream)) > 0) ? (unsigned long long) sz : 0;
+	return(rc);
+}
+
+/*  le_pad_info  --  header of the pad file fsp, read in one pread.  */
+
+int le_pad_info(const char *fsp, le_pad_t *pad)
+{
+	le_stream_t *stream;
+	int rc;
+
+	if ((stream = le_open_file(fsp, O_RDONLY)) == NULL)
+		return(-1);
+	rc = le_pad_read(stream, pad);
+	le_close(stream);
+	return(rc);
+}
+
+/*  le_pad_seek  --  position stream at pad data offset and bound reads to
+	the rest of the pad data.  */
+
+int le_pad_seek(le_stream_t *stream, const le_pad_t *pad, unsigned long long offset)
+{
+	if ((pad->hdrlen == 0) && (pad->length == 0)) {
+		stream->bounded = FALSE;
+		return(le_seek(stream, offset));
+	}
+	if (offset > pad->length)
+		return(EXIT_FAILURE);
+	if (le_seek(stream, pad->hdrlen + offset) != EXIT_SUCCESS)
+		return(EXIT_FAILURE);
+	stream->bounded = TRUE;
+	stream->remain = pad->length - offset;
+	return(EXIT_SUCCESS);
+}
+
+/*  pad_store  --  rewrite the header of a container pad in place.  */
+
+static int pad_store(int fd, const le_pad_t *pad)
+{
+	unsigned char hdr[LE_PAD_HDR];
+
+	pad_encode(pad, hdr);
+	if ((pwrite(fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr)) || (fdatasync(fd) == -1))
+		return(EXIT_FAILURE);
+	return(EXIT_SUCCESS);
+}
+
+/*  Stripe sets  --  several pads used as one logical pad.
+
+	le_open_stripe takes a comma separated list of pads, normally on
+	separate devices, and reads them as one pad striped in width byte
+	units: unit u of the logical data is unit u / count of member
+	u % count.  Members are all containers or all legacy raw pads and
+	each contributes the same whole number of units (the smallest
+	member decides; tails are unused).  A stripe set of containers
+	shows a virtual container header at offset 0, built from the
+	members: its ID is an XXH64 of the member IDs and the width, so D
+	refuses a different set, order or width, and its consumed offset
+	is the furthest point any member has been used to, so E never
+	reuses pad bytes.  E updates every member's own consumed offset.
+	Each read first asks the kernel (POSIX_FADV_WILLNEED) to fetch the
+	next LE_STRIPE_AHEAD rows of every member, so all devices have
+	reads in flight while the current row is being XORed.  */
+
+typedef struct {
+	int						count;
+	unsigned long long		width;		/* bytes per stripe unit */
+	unsigned long long		span;		/* data bytes used per member */
+	unsigned long long		hdrlen;		/* virtual header, 0 for raw pads */
+	unsigned long long		ahead;		/* logical data prefetched up to */
+	unsigned char			hdr[LE_PAD_HDR];
+	char					fsp[LE_STRIPE_MAX][MAX_FSP_PATH];
+	le_stream_t				*member[LE_STRIPE_MAX];
+	le_pad_t				pad[LE_STRIPE_MAX];
+	int						lock[LE_STRIPE_MAX];	/* E: locked descriptors */
+} stripe_t;
+
+/*  stripe_used  --  bytes of member k consumed once the first data bytes
+	of the set are used.  */
+
+static unsigned long long stripe_used(const stripe_t *st, int k, unsigned long long data)
+{
+	unsigned long long row, rem;
+
+	row = st->width * (unsigned long long) st->count;
+	rem = data % row;
+	if (rem <= st->width * (unsigned long long) k)
+		rem = 0;
+	else
+		rem -= st->width * (unsigned long long) k;
+	return((data / row) * st->width + ((rem > st->width) ? st->width : rem));
+}
+
+/*  stripe_header  --  (re)build the virtual container header from the
+	member headers.  */
+
+static void stripe_header(stripe_t *st)
+{
+	unsigned char ids[LE_STRIPE_MAX * LE_PAD_ID];
+	unsigned long long c, q, at, used = 0;
+	le_pad_t pad;
+	int k;
+
+	if (st->hdrlen == 0)
+		return;
+	memset(&pad, 0, sizeof(pad));
+	for (k = 0; k < st->count; k++) {
+		memcpy(ids + k * LE_PAD_ID, st->pad[k].id, LE_PAD_ID);
+		if ((c = st->pad[k].consumed) > st->span)
+			c = st->span;
+		if (c > 0) {
+			q = (c - 1) / st->width;
+			at = (q * (unsigned long long) st->count + (unsigned long long) k) * st->width + (c - q * st->width);
+			if (at > used)
+				used = at;
+		}
+		pad.ent += st->pad[k].ent / st->count;
+		pad.chisq += st->pad[k].chisq / st->count;
+		pad.mean += st->pad[k].mean / st->count;
+		pad.montepi += st->pad[k].montepi / st->count;
+		pad.scc += st->pad[k].scc / st->count;
+	}
+	put64(pad.id, xxh64(ids, (size_t) st->count * LE_PAD_ID, st->width));
+	put64(pad.id + 8, xxh64(ids, (size_t) st->count * LE_PAD_ID, st->width + 1));
+	pad.flags = st->pad[0].flags & LE_PAD_PYX;
+	pad.hdrlen = (unsigned int) st->hdrlen;
+	pad.block_size = (unsigned int) st->width;
+	pad.length = st->span * (unsigned long long) st->count;
+	pad.consumed = used;
+	pad.created = st->pad[0].created;
+	pad.index_offset = pad.hdrlen + pad.length;
+	memcpy(pad.device, st->pad[0].device, sizeof(pad.device));
+	pad_encode(&pad, st->hdr);
+}
+
+static ssize_t stripe_pread(le_stream_t *stream, void *buf, size_t len, unsigned long long offset)
+{
+	stripe_t *st = stream->handle;
+	unsigned char *bp = buf;
+	unsigned long long unit, at, n;
+	size_t done = 0;
+	ssize_t got;
+	int k;
+
+	if (offset >= stream->length)
+		return(0);
+	if (len > stream->length - offset)
+		len = (size_t) (stream->length - offset);
+	if (offset < st->hdrlen) {
+		n = st->hdrlen - offset;
+		if (n > len)
+			n = len;
+		memcpy(bp, st->hdr + offset, (size_t) n);
+		done = (size_t) n;
+	}
+	while (done < len) {
+		unit = (offset + done - st->hdrlen) / st->width;
+		k = (int) (unit % (unsigned long long) st->count);
+		at = (unit / (unsigned long long) st->count) * st->width + (offset + done - st->hdrlen) % st->width;
+		if ((n = st->width - (offset + done - st->hdrlen) % st->width) > len - done)
+			n = len - done;
+		if ((got = le_pread(st->member[k], bp + done, (size_t) n, st->pad[k].hdrlen + at)) != (ssize_t) n)
+			return((done > 0) ? (ssize_t) done : -1);
+		done += (size_t) n;
+	}
+	return((ssize_t) done);
+}
+
+static ssize_t stripe_read(le_stream_t *stream, void *buf, size_t len)
+{
+	stripe_t *st = stream->handle;
+	unsigned long long data, want, row;
+	ssize_t n;
+	int k;
+
+	/* keep LE_STRIPE_AHEAD rows requested on every member */
+
+	data = (stream->offset > st->hdrlen) ? stream->offset - st->hdrlen : 0;
+	row = st->width * (unsigned long long) st->count;
+	want = ((data + len) / row + LE_STRIPE_AHEAD) * row;
+	if ((st->ahead < data) || (st->ahead > want))
+		st->ahead = (data / row) * row;
+	if (want > st->span * (unsigned long long) st->count)
+		want = st->span * (unsigned long long) st->count;
+	if (st->ahead < want) {
+		for (k = 0; k < st->count; k++)
+			if (st->member[k]->fd >= 0)
+				posix_fadvise(st->member[k]->fd, (off_t) (st->pad[k].hdrlen + stripe_used(st, k, st->ahead)),
+					(off_t) (stripe_used(st, k, want) - stripe_used(st, k, st->ahead)), POSIX_FADV_WILLNEED);
+		st->ahead = want;
+	}
+
+	if ((n = stripe_pread(stream, buf, len, stream->offset)) > 0) {
+		stream->offset += (unsigned long long) n;
+		if (stream->policy != LE_IO_CACHE)
+			for (k = 0; k < st->count; k++)
+				io_advise(st->member[k], st->pad[k].hdrlen + stripe_used(st, k, data),
+					st->pad[k].hdrlen + stripe_used(st, k, data + (unsigned long long) n), FALSE);
+	}
+	return(n);
+}
+
+static long long stripe_size(le_stream_t *stream)
+{
+	return((long long) stream->length);
+}
+
+static void stripe_unlock(stripe_t *st)
+{
+	int k;
+
+	for (k = 0; k < st->count; k++)
+		if (st->lock[k] >= 0) {
+			close(st->lock[k]);
+			st->lock[k] = -1;
+		}
+}
+
+static int stripe_close(le_stream_t *stream)
+{
+	stripe_t *st = stream->handle;
+	int k, rc = 0;
+
+	stripe_unlock(st);
+	for (k = 0; k < st->count; k++)
+		if (le_close(st->member[k]) != 0)
+			rc = -1;
+	free(st);
+	return(rc);
+}
+
+static const le_stream_ops_t stripe_ops = {
+	"stripe", stripe_read, NULL, stripe_pread, stripe_size, stripe_close
+};
+
+/*  io_policy  --  put a stream (every member of a stripe set) under a
+	page cache policy; LE_IO_CACHE restores the kernel defaults.  */
+
+static void io_policy(le_stream_t *stream, int policy)
+{
+	stripe_t *st;
+	int k, flags;
+
+	if ((stream == NULL) || ((policy == LE_IO_CACHE) && (stream->policy == LE_IO_CACHE)))
+		return;
+	if (stream->ops == &stripe_ops) {
+		st = stream->handle;
+		for (k = 0; k < st->count; k++)
+			io_policy(st->member[k], policy);
+		stream->policy = policy;
+		return;
+	}
+	if (((stream->ops != &fd_ops) && (stream->ops != &mmap_ops)) || (fd_size_of(stream->fd) < 0))
+		return;
+	stream->policy = (policy == LE_IO_CACHE) ? LE_IO_CACHE : LE_IO_STREAM;
+	stream->ahead = stream->synced = stream->dropped = 0;
+	if (stream->base != NULL)
+		madvise(stream->base, (size_t) stream->length, (policy == LE_IO_CACHE) ? MADV_NORMAL : MADV_SEQUENTIAL);
+	else
+		posix_fadvise(stream->fd, 0, 0, (policy == LE_IO_CACHE) ? POSIX_FADV_NORMAL : POSIX_FADV_SEQUENTIAL);
+	if (stream->ops != &fd_ops)
+		return;
+	if ((policy == LE_IO_DIRECT) && ((flags = fcntl(stream->fd, F_GETFL)) != -1) && ((flags & O_ACCMODE) == O_RDONLY)
+		&& (fd_direct(stream, TRUE) == 0))
+		stream->policy = LE_IO_DIRECT;
+	else
+		fd_direct(stream, FALSE);
+}
+
+/*  le_open_stripe  --  open the comma separated pads of fsps as one
+	stripe set of width byte units.  */
+
+le_stream_t *le_open_stripe(const char *fsps, unsigned long long width)
+{
+	le_stream_t *stream;
+	stripe_t *st;
+	const char *p, *end;
+	size_t len;
+	int kind = -2, rc;
+
+	if ((width == 0) || ((st = calloc(1, sizeof(stripe_t))) == NULL))
+		return(NULL);
+	st->width = width;
+	st->span = ~0ULL;
+	for (p = fsps; ; p = end + 1) {
+		end = strchr(p, ',');
+		len = (end != NULL) ? (size_t) (end - p) : strlen(p);
+		if ((st->count == LE_STRIPE_MAX) || (len == 0) || (len >= MAX_FSP_PATH))
+			goto fail;
+		memcpy(st->fsp[st->count], p, len);
+		st->lock[st->count] = -1;
+		if ((st->member[st->count] = le_open_mmap(st->fsp[st->count])) == NULL)
+			goto fail;
+		rc = le_pad_read(st->member[st->count], &st->pad[st->count]);
+		if ((rc < 0) || ((kind != -2) && (rc != kind)) || (st->member[st->count]->ops->pread == NULL))
+			goto fail;
+		kind = rc;
+		if (st->pad[st->count].length < st->span)
+			st->span = st->pad[st->count].length;
+		st->count++;
+		if (end == NULL)
+			break;
+	}
+	if (st->count < 2)
+		goto fail;
+	st->span -= st->span % width;
+	st->hdrlen = kind ? LE_PAD_HDR : 0;
+	stripe_header(st);
+
+	if ((stream = le_open_custom(&stripe_ops, st)) == NULL)
+		goto fail;
+	stream->owned = TRUE;
+	stream->length = stream->capacity = st->hdrlen + st->span * (unsigned long long) st->count;
+	return(stream);
+
+fail:
+	for (rc = 0; rc < st->count; rc++)
+		le_close(st->member[rc]);
+	if ((st->count < LE_STRIPE_MAX) && (st->member[st->count] != NULL))
+		le_close(st->member[st->count]);
+	free(st);
+	return(NULL);
+}
+
+/*  stripe_lock  --  E: lock every member of a stripe set of containers in
+	order and re-read their headers under the locks.  */
+
+static int stripe_lock(le_stream_t *stream)
+{
+	stripe_t *st = stream->handle;
+	unsigned char hdr[LE_PAD_HDR];
+	int k;
+
+	for (k = 0; k < st->count; k++)
+		if (((st->lock[k] = open(st->fsp[k], O_RDWR | O_CLOEXEC)) < 0) || (flock(st->lock[k], LOCK_EX) == -1)
+			|| (pread(st->lock[k], hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr))
+			|| (pad_decode(&st->pad[k], hdr, sizeof(hdr)) != TRUE)) {
+			stripe_unlock(st);
+			return(EXIT_FAILURE);
+		}
+	stripe_header(st);
+	return(EXIT_SUCCESS);
+}
+
+/*  stripe_store  --  E: advance each member's consumed offset past the
+	first data bytes of the set and release the locks.  */
+
+static int stripe_store(le_stream_t *stream, unsigned long long data)
+{
+	stripe_t *st = stream->handle;
+	unsigned long long used;
+	int k, rc = EXIT_SUCCESS;
+
+	for (k = 0; k < st->count; k++) {
+		if ((used = stripe_used(st, k, data)) > st->pad[k].consumed)
+			st->pad[k].consumed = used;
+		if ((st->lock[k] < 0) || (pad_store(st->lock[k], &st->pad[k]) != EXIT_SUCCESS))
+			rc = EXIT_FAILURE;
+	}
+	stripe_unlock(st);
+	stripe_header(st);
+	return(rc);
+}
+
+/*  pad_attach  --  recognise the OTP stream of options.  A container is
+	positioned at its consumed offset for E (from) or at its data for
+	D and P; a legacy pad is left where it is.  Streams already bounded
+	by the caller (the server) are taken as positioned.  */
+
+static int pad_attach(options_t *options, int encrypting)
+{
+	int rc;
+
+	memset(&options->pad, 0, sizeof(le_pad_t));
+	if (options->otp->bounded)
+		return(EXIT_SUCCESS);
+	if ((rc = le_pad_read(options->otp, &options->pad)) < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_HEADER);
+		return(EXIT_FAILURE);
+	}
+	if (rc == FALSE) {
+		memset(&options->pad, 0, sizeof(le_pad_t));
+		return(EXIT_SUCCESS);
+	}
+	if (le_pad_seek(options->otp, &options->pad, encrypting ? options->pad.consumed : 0) != EXIT_SUCCESS) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  pad_lock  --  open the container pad of options for its header update
+	and hold an exclusive lock, so concurrent E never share pad bytes.
+	Re-reads the header under the lock.  Returns the descriptor (for a
+	stripe set, that of its first member) or -1.  */
+
+static int pad_lock(options_t *options)
+{
+	stripe_t *st;
+	int fd;
+
+	if (options->otp->ops == &stripe_ops) {
+		st = options->otp->handle;
+		options->otp->bounded = FALSE;
+		if ((stripe_lock(options->otp) != EXIT_SUCCESS) || (pad_attach(options, TRUE) != EXIT_SUCCESS)) {
+			stripe_unlock(st);
+			if (options->errmsg[0] == '\0')
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_UPDATE);
+			return(-1);
+		}
+		return(st->lock[0]);
+	}
+	if ((options->otp_fsp[0] == '\0') || ((fd = open(options->otp_fsp, O_RDWR | O_CLOEXEC)) < 0)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_UPDATE);
+		return(-1);
+	}
+	options->otp->bounded = FALSE;
+	if ((flock(fd, LOCK_EX) == -1) || (pad_attach(options, TRUE) != EXIT_SUCCESS) || (options->pad.hdrlen == 0)) {
+		if (options->errmsg[0] == '\0')
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_UPDATE);
+		close(fd);
+		return(-1);
+	}
+	return(fd);
+}
+
+/*  pad_unlock  --  store the consumed offset of options->pad taken under
+	pad_lock and release the lock.  */
+
+static int pad_unlock(options_t *options, int fd)
+{
+	int rc;
+
+	if (options->otp->ops == &stripe_ops)
+		return(stripe_store(options->otp, options->pad.consumed));
+	rc = pad_store(fd, &options->pad);
+	close(fd);
+	return(rc);
+}
+
+/*  pad_index_new  --  G: the zeroed checksum index of options->pad.  */
+
+static unsigned char *pad_index_new(options_t *options)
+{
+	le_pad_t *pad = &options->pad;
+	unsigned long long count;
+	unsigned char *index;
+
+	count = (pad->length + pad->block_size - 1) / pad->block_size;
+	if ((index = calloc((size_t) count + 1, 8)) == NULL) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		return(NULL);
+	}
+	memcpy(index, LE_PAD_INDEX, 4);
+	put32(index + 4, (unsigned int) count);
+	return(index);
+}
+
+/*  pad_begin  --  G: describe a new container pad of options->size bytes
+	with pad ID id (NULL for a fresh one) and write its header.  Returns
+	the zeroed checksum index.  */
+
+static unsigned char *pad_begin(options_t *options, pyx_t *px, const unsigned char *id)
+{
+	unsigned char hdr[LE_PAD_HDR], *index;
+	le_pad_t *pad = &options->pad;
+
+	memset(pad, 0, sizeof(le_pad_t));
+	if (id != NULL)
+		memcpy(pad->id, id, LE_PAD_ID);
+	else
+		if (harvest(options, pad->id, LE_PAD_ID) != EXIT_SUCCESS)
+			return(NULL);
+	pad->hdrlen = LE_PAD_HDR;
+	pad->block_size = LE_BLOCK_SIZE;
+	pad->length = options->size;
+	pad->created = (unsigned long long) time(NULL);
+	pad->index_offset = pad->hdrlen + pad->length;
+	snprintf(pad->device, sizeof(pad->device), "%s", options->devname);
+
+	if ((index = pad_index_new(options)) == NULL)
+		return(NULL);
+
+	pad_encode(pad, hdr);
+	if (le_write(options->otp, hdr, sizeof(hdr)) < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
+		free(index);
+		return(NULL);
+	}
+	pyx_ctx_init(px, FALSE);
+	return(index);
+}
+
+/*  pad_finish  --  G: append the index and, where the OTP stream allows
+	positional writes, complete the header with the Pyx summary.  */
+
+static int pad_finish(options_t *options, unsigned char *index, pyx_t *px)
+{
+	unsigned char hdr[LE_PAD_HDR];
+	le_pad_t *pad = &options->pad;
+	size_t len;
+
+	len = 8 + 8 * (size_t) ((pad->length + pad->block_size - 1) / pad->block_size);
+	if (le_write(options->otp, index, len) < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
+		return(EXIT_FAILURE);
+	}
+
+	pyx_ctx_end(px, &pad->ent, &pad->chisq, &pad->mean, &pad->montepi, &pad->scc);
+	pad->flags |= LE_PAD_PYX;
+	pad_encode(pad, hdr);
+	if ((options->otp->fp != NULL) && (fflush(options->otp->fp) == EOF))
+		return(EXIT_FAILURE);
+	if ((options->otp->fd >= 0) && (pwrite(options->otp->fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr))
+		&& (errno != ESPIPE)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  Resumable Generate  --  G -d, with a checkpoint beside the pad.
+
+	A large pad from a hardware RNG takes hours, and an unplugged
+	device, a restart or a signal used to cost all of it.  With
+	options->resume G keeps <otp>.ckpt: every LE_CKPT_STEP bytes of pad
+	data it syncs the pad, then records in the checkpoint how much is
+	committed, so a rerun with the same OTP and size carries on from
+	there.  The rerun reads the committed data back once to rebuild
+	the block checksums and the Pyx summary (far quicker than the RNG
+	made it) and drops whatever was written after the checkpoint.
+
+	The checkpoint is LE_CKPT_MAGIC, the raw pad flag, the size, the
+	bytes committed and the pad ID, with an XXH64 of them, rewritten
+	in place; a container must still carry that ID and length.  An
+	exclusive flock keeps two runs off one pad, and the checkpoint is
+	removed once the pad is complete.  */
+
+/*  ckpt_store  --  sync the pad, then record done bytes committed.  */
+
+static int ckpt_store(options_t *options, int fd, unsigned long long done)
+{
+	unsigned char rec[LE_CKPT_LEN];
+
+	memset(rec, 0, sizeof(rec));
+	memcpy(rec, LE_CKPT_MAGIC, 4);
+	put32(rec + 4, options->pad_raw ? 1 : 0);
+	put64(rec + 8, options->size);
+	put64(rec + 16, done);
+	if (!options->pad_raw)
+		memcpy(rec + 24, options->pad.id, LE_PAD_ID);
+	put64(rec + 56, xxh64(rec, 56, 0));
+	if ((fdatasync(options->otp->fd) == -1) || (pwrite(fd, rec, sizeof(rec), 0) != (ssize_t) sizeof(rec))
+		|| (fdatasync(fd) == -1)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CKPT_OPEN);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  resume_begin  --  G -d: open the checkpoint into *ckfd and continue
+	the pad it describes, or begin the pad afresh when there is none.
+	Returns the pad data bytes already committed, or -1.  */
+
+static long long resume_begin(options_t *options, pyx_t *px, unsigned char **index, unsigned char *buf, int *ckfd)
+{
+	char fsp[MAX_FSP_PATH + 8];
+	unsigned char rec[LE_CKPT_LEN], hdr[LE_PAD_HDR];
+	unsigned long long done, off, hdrlen = 0;
+	struct stat st;
+	le_pad_t pad;
+	ssize_t n;
+	int fd = options->otp->fd;
+
+	snprintf(fsp, sizeof(fsp), "%s.ckpt", options->otp_fsp);
+	if ((fd < 0) || (fstat(fd, &st) == -1) || !S_ISREG(st.st_mode)
+		|| ((*ckfd = open(fsp, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0) || (flock(*ckfd, LOCK_EX | LOCK_NB) == -1)
+		|| ((n = pread(*ckfd, rec, sizeof(rec), 0)) < 0)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CKPT_OPEN);
+		return(-1);
+	}
+
+	/* No checkpoint: the OTP was opened without truncation, so begin it */
+
+	if (n == 0) {
+		if ((ftruncate(fd, 0) == -1) || (lseek(fd, 0, SEEK_SET) == (off_t) -1)) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
+			return(-1);
+		}
+		if (!options->pad_raw && ((*index = pad_begin(options, px, NULL)) == NULL))
+			return(-1);
+		return((ckpt_store(options, *ckfd, 0) == EXIT_SUCCESS) ? 0 : -1);
+	}
+
+	done = get64(rec + 16);
+	if ((n != (ssize_t) sizeof(rec)) || (memcmp(rec, LE_CKPT_MAGIC, 4) != 0) || (get64(rec + 56) != xxh64(rec, 56, 0))
+		|| (get32(rec + 4) != (options->pad_raw ? 1U : 0U)) || (get64(rec + 8) != options->size)
+		|| (done > options->size) || (done % LE_BLOCK_SIZE != 0))
+		goto stale;
+	if (!options->pad_raw) {
+		if ((pread(fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr)) || (pad_decode(&pad, hdr, sizeof(hdr)) != TRUE)
+			|| (memcmp(pad.id, rec + 24, LE_PAD_ID) != 0) || (pad.length != options->size))
+			goto stale;
+		options->pad = pad;
+		hdrlen = pad.hdrlen;
+		if ((*index = pad_index_new(options)) == NULL)
+			return(-1);
+		pyx_ctx_init(px, FALSE);
+	}
+	if ((unsigned long long) st.st_size < hdrlen + done)
+		goto stale;
+
+	/* Read the committed data back for the checksums and Pyx summary */
+
+	for (off = 0; (*index != NULL) && (off < done); off += LE_BLOCK_SIZE) {
+		if (pread(fd, buf, LE_BLOCK_SIZE, (off_t) (hdrlen + off)) != LE_BLOCK_SIZE) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+			return(-1);
+		}
+		put64(*index + 8 + 8 * (off / LE_BLOCK_SIZE), xxh64(buf, LE_BLOCK_SIZE, 0));
+		pyx_ctx_add(px, buf, LE_BLOCK_SIZE);
+	}
+	if ((ftruncate(fd, (off_t) (hdrlen + done)) == -1) || (lseek(fd, (off_t) (hdrlen + done), SEEK_SET) == (off_t) -1)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
+		return(-1);
+	}
+	options->otp->written = hdrlen + done;
+	return((long long) done);
+
+stale:
+	snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CKPT_STALE);
+	return(-1);
+}
+
+/*  resume_end  --  G -d: the pad is complete; sync it and drop the
+	checkpoint.  */
+
+static int resume_end(options_t *options)
+{
+	char fsp[MAX_FSP_PATH + 8];
+
+	snprintf(fsp, sizeof(fsp), "%s.ckpt", options->otp_fsp);
+	if ((fdatasync(options->otp->fd) == -1) || (unlink(fsp) == -1)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CKPT_OPEN);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  le_pad_check_block  --  compare data block n of a container with its
+	index checksum.  Thread safe: uses positional reads only.  */
+
+typedef struct {
+	le_stream_t				*stream;
+	const le_pad_t			*pad;
+	const unsigned char		*index;
+	unsigned long long		first, count, step;
+	unsigned long long		bad;		/* first failing block, or count */
+} pad_verify_t;
+
+static int pad_block(le_stream_t *stream, const le_pad_t *pad, const unsigned char *index, unsigned long long n, unsigned char *buf)
+{
+	unsigned long long off, len;
+	size_t got = 0;
+	ssize_t r;
+
+	off = n * pad->block_size;
+	len = pad->length - off;
+	if (len > pad->block_size)
+		len = pad->block_size;
+	while (got < len) {
+		if ((r = stream->ops->pread(stream, buf + got, (size_t) len - got, pad->hdrlen + off + got)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return(FALSE);
+		}
+		if (r == 0)
+			return(FALSE);
+		got += (size_t) r;
+	}
+	if (stream->policy != LE_IO_CACHE)
+		io_release(stream, pad->hdrlen + off, len);
+	return(xxh64(buf, (size_t) len, 0) == get64(index + 8 * n));
+}
+
+static void *pad_verify_main(void *arg)
+{
+	pad_verify_t *pv = arg;
+	unsigned long long n;
+	unsigned char *buf;
+
+	pv->bad = pv->count;
+	if ((buf = le_buf_get(pv->pad->block_size)) == NULL) {
+		pv->bad = pv->first;
+		return(NULL);
+	}
+	for (n = pv->first; n < pv->count; n += pv->step)
+		if (!pad_block(pv->stream, pv->pad, pv->index, n, buf)) {
+			pv->bad = n;
+			break;
+		}
+	le_buf_put(buf);
+	return(NULL);
+}
+
+static unsigned char *pad_index(le_stream_t *stream, const le_pad_t *pad, unsigned long long *count)
+{
+	unsigned char head[8], *index;
+	size_t len;
+
+	*count = (pad->length + pad->block_size - 1) / pad->block_size;
+	if ((le_pread(stream, head, sizeof(head), pad->index_offset) != (ssize_t) sizeof(head))
+		|| (memcmp(head, LE_PAD_INDEX, 4) != 0) || (get32(head + 4) != *count))
+		return(NULL);
+	len = (size_t) (*count * 8);
+	if ((index = malloc(len ? len : 1)) == NULL)
+		return(NULL);
+	if (le_pread(stream, index, len, pad->index_offset + 8) != (ssize_t) len) {
+		free(index);
+		return(NULL);
+	}
+	return(index);
+}
+
+int le_pad_check_block(le_stream_t *stream, const le_pad_t *pad, unsigned long long n)
+{
+	unsigned char *index, *buf;
+	unsigned long long count;
+	int ok = FALSE;
+
+	if (stream->ops->pread == NULL)
+		return(FALSE);
+	if ((index = pad_index(stream, pad, &count)) == NULL)
+		return(FALSE);
+	if ((n < count) && ((buf = le_buf_get(pad->block_size)) != NULL)) {
+		ok = pad_block(stream, pad, index, n, buf);
+		le_buf_put(buf);
+	}
+	free(index);
+	return(ok);
+}
+
+/*  le_pad_verify  --  check every block of a container against its index
+	with up to threads workers.  Returns EXIT_SUCCESS, or EXIT_FAILURE
+	with *bad set to the first failing block (the block count when the
+	index itself is missing or damaged).  */
+
+int le_pad_verify(le_stream_t *stream, const le_pad_t *pad, int threads, unsigned long long *bad)
+{
+	pad_verify_t pv[LE_PAD_THREADS];
+	pthread_t tid[LE_PAD_THREADS];
+	int started[LE_PAD_THREADS];
+	unsigned long long count;
+	unsigned char *index;
+	stripe_t *st;
+	int i;
+
+	*bad = 0;
+	if (stream->ops == &stripe_ops) {
+		st = stream->handle;
+		for (i = 0; i < st->count; i++)
+			if (le_pad_verify(st->member[i], &st->pad[i], threads, bad) != EXIT_SUCCESS)
+				return(EXIT_FAILURE);
+		return(EXIT_SUCCESS);
+	}
+	if ((stream->ops->pread == NULL) || ((index = pad_index(stream, pad, &count)) == NULL)) {
+		*bad = (pad->length + pad->block_size - 1) / pad->block_size;
+		return(EXIT_FAILURE);
+	}
+	if (threads < 1)
+		threads = 1;
+	if (threads > LE_PAD_THREADS)
+		threads = LE_PAD_THREADS;
+	if ((unsigned long long) threads > count)
+		threads = (count > 0) ? (int) count : 1;
+
+	/* block i goes to worker i % threads; the caller is worker 0 and
+	   also runs any worker whose thread could not be started */
+
+	for (i = 0; i < threads; i++) {
+		pv[i].stream = stream;
+		pv[i].pad = pad;
+		pv[i].index = index;
+		pv[i].first = (unsigned long long) i;
+		pv[i].count = count;
+		pv[i].step = (unsigned long long) threads;
+		started[i] = (i > 0) && (pthread_create(&tid[i], NULL, pad_verify_main, &pv[i]) == 0);
+	}
+	for (i = 0; i < threads; i++)
+		if (!started[i])
+			pad_verify_main(&pv[i]);
+	*bad = count;
+	for (i = 0; i < threads; i++) {
+		if (started[i])
+			pthread_join(tid[i], NULL);
+		if (pv[i].bad < *bad)
+			*bad = pv[i].bad;
+	}
+	free(index);
+	return((*bad == count) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/*  One-time MAC  --  Wegman-Carter authenticator for LE_CT_AUTH.
+
+	The first LE_MAC_KEY pad bytes of an authenticated body are its
+	key: a hash key H and a mask S, each used once.  The MAC is a
+	polynomial hash over GF(2^128) (x^128 + x^7 + x^2 + x + 1, two
+	little-endian 64 bit words): every 16 bytes of the header and the
+	ciphertext, the last zero padded, then a block holding the bit
+	length, are folded as acc = (acc ^ block) * H and the tag is
+	acc ^ S.  The multiply uses PCLMULQDQ where the CPU has it and a
+	4 bit table otherwise.  Each 16 bytes are absorbed as they are
+	XORed, so authenticated E and D stay a single pass.  */
+
+typedef struct {
+	unsigned long long		h[2], s[2], acc[2];
+	unsigned long long		table[16][2];	/* i * H for the table multiply */
+	unsigned long long		hp[4][2];		/* H^1..H^4 for the PCLMUL path */
+	unsigned char			part[16];		/* unfinished block */
+	size_t					fill;
+	unsigned long long		total;			/* bytes absorbed */
+	int						clmul;
+} mac_t;
+
+/* x^128 folded back: mac_r4[v] = v * (x^7 + x^2 + x + 1) for the 4 bits shifted out */
+
+static const unsigned long long mac_r4[16] = {
+	0x000, 0x087, 0x10e, 0x189, 0x21c, 0x29b, 0x312, 0x395,
+	0x438, 0x4bf, 0x536, 0x5b1, 0x624, 0x6a3, 0x72a, 0x7ad
+};
+
+static void mac_mul_table(const mac_t *mac, unsigned long long x[2])
+{
+	unsigned long long zl = 0, zh = 0, top;
+	int i, nib;
+
+	for (i = 124; i >= 0; i -= 4) {
+		top = zh >> 60;
+		zh = (zh << 4) | (zl >> 60);
+		zl = (zl << 4) ^ mac_r4[top];
+		nib = (int) (((i >= 64) ? (x[1] >> (i - 64)) : (x[0] >> i)) & 15);
+		zl ^= mac->table[nib][0];
+		zh ^= mac->table[nib][1];
+	}
+	x[0] = zl;
+	x[1] = zh;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LE_HAVE_CLMUL	1
+
+/*  clmul_reduce  --  256 bit product (hi:lo) modulo the field polynomial:
+	fold word 3 into words 1-2, then word 2 into words 0-1.  */
+
+__attribute__((target("pclmul,sse2")))
+static __m128i clmul_reduce(__m128i lo, __m128i hi)
+{
+	__m128i t, poly;
+
+	poly = _mm_set_epi64x(0, 0x87);
+	t = _mm_clmulepi64_si128(hi, poly, 0x01);
+	hi = _mm_xor_si128(hi, _mm_srli_si128(t, 8));
+	lo = _mm_xor_si128(lo, _mm_slli_si128(t, 8));
+	t = _mm_clmulepi64_si128(hi, poly, 0x00);
+	return(_mm_xor_si128(lo, t));
+}
+
+__attribute__((target("pclmul,sse2")))
+static void mac_mul_clmul(const unsigned long long h[2], unsigned long long x[2])
+{
+	__m128i a, b, lo, hi, mid;
+
+	a = _mm_loadu_si128((const __m128i *) x);
+	b = _mm_loadu_si128((const __m128i *) h);
+	lo = _mm_clmulepi64_si128(a, b, 0x00);
+	hi = _mm_clmulepi64_si128(a, b, 0x11);
+	mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x01), _mm_clmulepi64_si128(a, b, 0x10));
+	lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+	hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+	_mm_storeu_si128((__m128i *) x, clmul_reduce(lo, hi));
+}
+
+/*  mac_mul4_clmul  --  absorb four blocks at once: ((acc ^ b0) * H^4) ^
+	(b1 * H^3) ^ (b2 * H^2) ^ (b3 * H), with a single reduction.  */
+
+__attribute__((target("pclmul,sse2")))
+static void mac_mul4_clmul(const unsigned long long hp[4][2], unsigned long long acc[2], const unsigned char *p)
+{
+	__m128i a, b, lo, hi, mid;
+	int i;
+
+	lo = hi = mid = _mm_setzero_si128();
+	for (i = 0; i < 4; i++) {
+		a = _mm_loadu_si128((const __m128i *) (p + 16 * i));
+		if (i == 0)
+			a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *) acc));
+		b = _mm_loadu_si128((const __m128i *) hp[3 - i]);
+		lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(a, b, 0x00));
+		hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(a, b, 0x11));
+		mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x01));
+		mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(a, b, 0x10));
+	}
+	lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+	hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+	_mm_storeu_si128((__m128i *) acc, clmul_reduce(lo, hi));
+}
+#endif
+
+static void mac_init(mac_t *mac, const unsigned char *key)
+{
+	int i;
+
+	memset(mac, 0, sizeof(mac_t));
+	mac->h[0] = get64(key);
+	mac->h[1] = get64(key + 8);
+	mac->s[0] = get64(key + 16);
+	mac->s[1] = get64(key + 24);
+	mac->table[1][0] = mac->h[0];
+	mac->table[1][1] = mac->h[1];
+	for (i = 2; i < 16; i += 2) {
+		mac->table[i][1] = (mac->table[i / 2][1] << 1) | (mac->table[i / 2][0] >> 63);
+		mac->table[i][0] = (mac->table[i / 2][0] << 1) ^ ((mac->table[i / 2][1] >> 63) ? 0x87 : 0);
+		mac->table[i + 1][0] = mac->table[i][0] ^ mac->h[0];
+		mac->table[i + 1][1] = mac->table[i][1] ^ mac->h[1];
+	}
+#ifdef LE_HAVE_CLMUL
+	if ((mac->clmul = __builtin_cpu_supports("pclmul")) != 0) {
+		memcpy(mac->hp[0], mac->h, sizeof(mac->h));
+		for (i = 1; i < 4; i++) {
+			memcpy(mac->hp[i], mac->hp[i - 1], sizeof(mac->h));
+			mac_mul_clmul(mac->h, mac->hp[i]);
+		}
+	}
+#endif
+}
+
+static void mac_block(mac_t *mac, const unsigned char *p)
+{
+	mac->acc[0] ^= get64(p);
+	mac->acc[1] ^= get64(p + 8);
+#ifdef LE_HAVE_CLMUL
+	if (mac->clmul) {
+		mac_mul_clmul(mac->h, mac->acc);
+		return;
+	}
+#endif
+	mac_mul_table(mac, mac->acc);
+}
+
+static void mac_update(mac_t *mac, const unsigned char *p, size_t len)
+{
+	size_t take;
+
+	mac->total += len;
+	if (mac->fill > 0) {
+		take = (len < 16 - mac->fill) ? len : 16 - mac->fill;
+		memcpy(mac->part + mac->fill, p, take);
+		mac->fill += take;
+		p += take;
+		len -= take;
+		if (mac->fill < 16)
+			return;
+		mac_block(mac, mac->part);
+		mac->fill = 0;
+	}
+#ifdef LE_HAVE_CLMUL
+	if (mac->clmul)
+		for (; len >= 64; p += 64, len -= 64)
+			mac_mul4_clmul(mac->hp, mac->acc, p);
+#endif
+	for (; len >= 16; p += 16, len -= 16)
+		mac_block(mac, p);
+	memcpy(mac->part, p, len);
+	mac->fill = len;
+}
+
+static void mac_final(mac_t *mac, unsigned char *tag)
+{
+	unsigned char last[16];
+
+	if (mac->fill > 0) {
+		memset(mac->part + mac->fill, 0, 16 - mac->fill);
+		mac_block(mac, mac->part);
+	}
+	memset(last, 0, sizeof(last));
+	put64(last, mac->total * 8);
+	mac_block(mac, last);
+	put64(tag, mac->acc[0] ^ mac->s[0]);
+	put64(tag + 8, mac->acc[1] ^ mac->s[1]);
+}
+
+/*  mac_xor  --  buf ^= pad over n bytes, absorbing the ciphertext in
+	LE_MAC_CHUNK byte slices while they are in L1: after the XOR when
+	encrypting, before it when decrypting.  */
+
+static void mac_xor(mac_t *mac, unsigned char *buf, const unsigned char *pad, size_t n, int encrypting)
+{
+	size_t i, len;
+
+	for (i = 0; i < n; i += len) {
+		len = (n - i < LE_MAC_CHUNK) ? n - i : LE_MAC_CHUNK;
+		if (!encrypting)
+			mac_update(mac, buf + i, len);
+		xor_block(buf + i, pad + i, len);
+		if (encrypting)
+			mac_update(mac, buf + i, len);
+	}
+}
+
+static int mac_verify(mac_t *mac, const unsigned char *tag)
+{
+	unsigned char want[LE_MAC_TAG];
+	int i, diff = 0;
+
+	mac_final(mac, want);
+	for (i = 0; i < LE_MAC_TAG; i++)
+		diff |= want[i] ^ tag[i];
+	return(diff == 0);
+}
+
+/*  Ciphertext container  --  optional clear header ahead of the XOR body.
+
+	"ERC1", 16 bit flags, 16 bit header length (readers skip fields
+	they do not know), then the body, which is XORed with the pad from
+	its first byte.  With LE_CT_PAD the header goes on with the 16 byte
+	ID of the container pad and the 64 bit pad data offset the body
+	starts at.  With LE_CT_LZ or LE_CT_AUTH the body is a series of
+	blocks, each a 32 bit length (LE_CT_RAW set when stored without
+	compression) and data, ended by a zero length; at most
+	LE_BLOCK_SIZE clear bytes per block.  LE_CT_AUTH takes the MAC key
+	from the pad ahead of the first block and appends the clear tag.
+	Otherwise the body is plain XOR ciphertext.  Plain ciphertext
+	without a header is still written (legacy pads) and read.
+
+	LE_CT_CHUNK (not with LE_CT_AUTH) cuts the body into chunks of
+	options->chunk clear bytes, each plain ciphertext or its own series
+	of LZ blocks with its own zero length, and follows the body with a
+	clear index: per chunk its file offset, body length, clear length
+	and xxh64 (chained over its LE_BLOCK_SIZE pieces) of its
+	ciphertext, then a trailer of "ERCI", the chunk count, the index
+	offset and an xxh64 of index and trailer.  The pad is used
+	byte for byte with the body, so any chunk can be checked and
+	decrypted on its own, and D decrypts them in parallel.  */
+
+static int ct_write_header(options_t *options, unsigned int flags, unsigned char *hdr, size_t *hdrlen)
+{
+	size_t len = LE_CT_BASE;
+
+	memcpy(hdr, LE_CT_MAGIC, 4);
+	put16(hdr + 4, flags);
+	if (flags & LE_CT_PAD) {
+		memcpy(hdr + LE_CT_BASE, options->pad.id, LE_PAD_ID);
+		put64(hdr + LE_CT_BASE + LE_PAD_ID, options->pad.consumed);
+		len = LE_CT_PADHDR;
+	}
+	put16(hdr + 6, (unsigned int) len);
+	*hdrlen = len;
+	if (le_write(options->output, hdr, len) < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_ENC);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_read_header  --  finish reading a container header whose first
+	LE_CT_BASE bytes are in hdr, position the pad the body was made
+	with and return the flags.  scratch is one block buffer.  */
+
+static int ct_read_header(options_t *options, const unsigned char *hdr, unsigned char *scratch, unsigned int *flags)
+{
+	unsigned int hdrlen;
+	size_t len, skip;
+
+	*flags = get16(hdr + 4);
+	hdrlen = get16(hdr + 6);
+	if ((*flags & ~LE_CT_KNOWN) || ((*flags & LE_CT_CHUNK) && (*flags & LE_CT_AUTH))
+		|| (hdrlen < ((*flags & LE_CT_PAD) ? LE_CT_PADHDR : LE_CT_BASE))) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_FLAGS);
+		return(EXIT_FAILURE);
+	}
+	for (skip = hdrlen - LE_CT_BASE; skip > 0; skip -= len) {
+		len = (skip < LE_BLOCK_SIZE) ? skip : LE_BLOCK_SIZE;
+		if (le_read(options->input, scratch, len) != (ssize_t) len) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_ENC_SHORT);
+			return(EXIT_FAILURE);
+		}
+	}
+	if (!(*flags & LE_CT_PAD))
+		return(EXIT_SUCCESS);
+
+	/* hdrlen < LE_BLOCK_SIZE, so the pad fields are still in scratch */
+
+	if ((options->pad.hdrlen == 0) || (memcmp(scratch, options->pad.id, LE_PAD_ID) != 0)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_ID);
+		return(EXIT_FAILURE);
+	}
+	if (le_pad_seek(options->otp, &options->pad, get64(scratch + LE_PAD_ID)) != EXIT_SUCCESS) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_pad_take  --  n bytes of fresh pad for E: from the OTP file, or in
+	CMD_ALT from the device (then written to the new OTP file).  */
+
+static int ct_pad_take(options_t *options, unsigned char *pad, size_t n)
+{
+	if (options->cmd_mode == CMD_ALT) {
+		if (harvest(options, pad, n) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		if (le_write(options->otp, pad, n) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
+			return(EXIT_FAILURE);
+		}
+	} else
+		if (le_read(options->otp, pad, n) != (ssize_t) n) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+			return(EXIT_FAILURE);
+		}
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_body_write  --  XOR n body bytes with fresh pad, absorbing them into
+	mac when authenticating, and write them.  */
+
+static int ct_body_write(options_t *options, unsigned char *body, unsigned char *pad, size_t n, mac_t *mac)
+{
+	if (ct_pad_take(options, pad, n) != EXIT_SUCCESS)
+		return(EXIT_FAILURE);
+	if (mac != NULL)
+		mac_xor(mac, body, pad, n, TRUE);
+	else
+		xor_block(body, pad, n);
+	if (le_write(options->output, body, n) < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_ENC);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_body_read  --  read n body bytes and XOR them back with the pad.  */
+
+static int ct_body_read(options_t *options, unsigned char *body, unsigned char *pad, size_t n, mac_t *mac)
+{
+	if (le_read(options->input, body, n) != (ssize_t) n) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_ENC_SHORT);
+		return(EXIT_FAILURE);
+	}
+	if (le_read(options->otp, pad, n) != (ssize_t) n) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+		return(EXIT_FAILURE);
+	}
+	if (mac != NULL)
+		mac_xor(mac, body, pad, n, FALSE);
+	else
+		xor_block(body, pad, n);
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_sum_t  --  xxh64 of a chunk body, chained over its LE_BLOCK_SIZE
+	pieces whatever sizes it arrives in.  */
+
+typedef struct {
+	unsigned long long		sum;
+	unsigned char			*buf;		/* the piece being filled */
+	size_t					fill;
+} ct_sum_t;
+
+static void ct_sum_add(ct_sum_t *cs, const unsigned char *p, size_t n)
+{
+	size_t k;
+
+	while (n > 0) {
+		if ((cs->fill == 0) && (n >= LE_BLOCK_SIZE)) {
+			cs->sum = xxh64(p, LE_BLOCK_SIZE, cs->sum);
+			p += LE_BLOCK_SIZE;
+			n -= LE_BLOCK_SIZE;
+			continue;
+		}
+		k = (n < LE_BLOCK_SIZE - cs->fill) ? n : LE_BLOCK_SIZE - cs->fill;
+		memcpy(cs->buf + cs->fill, p, k);
+		cs->fill += k;
+		p += k;
+		n -= k;
+		if (cs->fill == LE_BLOCK_SIZE) {
+			cs->sum = xxh64(cs->buf, LE_BLOCK_SIZE, cs->sum);
+			cs->fill = 0;
+		}
+	}
+}
+
+/*  ct_sum_end  --  the sum of everything added, ready for the next body.  */
+
+static unsigned long long ct_sum_end(ct_sum_t *cs)
+{
+	unsigned long long sum = cs->sum;
+
+	if (cs->fill > 0)
+		sum = xxh64(cs->buf, cs->fill, sum);
+	cs->sum = 0;
+	cs->fill = 0;
+	return(sum);
+}
+
+/*  ct_chunks_t  --  E's chunk index as it grows.  */
+
+typedef struct {
+	unsigned char			*index;		/* LE_CT_ENTRY bytes per closed chunk */
+	unsigned long long		count;
+	unsigned long long		offset;		/* file offset of the open chunk */
+	unsigned long long		length;		/* its body bytes so far */
+	unsigned long long		clear;		/* and the clear bytes they hold */
+	ct_sum_t				sum;
+} ct_chunks_t;
+
+/*  ct_chunk_close  --  end the open chunk (with its zero length when LZ
+	framed) and add it to the index.  body and pad are block buffers.  */
+
+static int ct_chunk_close(options_t *options, ct_chunks_t *cc, unsigned char *body, unsigned char *pad, unsigned int flags)
+{
+	unsigned char *grown;
+
+	if (flags & LE_CT_LZ) {
+		put32(body, 0);
+		if (ct_body_write(options, body, pad, 4, NULL) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		ct_sum_add(&cc->sum, body, 4);
+		cc->length += 4;
+	}
+
+	/* the index doubles whenever the count reaches a power of two */
+
+	if ((cc->count & (cc->count - 1)) == 0) {
+		if ((grown = realloc(cc->index, (size_t) (cc->count ? 2 * cc->count : 1) * LE_CT_ENTRY)) == NULL) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+			return(EXIT_FAILURE);
+		}
+		cc->index = grown;
+	}
+	put64(cc->index + LE_CT_ENTRY * cc->count, cc->offset);
+	put64(cc->index + LE_CT_ENTRY * cc->count + 8, cc->length);
+	put64(cc->index + LE_CT_ENTRY * cc->count + 16, cc->clear);
+	put64(cc->index + LE_CT_ENTRY * cc->count + 24, ct_sum_end(&cc->sum));
+	cc->count++;
+	cc->offset += cc->length;
+	cc->length = 0;
+	cc->clear = 0;
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_index_write  --  write the chunk index and its trailer.  */
+
+static int ct_index_write(options_t *options, const ct_chunks_t *cc)
+{
+	unsigned char trailer[LE_CT_TRAILER];
+
+	memcpy(trailer, LE_CT_IMAGIC, 4);
+	put32(trailer + 4, 0);
+	put64(trailer + 8, cc->count);
+	put64(trailer + 16, cc->offset);
+	put64(trailer + 24, xxh64(trailer, 24, xxh64(cc->index, (size_t) cc->count * LE_CT_ENTRY, 0)));
+	if ((le_write(options->output, cc->index, (size_t) cc->count * LE_CT_ENTRY) < 0)
+		|| (le_write(options->output, trailer, sizeof(trailer)) < 0)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_ENC);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  encrypt_container  --  E of a framed body (compressed and/or
+	authenticated) or a chunked one, header included.  blocks holds
+	LE_CT_BLOCKS block buffers.  */
+
+static int encrypt_container(options_t *options, unsigned char *blocks, unsigned int flags)
+{
+	unsigned char *clear = blocks;
+	unsigned char *body = blocks + LE_BLOCK_SIZE;
+	unsigned char *pad = blocks + 3 * LE_BLOCK_SIZE;
+	unsigned char hdr[LE_CT_PADHDR], key[LE_MAC_KEY], *at;
+	unsigned long long step = 0;
+	ct_chunks_t cc;
+	mac_t mac, *mp = NULL;
+	size_t len;
+	ssize_t n;
+	int inp_fine = FALSE;
+	int rc = EXIT_FAILURE;
+
+	memset(&cc, 0, sizeof(cc));
+	if (ct_write_header(options, flags, hdr, &len) != EXIT_SUCCESS)
+		return(EXIT_FAILURE);
+	if (flags & LE_CT_AUTH) {
+		if (ct_pad_take(options, key, sizeof(key)) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		mp = &mac;
+		mac_init(mp, key);
+		mac_update(mp, hdr, len);
+	}
+
+	/* chunks are whole blocks, so every chunk but the last holds step bytes */
+
+	if (flags & LE_CT_CHUNK) {
+		step = (options->chunk + LE_BLOCK_SIZE - 1) / LE_BLOCK_SIZE * LE_BLOCK_SIZE;
+		if (step < LE_CT_CHUNK_MIN)
+			step = LE_CT_CHUNK_MIN;
+		cc.offset = len;
+		if ((cc.sum.buf = alloc_blocks(options, 1)) == NULL)
+			return(EXIT_FAILURE);
+	}
+
+	while ((n = le_read(options->input, (flags & LE_CT_LZ) ? clear : body + 4, LE_BLOCK_SIZE)) > 0) {
+		inp_fine = TRUE;
+		at = body;
+		if (!(flags & LE_CT_FRAMED)) {
+			at = body + 4;
+			len = (size_t) n;
+		} else {
+			if ((flags & LE_CT_LZ) && ((len = lz_compress(clear, (size_t) n, body + 4, LE_BLOCK_SIZE)) > 0))
+				put32(body, (unsigned int) len);
+			else {
+				if (flags & LE_CT_LZ)
+					memcpy(body + 4, clear, (size_t) n);
+				len = (size_t) n;
+				put32(body, (unsigned int) len | LE_CT_RAW);
+			}
+			len += 4;
+		}
+		if (ct_body_write(options, at, pad, len, mp) != EXIT_SUCCESS)
+			goto done;
+		if (flags & LE_CT_CHUNK) {
+			ct_sum_add(&cc.sum, at, len);
+			cc.length += len;
+			if (((cc.clear += (unsigned long long) n) >= step) && (ct_chunk_close(options, &cc, body, pad, flags) != EXIT_SUCCESS))
+				goto done;
+		}
+		if (tick(options, (unsigned long long) n) != EXIT_SUCCESS)
+			goto done;
+	}
+
+	if (inp_fine == FALSE) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_INPUT);
+		goto done;
+	}
+
+	if (flags & LE_CT_CHUNK) {
+		if ((cc.clear > 0) && (ct_chunk_close(options, &cc, body, pad, flags) != EXIT_SUCCESS))
+			goto done;
+		rc = ct_index_write(options, &cc);
+		goto done;
+	}
+	put32(body, 0);
+	if (ct_body_write(options, body, pad, 4, mp) != EXIT_SUCCESS)
+		goto done;
+	if (mp != NULL) {
+		mac_final(mp, key);
+		if (le_write(options->output, key, LE_MAC_TAG) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_ENC);
+			goto done;
+		}
+	}
+	rc = EXIT_SUCCESS;
+
+done:
+	free(cc.index);
+	if (cc.sum.buf != NULL)
+		le_buf_put(cc.sum.buf);
+	return(rc);
+}
+
+/*  decrypt_container  --  D of a framed body.  hdr holds the first
+	LE_CT_BASE header bytes and blocks still holds the rest, as left by
+	ct_read_header.  options->size limits the clear output; an
+	authenticated body is still read to its end to check the tag.  */
+
+static int decrypt_container(options_t *options, unsigned char *blocks, const unsigned char *hdr, unsigned int flags)
+{
+	unsigned char *clear = blocks;
+	unsigned char *body = blocks + LE_BLOCK_SIZE;
+	unsigned char *pad = blocks + 3 * LE_BLOCK_SIZE;
+	unsigned char key[LE_MAC_KEY];
+	unsigned long long keep_count = 0;
+	unsigned int word;
+	mac_t mac, *mp = NULL;
+	size_t len;
+	long out;
+
+	if (flags & LE_CT_AUTH) {
+		if (le_read(options->otp, key, sizeof(key)) != (ssize_t) sizeof(key)) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+			return(EXIT_FAILURE);
+		}
+		mp = &mac;
+		mac_init(mp, key);
+		mac_update(mp, hdr, LE_CT_BASE);
+		mac_update(mp, blocks, get16(hdr + 6) - LE_CT_BASE);
+	}
+
+	for (;;) {
+		if (ct_body_read(options, body, pad, 4, mp) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		if ((word = get32(body)) == 0)
+			break;
+		len = word & ~LE_CT_RAW;
+		if (len > LE_BLOCK_SIZE) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_CORRUPT);
+			return(EXIT_FAILURE);
+		}
+		if (ct_body_read(options, body, pad, len, mp) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		if (word & LE_CT_RAW) {
+			memcpy(clear, body, len);
+			out = (long) len;
+		} else
+			if ((out = lz_decompress(body, len, clear, LE_BLOCK_SIZE)) < 0) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_CORRUPT);
+				return(EXIT_FAILURE);
+			}
+		if ((options->size > 0) && ((unsigned long long) out > options->size - keep_count))
+			out = (long) (options->size - keep_count);
+		if (le_write(options->output, clear, (size_t) out) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_DEC);
+			return(EXIT_FAILURE);
+		}
+		keep_count += (unsigned long long) out;
+		if (tick(options, (unsigned long long) out) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+		if ((options->size > 0) && (keep_count >= options->size) && (mp == NULL))
+			break;
+	}
+
+	if (mp == NULL)
+		return(EXIT_SUCCESS);
+	if ((le_read(options->input, key, LE_MAC_TAG) != LE_MAC_TAG) || !mac_verify(mp, key)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_AUTH);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_decrypt_t  --  one D of a chunked body, shared by its workers.  */
+
+typedef struct {
+	options_t				*options;
+	unsigned int			flags;
+	const unsigned char		*index;
+	const unsigned long long	*out;	/* clear offset of each chunk */
+	unsigned long long		first, last;	/* chunks to decrypt, [first, last) */
+	unsigned long long		next;		/* next chunk a worker takes */
+	unsigned long long		body;		/* file offset of the body */
+	unsigned long long		pad;		/* OTP stream offset it was XORed with */
+	unsigned long long		limit;		/* clear bytes to write, 0 for all */
+	int						parallel;	/* output written with pwrite */
+	pthread_mutex_t			lock;		/* errmsg, tick and the counts below */
+	int						failed;
+	unsigned long long		rbytes, pbytes, wbytes;
+} ct_decrypt_t;
+
+static void ct_fail(ct_decrypt_t *cx, const char *msg)
+{
+	pthread_mutex_lock(&cx->lock);
+	if (!cx->failed) {
+		snprintf(cx->options->errmsg, sizeof(cx->options->errmsg), "%s", msg);
+		__atomic_store_n(&cx->failed, TRUE, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&cx->lock);
+}
+
+/*  ct_chunk_read  --  n body bytes at file offset at, summed and XORed
+	back with the pad.  */
+
+static int ct_chunk_read(ct_decrypt_t *cx, ct_sum_t *cs, unsigned char *body, unsigned char *pad, size_t n, unsigned long long at)
+{
+	if (stream_pread(cx->options->input, body, n, at) != (ssize_t) n) {
+		ct_fail(cx, ERR_ENC_SHORT);
+		return(EXIT_FAILURE);
+	}
+	ct_sum_add(cs, body, n);
+	if (stream_pread(cx->options->otp, pad, n, cx->pad + at - cx->body) != (ssize_t) n) {
+		ct_fail(cx, ERR_OTP_SHORT);
+		return(EXIT_FAILURE);
+	}
+	xor_block(body, pad, n);
+	return(EXIT_SUCCESS);
+}
+
+/*  ct_chunk_write  --  n clear bytes at offset done in chunk k, up to the
+	limit.  */
+
+static int ct_chunk_write(ct_decrypt_t *cx, unsigned long long k, unsigned long long done, const unsigned char *clear, size_t n)
+{
+	options_t *options = cx->options;
+	unsigned long long at = cx->out[k] - cx->out[cx->first] + done;
+	int rc = EXIT_SUCCESS;
+
+	if (cx->limit > 0) {
+		if (at >= cx->limit)
+			return(EXIT_SUCCESS);
+		if (n > cx->limit - at)
+			n = (size_t) (cx->limit - at);
+	}
+	if (cx->parallel ? (pwrite(options->output->fd, clear, n, (off_t) at) != (ssize_t) n) : (le_write(options->output, clear, n) < 0)) {
+		ct_fail(cx, ERR_WRITE_DEC);
+		return(EXIT_FAILURE);
+	}
+	pthread_mutex_lock(&cx->lock);
+	cx->wbytes += n;
+	if (!cx->failed && (tick(options, (unsigned long long) n) != EXIT_SUCCESS)) {
+		__atomic_store_n(&cx->failed, TRUE, __ATOMIC_RELAXED);
+		rc = EXIT_FAILURE;
+	}
+	pthread_mutex_unlock(&cx->lock);
+	return(rc);
+}
+
+/*  ct_chunk_decrypt  --  check and decrypt chunk k.  blocks holds
+	LE_CT_BLOCKS block buffers.  The sum is known only at the end of
+	the chunk, so output already written is to be discarded when it
+	fails.  */
+
+static int ct_chunk_decrypt(ct_decrypt_t *cx, unsigned long long k, unsigned char *blocks)
+{
+	const unsigned char *e = cx->index + LE_CT_ENTRY * k;
+	unsigned char *clear = blocks;
+	unsigned char *body = blocks + LE_BLOCK_SIZE;
+	unsigned char *pad = blocks + 2 * LE_BLOCK_SIZE;
+	unsigned long long off = get64(e), len = get64(e + 8), pos = 0, done = 0;
+	unsigned int word;
+	int ended = !(cx->flags & LE_CT_LZ);
+	ct_sum_t cs;
+	size_t n;
+	long m;
+
+	cs.sum = 0;
+	cs.buf = blocks + 3 * LE_BLOCK_SIZE;
+	cs.fill = 0;
+
+	if (!(cx->flags & LE_CT_LZ))
+		for (; pos < len; pos += n, done += n) {
+			n = (len - pos < LE_BLOCK_SIZE) ? (size_t) (len - pos) : LE_BLOCK_SIZE;
+			if ((ct_chunk_read(cx, &cs, body, pad, n, off + pos) != EXIT_SUCCESS)
+				|| (ct_chunk_write(cx, k, done, body, n) != EXIT_SUCCESS))
+				return(EXIT_FAILURE);
+		}
+	else
+		for (;;) {
+			if (pos + 4 > len)
+				break;
+			if (ct_chunk_read(cx, &cs, body, pad, 4, off + pos) != EXIT_SUCCESS)
+				return(EXIT_FAILURE);
+			pos += 4;
+			if ((word = get32(body)) == 0) {
+				ended = TRUE;
+				break;
+			}
+			n = word & ~LE_CT_RAW;
+			if ((n > LE_BLOCK_SIZE) || (pos + n > len))
+				break;
+			if (ct_chunk_read(cx, &cs, body, pad, n, off + pos) != EXIT_SUCCESS)
+				return(EXIT_FAILURE);
+			pos += n;
+			if (word & LE_CT_RAW)
+				m = (long) n;
+			else
+				if ((m = lz_decompress(body, n, clear, LE_BLOCK_SIZE)) < 0)
+					break;
+			if (ct_chunk_write(cx, k, done, (word & LE_CT_RAW) ? body : clear, (size_t) m) != EXIT_SUCCESS)
+				return(EXIT_FAILURE);
+			done += (unsigned long long) m;
+		}
+
+	pthread_mutex_lock(&cx->lock);
+	cx->rbytes += pos;
+	cx->pbytes += pos;
+	pthread_mutex_unlock(&cx->lock);
+	if (!ended || (pos != len) || (done != get64(e + 16)) || (ct_sum_end(&cs) != get64(e + 24))) {
+		ct_fail(cx, ERR_CT_CORRUPT);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+static void *ct_decrypt_main(void *arg)
+{
+	ct_decrypt_t *cx = arg;
+	unsigned char *blocks;
+	unsigned long long k;
+
+	if ((blocks = le_buf_get((size_t) LE_CT_BLOCKS * LE_BLOCK_SIZE)) == NULL) {
+		ct_fail(cx, ERR_BLOCK_ALLOC);
+		return(NULL);
+	}
+	while (!__atomic_load_n(&cx->failed, __ATOMIC_RELAXED) && ((k = __atomic_fetch_add(&cx->next, 1, __ATOMIC_RELAXED)) < cx->last))
+		if (ct_chunk_decrypt(cx, k, blocks) != EXIT_SUCCESS)
+			break;
+	le_buf_put(blocks);
+	return(NULL);
+}
+
+/*  decrypt_chunked  --  D of a chunked body, the input positioned just
+	after the header and the pad where the body starts.  Decrypts every
+	chunk, or only options->chunk_no, with up to LE_CT_THREADS workers
+	when the output is a regular file (one, in order, otherwise).
+	from and to receive the OTP stream range used.  */
+
+static int decrypt_chunked(options_t *options, unsigned int flags, unsigned long long *from, unsigned long long *to)
+{
+	ct_decrypt_t cx;
+	pthread_t tid[LE_CT_THREADS];
+	int started[LE_CT_THREADS];
+	unsigned char trailer[LE_CT_TRAILER];
+	unsigned char *index = NULL;
+	unsigned long long *out = NULL;
+	unsigned long long count, at, end, k, padend;
+	long long size, sz;
+	struct stat st;
+	int threads = 1, i, rc = EXIT_FAILURE;
+
+	memset(&cx, 0, sizeof(cx));
+	cx.options = options;
+	cx.flags = flags;
+	cx.body = options->input->position;
+	cx.pad = options->otp->position;
+	cx.limit = options->size;
+
+	if ((options->input->ops->pread == NULL) || ((size = le_size(options->input)) < 0)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_SEEK);
+		return(EXIT_FAILURE);
+	}
+
+	/* the trailer, then the index it vouches for, which must tile the body */
+
+	if ((size < (long long) (cx.body + LE_CT_TRAILER))
+		|| (stream_pread(options->input, trailer, LE_CT_TRAILER, (unsigned long long) size - LE_CT_TRAILER) != LE_CT_TRAILER)
+		|| (memcmp(trailer, LE_CT_IMAGIC, 4) != 0) || ((count = get64(trailer + 8)) == 0)
+		|| (count > (unsigned long long) size / LE_CT_ENTRY) || ((end = get64(trailer + 16)) < cx.body)
+		|| (end + count * LE_CT_ENTRY + LE_CT_TRAILER != (unsigned long long) size))
+		goto corrupt;
+	if (((index = malloc((size_t) count * LE_CT_ENTRY)) == NULL) || ((out = malloc((size_t) (count + 1) * 8)) == NULL)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		goto done;
+	}
+	if ((stream_pread(options->input, index, (size_t) count * LE_CT_ENTRY, end) != (ssize_t) (count * LE_CT_ENTRY))
+		|| (get64(trailer + 24) != xxh64(trailer, 24, xxh64(index, (size_t) count * LE_CT_ENTRY, 0))))
+		goto corrupt;
+	at = cx.body;
+	out[0] = 0;
+	for (k = 0; k < count; k++) {
+		if ((get64(index + LE_CT_ENTRY * k) != at) || (get64(index + LE_CT_ENTRY * k + 8) > end - at))
+			goto corrupt;
+		at += get64(index + LE_CT_ENTRY * k + 8);
+		out[k + 1] = out[k] + get64(index + LE_CT_ENTRY * k + 16);
+	}
+	if (at != end)
+		goto corrupt;
+	options->input->stats.rbytes += LE_CT_TRAILER + count * LE_CT_ENTRY;
+
+	cx.index = index;
+	cx.out = out;
+	cx.first = 0;
+	cx.last = count;
+	if (options->chunk_no > 0) {
+		if (options->chunk_no > count) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_NOCHUNK);
+			goto done;
+		}
+		cx.first = options->chunk_no - 1;
+		cx.last = options->chunk_no;
+	}
+	while ((cx.limit > 0) && (cx.last > cx.first + 1) && (out[cx.last - 1] - out[cx.first] >= cx.limit))
+		cx.last--;
+	cx.next = cx.first;
+	*from = cx.pad + get64(index + LE_CT_ENTRY * cx.first) - cx.body;
+	*to = cx.pad + get64(index + LE_CT_ENTRY * (cx.last - 1)) + get64(index + LE_CT_ENTRY * (cx.last - 1) + 8) - cx.body;
+
+	/* preads are not bound to the pad data, so check it covers the chunks */
+
+	padend = options->otp->bounded ? options->otp->position + options->otp->remain
+		: (((sz = le_size(options->otp)) >= 0) ? (unsigned long long) sz : *to);
+	if ((options->otp->ops->pread == NULL) || (*to > padend)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+		goto done;
+	}
+	tick_total(options, (long long) (out[cx.last] - out[cx.first]));
+
+	if ((options->output->ops == &fd_ops) && (fstat(options->output->fd, &st) == 0) && S_ISREG(st.st_mode)
+		&& (options->output->position == 0)) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+		if (threads > LE_CT_THREADS)
+			threads = LE_CT_THREADS;
+		if ((unsigned long long) threads > cx.last - cx.first)
+			threads = (int) (cx.last - cx.first);
+		if (threads < 1)
+			threads = 1;
+		cx.parallel = (threads > 1);
+	}
+
+	/* workers take the chunks in turn; the caller works too, so every
+	   chunk is done even if no thread could be started */
+
+	pthread_mutex_init(&cx.lock, NULL);
+	for (i = 0; i < threads; i++)
+		started[i] = (i > 0) && (pthread_create(&tid[i], NULL, ct_decrypt_main, &cx) == 0);
+	ct_decrypt_main(&cx);
+	for (i = 1; i < threads; i++)
+		if (started[i])
+			pthread_join(tid[i], NULL);
+	pthread_mutex_destroy(&cx.lock);
+
+	options->input->stats.rbytes += cx.rbytes;
+	options->otp->stats.rbytes += cx.pbytes;
+	if (cx.parallel)
+		options->output->stats.wbytes += cx.wbytes;
+	rc = cx.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+	goto done;
+
+corrupt:
+	snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_CORRUPT);
+done:
+	free(index);
+	free(out);
+	return(rc);
+}
+
+/*  Wipe  --  destroy used pad bytes in place.
+
+	wipe_pad overwrites a byte range of the OTP file with zeros in large
+	page aligned writes, syncs it and then punches the range out of
+	the file where the filesystem supports FALLOC_FL_PUNCH_HOLE, so
+	only the bytes used are rewritten and nothing is read back.  E and
+	D with options->wipe pass the pad bytes they used; W passes an
+	empty range, meaning the consumed part of a container pad or the
+	first options->size bytes (default all) of a legacy pad.  For a
+	container the index checksums of the touched blocks are refreshed
+	and the consumed offset is moved past the range, so E never uses
+	wiped bytes.  On SSDs and copy-on-write filesystems the old blocks
+	may survive below the file system.  */
+
+static int wipe_range(options_t *options, int fd, unsigned long long from, unsigned long long to)
+{
+	unsigned long long off, len;
+	unsigned char *zeros;
+	ssize_t n;
+
+	if ((zeros = le_buf_get(LE_WIPE_CHUNK)) == NULL) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		return(EXIT_FAILURE);
+	}
+	memset(zeros, 0, LE_WIPE_CHUNK);
+
+	for (off = from; off < to; off += (unsigned long long) n) {
+		len = LE_WIPE_CHUNK - (off % LE_POOL_ALIGN);	/* realign after the head */
+		if (len > to - off)
+			len = to - off;
+		if ((n = pwrite(fd, zeros, (size_t) len, (off_t) off)) <= 0) {
+			if ((n < 0) && (errno == EINTR)) {
+				n = 0;
+				continue;
+			}
+			le_buf_put(zeros);
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WIPE_WRITE);
+			return(EXIT_FAILURE);
+		}
+	}
+	le_buf_put(zeros);
+
+	if (fdatasync(fd) == -1) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WIPE_WRITE);
+		return(EXIT_FAILURE);
+	}
+	if ((to > from) && (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) from, (off_t) (to - from)) == -1)
+		&& (errno != EOPNOTSUPP) && (errno != ENOSYS)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WIPE_WRITE);
+		return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/*  wipe_rehash  --  refresh the index checksums of container blocks that
+	overlap the wiped data range [from, to).  Wholly wiped blocks are
+	hashed as zeros; only the live part of the two edge blocks is read.  */
+
+static int wipe_rehash(options_t *options, int fd, const le_pad_t *pad, unsigned long long from, unsigned long long to)
+{
+	unsigned long long first, last, b, start, end;
+	unsigned char *block, *sums;
+	int rc = EXIT_FAILURE;
+
+	if (to <= from)
+		return(EXIT_SUCCESS);
+	first = from / pad->block_size;
+	last = (to - 1) / pad->block_size;
+	block = le_buf_get(pad->block_size);
+	sums = malloc((size_t) (last - first + 1) * 8);
+	if ((block == NULL) || (sums == NULL)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		goto done;
+	}
+
+	for (b = first; b <= last; b++) {
+		start = b * pad->block_size;
+		end = start + pad->block_size;
+		if (end > pad->length)
+			end = pad->length;
+		if ((start < from) || (end > to)) {
+			if (pread(fd, block, (size_t) (end - start), (off_t) (pad->hdrlen + start)) != (ssize_t) (end - start)) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+				goto done;
+			}
+		} else
+			memset(block, 0, (size_t) (end - start));
+		put64(sums + 8 * (b - first), xxh64(block, (size_t) (end - start), 0));
+	}
+
+	if (pwrite(fd, sums, (size_t) (last - first + 1) * 8, (off_t) (pad->index_offset + 8 + 8 * first))
+		!= (ssize_t) ((last - first + 1) * 8)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WIPE_WRITE);
+		goto done;
+	}
+	rc = EXIT_SUCCESS;
+
+done:
+	free(sums);
+	le_buf_put(block);
+	return(rc);
+}
+
+static int wipe_pad(options_t *options, const char *fsp, unsigned long long from, unsigned long long to)
+{
+	unsigned char hdr[LE_PAD_HDR];
+	long long sz;
+	le_pad_t pad;
+	ssize_t n;
+	int fd, container, rc = EXIT_FAILURE;
+
+	if ((fsp[0] == '\0') || ((fd = open(fsp, O_RDWR | O_CLOEXEC)) < 0)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WIPE_OPEN);
+		return(EXIT_FAILURE);
+	}
+	if (flock(fd, LOCK_EX) == -1) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WIPE_OPEN);
+		goto done;
+	}
+	if ((n = pread(fd, hdr, sizeof(hdr), 0)) < 0)
+		n = 0;
+	if ((container = pad_decode(&pad, hdr, (size_t) n)) < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_HEADER);
+		goto done;
+	}
+
+	if (to <= from) {
+		if (container) {
+			from = pad.hdrlen;
+			to = pad.hdrlen + pad.consumed;
+		} else {
+			if ((sz = fd_size_of(fd)) < 0) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_STAT);
+				goto done;
+			}
+			from = 0;
+			to = ((options->size > 0) && (options->size < (unsigned long long) sz)) ? options->size : (unsigned long long) sz;
+		}
+	}
+
+	if (container) {
+		if (from < pad.hdrlen)
+			from = pad.hdrlen;
+		if (to > pad.hdrlen + pad.length)
+			to = pad.hdrlen + pad.length;
+		if (to < from)
+			to = from;
+	}
+
+	if (wipe_range(options, fd, from, to) != EXIT_SUCCESS)
+		goto done;
+
+	if (container) {
+		if (wipe_rehash(options, fd, &pad, from - pad.hdrlen, to - pad.hdrlen) != EXIT_SUCCESS)
+			goto done;
+		if (to - pad.hdrlen > pad.consumed)
+			pad.consumed = to - pad.hdrlen;
+		if (pad_store(fd, &pad) != EXIT_SUCCESS) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_UPDATE);
+			goto done;
+		}
+		options->pad = pad;
+	}
+	options->stats.wiped += to - from;
+	rc = EXIT_SUCCESS;
+
+done:
+	close(fd);
+	return(rc);
+}
+
+/*  wipe_used  --  wipe OTP stream bytes [from, to), or the default range
+	when empty; a stripe set is wiped member by member.  */
+
+static int wipe_used(options_t *options, unsigned long long from, unsigned long long to)
+{
+	le_pad_t pad;
+	stripe_t *st;
+	int k, rc = EXIT_SUCCESS;
+
+	if (options->otp->ops != &stripe_ops)
+		return(wipe_pad(options, options->otp_fsp, from, to));
+	st = options->otp->handle;
+	from = (from > st->hdrlen) ? from - st->hdrlen : 0;
+	to = (to > st->hdrlen) ? to - st->hdrlen : 0;
+	pad = options->pad;
+	for (k = 0; (k < st->count) && (rc == EXIT_SUCCESS); k++)
+		if (to <= from)
+			rc = wipe_pad(options, st->fsp[k], 0, 0);
+		else
+			if (stripe_used(st, k, to) > stripe_used(st, k, from))
+				rc = wipe_pad(options, st->fsp[k], st->pad[k].hdrlen + stripe_used(st, k, from), st->pad[k].hdrlen + stripe_used(st, k, to));
+	options->pad = pad;
+	return(rc);
+}
+
+/*  Reuse index  --  catch pad material being used twice.
+
+	Pad data is cut into content-defined chunks and each chunk is
+	fingerprinted with xxh64.  A chunk ends after each occurrence of a
+	fixed byte pair, a rolling hash of window 2 that memchr can scan at
+	memory speed: pad data is uniformly random, so cuts come about every
+	64K, and as they depend on the data alone a copy of a pad, or part of
+	one at any offset, yields the same fingerprints.  Chunks are cut at
+	1M when no pair turns up (wiped or other non-random data).
+
+	The index (options->reuse_fsp) is an open addressing table of
+	fingerprint, chunk length and bytes of the chunk used by E, mapped
+	shared and updated under flock, behind a blocked Bloom filter of 8
+	bits per slot that answers most misses from one cache line.  G adds
+	the chunks of each new pad; E claims the chunks of the range it is
+	about to use and is refused if any of them was used that far before;
+	it then settles the claim to the bytes it really used.  The table
+	doubles (into a new file renamed over the old) at half full, so a
+	few hundred MB indexes a terabyte of pad.  */
+
+typedef struct {
+	unsigned long long		fp;			/* chunk fingerprint, 0 for empty */
+	unsigned int			len;		/* chunk bytes */
+	unsigned int			used;		/* bytes from the chunk start used by E */
+} reuse_slot_t;
+
+typedef struct {
+	int						fd;
+	unsigned char			*map, *bloom;
+	size_t					size;
+	unsigned long long		slots;
+	reuse_slot_t			*table;
+} reuse_t;
+
+typedef struct {
+	unsigned long long		fp, start;	/* start is a pad data offset */
+	unsigned int			len, prior, claimed;
+} reuse_chunk_t;
+
+/*  reuse_map  --  map the index behind fd, checking its header.  */
+
+static int reuse_map(reuse_t *r)
+{
+	unsigned char hdr[24];
+	struct stat st;
+
+	if ((fstat(r->fd, &st) == -1) || (pread(r->fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr))
+		|| (memcmp(hdr, LE_REUSE_MAGIC, 4) != 0))
+		return(EXIT_FAILURE);
+	r->slots = get64(hdr + 8);
+	r->size = LE_REUSE_HDR + (size_t) r->slots * (1 + sizeof(reuse_slot_t));
+	if ((r->slots < LE_REUSE_SLOTS) || (r->slots & (r->slots - 1)) || ((unsigned long long) st.st_size != r->size))
+		return(EXIT_FAILURE);
+	if ((r->map = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, r->fd, 0)) == MAP_FAILED) {
+		r->map = NULL;
+		return(EXIT_FAILURE);
+	}
+	r->bloom = r->map + LE_REUSE_HDR;
+	r->table = (reuse_slot_t *) (r->bloom + r->slots);
+	return(EXIT_SUCCESS);
+}
+
+/*  reuse_create  --  an empty index of slots slots on fd.  */
+
+static int reuse_create(reuse_t *r, unsigned long long slots)
+{
+	unsigned char hdr[24];
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, LE_REUSE_MAGIC, 4);
+	put32(hdr + 4, 1);
+	put64(hdr + 8, slots);
+	if ((ftruncate(r->fd, (off_t) (LE_REUSE_HDR + slots * (1 + sizeof(reuse_slot_t)))) == -1)
+		|| (pwrite(r->fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr)))
+		return(EXIT_FAILURE);
+	return(reuse_map(r));
+}
+
+/*  reuse_open  --  open and lock the index of options, creating it when
+	new.  Retries when a growing writer renamed a new file over it.  */
+
+static int reuse_open(options_t *options, reuse_t *r)
+{
+	struct stat a, b;
+
+	memset(r, 0, sizeof(reuse_t));
+	for (;;) {
+		if ((r->fd = open(options->reuse_fsp, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0)
+			break;
+		if ((flock(r->fd, LOCK_EX) == -1) || (fstat(r->fd, &a) == -1))
+			break;
+		if ((stat(options->reuse_fsp, &b) == 0) && (a.st_ino == b.st_ino) && (a.st_dev == b.st_dev)) {
+			if (((a.st_size == 0) ? reuse_create(r, LE_REUSE_SLOTS) : reuse_map(r)) != EXIT_SUCCESS)
+				break;
+			return(EXIT_SUCCESS);
+		}
+		close(r->fd);
+	}
+	if (r->fd >= 0)
+		close(r->fd);
+	snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_REUSE_OPEN);
+	return(EXIT_FAILURE);
+}
+
+static void reuse_close(reuse_t *r)
+{
+	if (r->map != NULL)
+		munmap(r->map, r->size);
+	close(r->fd);
+}
+
+/*  reuse_bloom  --  the Bloom line of fp (a 64 byte block) and, when set,
+	mark its four bits; returns whether they were all set before.  */
+
+static int reuse_bloom(reuse_t *r, unsigned long long fp, int set)
+{
+	unsigned long long g = fp * 0x9e3779b97f4a7c15ULL;
+	unsigned char *line = r->bloom + 64 * ((g >> 36) & (r->slots / 64 - 1));
+	unsigned int bit;
+	int i, all = TRUE;
+
+	for (i = 0; i < 4; i++) {
+		bit = (unsigned int) (g >> (9 * i)) & 511;
+		if (!(line[bit >> 3] & (1 << (bit & 7))))
+			all = FALSE;
+		if (set)
+			line[bit >> 3] |= (unsigned char) (1 << (bit & 7));
+	}
+	return(all);
+}
+
+static reuse_slot_t *reuse_find(reuse_t *r, unsigned long long fp)
+{
+	unsigned long long i;
+
+	if (!reuse_bloom(r, fp, FALSE))
+		return(NULL);
+	for (i = fp & (r->slots - 1); r->table[i].fp != 0; i = (i + 1) & (r->slots - 1))
+		if (r->table[i].fp == fp)
+			return(&r->table[i]);
+	return(NULL);
+}
+
+static reuse_slot_t *reuse_put(reuse_t *r, unsigned long long fp, unsigned int len, unsigned int used)
+{
+	unsigned long long i;
+
+	for (i = fp & (r->slots - 1); r->table[i].fp != 0; i = (i + 1) & (r->slots - 1))
+		;
+	r->table[i].fp = fp;
+	r->table[i].len = len;
+	r->table[i].used = used;
+	reuse_bloom(r, fp, TRUE);
+	put64(r->map + 16, get64(r->map + 16) + 1);
+	return(&r->table[i]);
+}
+
+/*  reuse_insert  --  add a new fingerprint, first doubling the table into
+	a new file when it is half full.  */
+
+static reuse_slot_t *reuse_insert(options_t *options, reuse_t *r, unsigned long long fp, unsigned int len, unsigned int used)
+{
+	char tmp[MAX_FSP_PATH + 8];
+	reuse_t n;
+	unsigned long long i;
+
+	if (2 * (get64(r->map + 16) + 1) > r->slots) {
+		snprintf(tmp, sizeof(tmp), "%s.tmp", options->reuse_fsp);
+		memset(&n, 0, sizeof(n));
+		if (((n.fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) < 0)
+			|| (flock(n.fd, LOCK_EX) == -1) || (reuse_create(&n, 2 * r->slots) != EXIT_SUCCESS)) {
+			if (n.fd >= 0) {
+				if (n.map != NULL)
+					munmap(n.map, n.size);
+				close(n.fd);
+				unlink(tmp);
+			}
+			return(NULL);
+		}
+		for (i = 0; i < r->slots; i++)
+			if (r->table[i].fp != 0)
+				reuse_put(&n, r->table[i].fp, r->table[i].len, r->table[i].used);
+		if (rename(tmp, options->reuse_fsp) == -1) {
+			reuse_close(&n);
+			unlink(tmp);
+			return(NULL);
+		}
+		reuse_close(r);
+		*r = n;
+	}
+	return(reuse_put(r, fp, len, used));
+}
+
+/*  reuse_cut  --  1 + the offset of the first cut in p[0, len), or 0.
+	p[-1] must be readable.  memchr finds the candidates.  */
+
+static size_t reuse_cut(const unsigned char *p, size_t len)
+{
+	const unsigned char *q, *e = p + len;
+
+	for (q = p; (q < e) && ((q = memchr(q, LE_REUSE_B, (size_t) (e - q))) != NULL); q++)
+		if (q[-1] == LE_REUSE_A)
+			return((size_t) (q - p) + 1);
+	return(0);
+}
+
+/*  reuse_scan  --  chunk the pad data of stream (data offset 0 at stream
+	offset base, end bytes long) around [from, to): returns the chunks
+	ending past from, up to the first one reaching to.  Scanning starts
+	LE_REUSE_MAX before from, where the chunk holding from must begin,
+	and the first chunk, which may start mid-chunk, is dropped.  */
+
+static reuse_chunk_t *reuse_scan(le_stream_t *stream, unsigned long long base, unsigned long long end,
+	unsigned long long from, unsigned long long to, size_t *count)
+{
+	unsigned long long off, start;
+	unsigned char *win, *c;
+	reuse_chunk_t *chunks, *grow;
+	size_t have = 0, scanned, skip = 1, n, cap = 1, want;
+	ssize_t got;
+	int synced;
+
+	start = off = (from > LE_REUSE_MAX) ? from - LE_REUSE_MAX : 0;
+	synced = (start == 0);
+	*count = 0;
+	if ((win = calloc(1, 1 + LE_REUSE_MAX)) == NULL)
+		return(NULL);
+	c = win + 1;
+	if ((chunks = malloc(sizeof(reuse_chunk_t))) == NULL) {
+		free(win);
+		return(NULL);
+	}
+
+	while ((start < end) && (start < to)) {
+
+		/* extend the chunk a block at a time until it is cut */
+
+		for (scanned = skip, n = 0; n == 0; ) {
+			if (scanned < have)
+				if ((n = reuse_cut(c + scanned, have - scanned)) != 0) {
+					n += scanned;
+					break;
+				}
+			scanned = (have > skip) ? have : skip;
+			if ((have == LE_REUSE_MAX) || (off == end)) {
+				n = have;
+				break;
+			}
+			want = (LE_REUSE_MAX - have < LE_BLOCK_SIZE) ? LE_REUSE_MAX - have : LE_BLOCK_SIZE;
+			if (want > end - off)
+				want = (size_t) (end - off);
+			if ((got = le_pread(stream, c + have, want, base + off)) <= 0)
+				goto fail;
+			have += (size_t) got;
+			off += (unsigned long long) got;
+		}
+
+		if (synced && (n >= LE_REUSE_MIN) && (start + n > from)) {
+			if ((*count == cap) && ((grow = realloc(chunks, 2 * cap * sizeof(reuse_chunk_t))) != NULL)) {
+				chunks = grow;
+				cap *= 2;
+			}
+			if (*count == cap)
+				goto fail;
+			chunks[*count].fp = xxh64(c, n, 0) | 1;
+			chunks[*count].start = start;
+			chunks[*count].len = (unsigned int) n;
+			chunks[*count].prior = chunks[*count].claimed = 0;
+			(*count)++;
+		}
+
+		/* keep the byte before the next chunk, the first of a pair */
+
+		memmove(win, c + n - 1, 1 + have - n);
+		have -= n;
+		start += n;
+		synced = TRUE;
+		skip = 0;
+	}
+	free(win);
+	return(chunks);
+
+fail:
+	free(win);
+	free(chunks);
+	return(NULL);
+}
+
+/*  reuse_claim  --  E: claim the pad data [from, to) of options->otp
+	(data offset 0 at stream offset base, end bytes long), refusing it
+	if any byte of it was used before.  */
+
+static int reuse_claim(options_t *options, unsigned long long base, unsigned long long end,
+	unsigned long long from, unsigned long long to, reuse_chunk_t **claim, size_t *count)
+{
+	reuse_chunk_t *c;
+	reuse_slot_t *e;
+	reuse_t r;
+	size_t i;
+
+	if ((*claim = reuse_scan(options->otp, base, end, from, to, count)) == NULL) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+		return(EXIT_FAILURE);
+	}
+	if (reuse_open(options, &r) != EXIT_SUCCESS) {
+		*count = 0;
+		return(EXIT_FAILURE);
+	}
+	for (i = 0; i < *count; i++) {
+		c = *claim + i;
+		if (((e = reuse_find(&r, c->fp)) != NULL) && (e->len == c->len) && (((from > c->start) ? from - c->start : 0) < e->used)) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_REUSE_HIT);
+			reuse_close(&r);
+			*count = 0;
+			return(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < *count; i++) {
+		c = *claim + i;
+		c->claimed = (unsigned int) (((to < c->start + c->len) ? to : c->start + c->len) - c->start);
+		if ((e = reuse_find(&r, c->fp)) != NULL) {
+			c->prior = e->used;
+			if (c->claimed > e->used)
+				e->used = c->claimed;
+			c->claimed = e->used;
+		} else
+			if (reuse_insert(options, &r, c->fp, c->len, c->claimed) == NULL) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_REUSE_OPEN);
+				reuse_close(&r);
+				*count = i;
+				return(EXIT_FAILURE);
+			}
+	}
+	reuse_close(&r);
+	return(EXIT_SUCCESS);
+}
+
+/*  reuse_settle  --  E: cut a claim back to the data used, [from, to).
+	Chunks whose mark has moved on since the claim are left alone.  */
+
+static int reuse_settle(options_t *options, reuse_chunk_t *claim, size_t count, unsigned long long to)
+{
+	reuse_chunk_t *c;
+	reuse_slot_t *e;
+	reuse_t r;
+	unsigned int used;
+	size_t i;
+
+	if (count == 0)
+		return(EXIT_SUCCESS);
+	if (reuse_open(options, &r) != EXIT_SUCCESS)
+		return(EXIT_FAILURE);
+	for (i = 0; i < count; i++) {
+		c = claim + i;
+		used = (to <= c->start) ? 0 : (unsigned int) (((to < c->start + c->len) ? to : c->start + c->len) - c->start);
+		if (((e = reuse_find(&r, c->fp)) != NULL) && (e->used == c->claimed))
+			e->used = (used > c->prior) ? used : c->prior;
+	}
+	reuse_close(&r);
+	return(EXIT_SUCCESS);
+}
+
+/*  reuse_record  --  G, and E making its pad: index the whole new pad
+	written to options->otp_fsp, as used when used is set.  Fails if any
+	of it was indexed already.  */
+
+static int reuse_record(options_t *options, int used)
+{
+	reuse_chunk_t *chunks;
+	le_stream_t *stream;
+	reuse_slot_t *e;
+	le_pad_t pad;
+	size_t count, i;
+	reuse_t r;
+	int rc = EXIT_SUCCESS;
+
+	if ((options->otp->fp != NULL) && (fflush(options->otp->fp) == EOF))
+		return(EXIT_FAILURE);
+	if (((stream = le_open_mmap(options->otp_fsp)) == NULL) || (le_pad_read(stream, &pad) < 0)
+		|| ((chunks = reuse_scan(stream, pad.hdrlen, pad.length, 0, pad.length, &count)) == NULL)) {
+		if (stream != NULL)
+			le_close(stream);
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+		return(EXIT_FAILURE);
+	}
+	le_close(stream);
+	if (reuse_open(options, &r) != EXIT_SUCCESS) {
+		free(chunks);
+		return(EXIT_FAILURE);
+	}
+	for (i = 0; i < count; i++)
+		if ((e = reuse_find(&r, chunks[i].fp)) != NULL) {
+			if (used && (e->used < chunks[i].len))
+				e->used = chunks[i].len;
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_REUSE_DUP);
+			rc = EXIT_FAILURE;
+		} else
+			if (reuse_insert(options, &r, chunks[i].fp, chunks[i].len, used ? chunks[i].len : 0) == NULL) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_REUSE_OPEN);
+				rc = EXIT_FAILURE;
+				break;
+			}
+	reuse_close(&r);
+	free(chunks);
+	return(rc);
+}
+
+/*  PD OTPs  --  G fitting a pad to existing ciphertext and other clear text.
+
+	Ciphertext made with a container pad starts with the ERC1 header
+	naming the pad ID and the data offset of its body.  The PD OTP is
+	then a container with the same ID whose data holds fresh RNG bytes
+	up to that offset, the body XOR the alternate clear text after it
+	and, with -f, fresh bytes for the rest of the body; it is marked
+	consumed to its end.  D with it finds the ID and offset it expects
+	and yields the alternate clear text, and the ID in the header no
+	longer singles out the real pad.  Headerless ciphertext gets a
+	legacy raw PD OTP as before; compressed, authenticated or chunked
+	ciphertext cannot be fitted.  */
+
+typedef struct {
+	unsigned char			*index;		/* NULL: raw PD OTP, written straight through */
+	unsigned char			*stage;		/* one data block gathered for its checksum */
+	size_t					fill;
+	unsigned long long		block;
+	pyx_t					*px;
+} pd_out_t;
+
+/*  pd_header  --  read the ciphertext header, if any, leaving the
+	encrypted stream at the body.  *hdrlen is 0 for plain ciphertext.  */
+
+static int pd_header(options_t *options, unsigned char *scratch, size_t *hdrlen, unsigned long long *offset)
+{
+	unsigned char hdr[LE_CT_BASE];
+	size_t len;
+
+	*hdrlen = 0;
+	if ((le_pread(options->encrypted, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr)) || (memcmp(hdr, LE_CT_MAGIC, 4) != 0))
+		return(EXIT_SUCCESS);
+	len = get16(hdr + 6);
+	if ((get16(hdr + 4) != LE_CT_PAD) || (len < LE_CT_PADHDR)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PD_PLAIN);
+		return(EXIT_FAILURE);
+	}
+	if (le_read(options->encrypted, scratch, len) != (ssize_t) len) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_ENC_SHORT);
+		return(EXIT_FAILURE);
+	}
+	*offset = get64(scratch + LE_CT_BASE + LE_PAD_ID);
+	*hdrlen = len;
+	return(EXIT_SUCCESS);
+}
+
+/*  pd_flush  --  write the gathered block and note its checksum.  */
+
+static int pd_flush(options_t *options, pd_out_t *po)
+{
+	if (po->fill == 0)
+		return(EXIT_SUCCESS);
+	if (le_write(options->otp, po->stage, po->fill) < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_PDOTP);
+		return(EXIT_FAILURE);
+	}
+	put64(po->index + 8 + 8 * po->block++, xxh64(po->stage, po->fill, 0));
+	pyx_ctx_add(po->px, po->stage, (int) po->fill);
+	po->fill = 0;
+	return(EXIT_SUCCESS);
+}
+
+/*  pd_put  --  write n bytes of PD OTP data, checksumming whole blocks
+	of a container as they fill.  */
+
+static int pd_put(options_t *options, pd_out_t *po, const unsigned char *buf, size_t n)
+{
+	size_t take;
+
+	if (po->index == NULL) {
+		if (le_write(options->otp, buf, n) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_PDOTP);
+			return(EXIT_FAILURE);
+		}
+		return(EXIT_SUCCESS);
+	}
+	while (n > 0) {
+		take = (n < LE_BLOCK_SIZE - po->fill) ? n : LE_BLOCK_SIZE - po->fill;
+		memcpy(po->stage + po->fill, buf, take);
+		po->fill += take;
+		buf += take;
+		n -= take;
+		if ((po->fill == LE_BLOCK_SIZE) && (pd_flush(options, po) != EXIT_SUCCESS))
+			return(EXIT_FAILURE);
+	}
+	return(EXIT_SUCCESS);
+}
+
+/* G -s<size BKMG> -pfsp || G -ifsp -efsp -pfsp -f */
+/* [G -s1M -pnew.otp] */
+/* [G -iclear.in -eexisting.enc -pnew.otp -f] */
+
+static int run_generate(options_t *options)
+{
+unsigned long long keep_count, want, block = 0, offset = 0;
+unsigned char *clear, *enc, *index = NULL;
+ssize_t n, m;
+long long enc_size, committed;
+size_t hdrlen;
+pd_out_t po;
+pyx_t px;
+int rc = EXIT_FAILURE, ckfd = -1;
+
+	keep_count=0;
+
+	if ((clear = alloc_blocks(options, 3)) == NULL)
+		return(EXIT_FAILURE);
+	enc = clear + LE_BLOCK_SIZE;
+	memset(&po, 0, sizeof(po));
+	po.stage = enc + LE_BLOCK_SIZE;
+	po.px = &px;
+
+	switch (options->cmd_mode) {
+		case CMD_STD:
+
+		keep_count = options->size;
+
+		if (options->resume) {
+			if ((committed = resume_begin(options, &px, &index, clear, &ckfd)) < 0)
+				goto done;
+			keep_count -= (unsigned long long) committed;
+			block = (unsigned long long) committed / LE_BLOCK_SIZE;
+		} else
+			if (!options->pad_raw && ((index = pad_begin(options, &px, NULL)) == NULL))
+				goto done;
+		tick_total(options, (long long) keep_count);
+
+		while (keep_count > 0) {
+			want = (keep_count < LE_BLOCK_SIZE) ? keep_count : LE_BLOCK_SIZE;
+			if (harvest(options, clear, (size_t) want) != EXIT_SUCCESS)
+				goto done;
+			if (le_write(options->otp, clear, (size_t) want) < 0) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_OTP);
+				goto done;
+			}
+			if (index != NULL) {
+				put64(index + 8 + 8 * block++, xxh64(clear, (size_t) want, 0));
+				pyx_ctx_add(&px, clear, (int) want);
+			}
+			if (tick(options, want) != EXIT_SUCCESS)
+				goto done;
+			keep_count -= want;
+			if ((ckfd >= 0) && (keep_count > 0) && ((options->size - keep_count) % LE_CKPT_STEP == 0)
+				&& (ckpt_store(options, ckfd, options->size - keep_count) != EXIT_SUCCESS))
+				goto done;
+		}
+
+		if ((index != NULL) && (pad_finish(options, index, &px) != EXIT_SUCCESS))
+			goto done;
+		if ((ckfd >= 0) && (resume_end(options) != EXIT_SUCCESS))
+			goto done;
+
+		break;
+
+		case CMD_ALT:
+
+		/* ciphertext naming its pad gets a container PD OTP of that ID */
+
+		if (pd_header(options, clear, &hdrlen, &offset) != EXIT_SUCCESS)
+			goto done;
+		if (hdrlen > 0) {
+			if ((enc_size = options->padout_pdotp ? le_size(options->encrypted) : le_size(options->input)) < 0) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_STAT);
+				goto done;
+			}
+			options->size = offset + (unsigned long long) enc_size - (options->padout_pdotp ? hdrlen : 0);
+			if ((index = po.index = pad_begin(options, &px, clear + LE_CT_BASE)) == NULL)
+				goto done;
+			options->pad.consumed = options->pad.length;
+			for (keep_count = 0; keep_count < offset; keep_count += want) {
+				want = (offset - keep_count < LE_BLOCK_SIZE) ? offset - keep_count : LE_BLOCK_SIZE;
+				if ((harvest(options, enc, (size_t) want) != EXIT_SUCCESS) || (pd_put(options, &po, enc, (size_t) want) != EXIT_SUCCESS))
+					goto done;
+			}
+			keep_count = 0;
+		}
+
+		tick_total(options, le_size(options->input));
+
+		while ((n = le_read(options->input, clear, LE_BLOCK_SIZE)) > 0) {
+			keep_count += (unsigned long long) n;
+			if ((m = le_read(options->encrypted, enc, (size_t) n)) > 0) {
+				xor_block(enc, clear, (size_t) m);
+				if (pd_put(options, &po, enc, (size_t) m) != EXIT_SUCCESS)
+					goto done;
+			}
+			if (m < n) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_ENC_SHORT);
+				goto done;
+			}
+			if (tick(options, (unsigned long long) n) != EXIT_SUCCESS)
+				goto done;
+		}
+
+		if (keep_count == 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_INPUT);
+			goto done;
+		} else
+			if(options->padout_pdotp) {
+				if ((enc_size = le_size(options->encrypted)) < 0) {
+					snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_STAT);
+					goto done;
+				}			
+				enc_size -= (long long) hdrlen;
+				while (keep_count < (unsigned long long) enc_size) {
+					want = (unsigned long long) enc_size - keep_count;
+					if (want > LE_BLOCK_SIZE)
+						want = LE_BLOCK_SIZE;
+					if (harvest(options, clear, (size_t) want) != EXIT_SUCCESS)
+						goto done;
+					if (pd_put(options, &po, clear, (size_t) want) != EXIT_SUCCESS)
+						goto done;
+					if (tick(options, want) != EXIT_SUCCESS)
+						goto done;
+					keep_count += want;
+				}
+			}
+		if ((po.index != NULL) && ((pd_flush(options, &po) != EXIT_SUCCESS) || (pad_finish(options, index, &px) != EXIT_SUCCESS)))
+			goto done;
+		break;
+	}
+	if ((options->reuse_fsp[0] != '\0') && (options->otp_fsp[0] != '\0') && (reuse_record(options, FALSE) != EXIT_SUCCESS))
+		goto done;
+	rc = EXIT_SUCCESS;
+
+done:
+	if (ckfd >= 0)
+		close(ckfd);
+	free(index);
+	le_buf_put(clear);
+	return(rc);
+}
+
+/*  Encrypt pipeline  --  E with a new pad from the RNG device.
+
+	E in CMD_ALT reads a block of input, harvests as many device bytes,
+	writes them to the new pad, XORs and writes the ciphertext; done in
+	turn, every block waits for the device, both disks and the input.
+	encrypt_pipe runs these as stages on their own threads instead: the
+	caller reads the input, a harvester fills the pad half of each
+	block, and a pad writer and a ciphertext writer (which XORs) follow
+	it, all over a ring of LE_PIPE_SLOTS blocks.  A stage takes block b
+	once the stage it follows is past it, and the reader reuses a slot
+	once both writers are done with it, so the slowest stage alone sets
+	the pace.  The harvester takes exactly the bytes read, so a short
+	input draws no more from a slow device than before.  Should a
+	thread not start, the stages run in turn on the caller.  */
+
+enum { LE_PIPE_READ, LE_PIPE_HARVEST, LE_PIPE_PADW, LE_PIPE_ENCW, LE_PIPE_STAGES };
+
+typedef struct {
+	options_t				*options;
+	unsigned char			*clear, *pad;	/* LE_PIPE_SLOTS blocks each */
+	size_t					len[LE_PIPE_SLOTS];
+	unsigned long long		done[LE_PIPE_STAGES];	/* blocks through each stage */
+	int						eof;		/* done[LE_PIPE_READ] is every block */
+	int						failed;		/* errmsg holds the first failure */
+	pthread_mutex_t			lock;
+	pthread_cond_t			moved;		/* a stage finished a block */
+} ct_pipe_t;
+
+typedef struct {
+	ct_pipe_t				*pipe;
+	int						stage;
+	options_t				opts;		/* private copy: stages report into its errmsg */
+} ct_stage_t;
+
+/*  pipe_fail  --  note a failure, msg NULL when errmsg is already set.
+	Only the first failure's message reaches options->errmsg.  */
+
+static void pipe_fail(ct_pipe_t *p, const char *msg)
+{
+	pthread_mutex_lock(&p->lock);
+	if (!p->failed) {
+		if (msg != NULL)
+			snprintf(p->options->errmsg, sizeof(p->options->errmsg), "%s", msg);
+		p->failed = TRUE;
+	}
+	pthread_cond_broadcast(&p->moved);
+	pthread_mutex_unlock(&p->lock);
+}
+
+/*  pipe_ready  --  wait until stage may take block b; FALSE when there
+	is no block b or the pipeline failed.  */
+
+static int pipe_ready(ct_pipe_t *p, int stage, unsigned long long b)
+{
+	unsigned long long behind;
+	int ready = FALSE;
+
+	pthread_mutex_lock(&p->lock);
+	while (!p->failed) {
+		if (stage == LE_PIPE_READ) {
+			behind = (p->done[LE_PIPE_PADW] < p->done[LE_PIPE_ENCW]) ? p->done[LE_PIPE_PADW] : p->done[LE_PIPE_ENCW];
+			if (b < behind + LE_PIPE_SLOTS) {
+				ready = TRUE;
+				break;
+			}
+		} else {
+			if (b < p->done[(stage == LE_PIPE_HARVEST) ? LE_PIPE_READ : LE_PIPE_HARVEST]) {
+				ready = TRUE;
+				break;
+			}
+			if (p->eof && (b >= p->done[LE_PIPE_READ]))
+				break;
+		}
+		pthread_cond_wait(&p->moved, &p->lock);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return(ready);
+}
+
+/*  pipe_step  --  stage's work on block b; FALSE once there is no more.  */
+
+static int pipe_step(ct_stage_t *st, unsigned long long b)
+{
+	ct_pipe_t *p = st->pipe;
+	options_t *options = &st->opts;
+	int stage = st->stage;
+	unsigned char *clear = p->clear + (b % LE_PIPE_SLOTS) * LE_BLOCK_SIZE;
+	unsigned char *pad = p->pad + (b % LE_PIPE_SLOTS) * LE_BLOCK_SIZE;
+	size_t *len = &p->len[b % LE_PIPE_SLOTS];
+	ssize_t n;
+
+	switch (stage) {
+		case LE_PIPE_READ:
+			if ((n = le_read(options->input, clear, LE_BLOCK_SIZE)) <= 0) {
+				if (n < 0) {
+					pipe_fail(p, ERR_READ_INPUT);
+					return(FALSE);
+				}
+				pthread_mutex_lock(&p->lock);
+				p->eof = TRUE;
+				pthread_cond_broadcast(&p->moved);
+				pthread_mutex_unlock(&p->lock);
+				return(FALSE);
+			}
+			*len = (size_t) n;
+			break;
+
+		case LE_PIPE_HARVEST:
+			if (harvest(options, pad, *len) != EXIT_SUCCESS) {
+				pipe_fail(p, options->errmsg);
+				return(FALSE);
+			}
+			break;
+
+		case LE_PIPE_PADW:
+			if (le_write(options->otp, pad, *len) < 0) {
+				pipe_fail(p, ERR_WRITE_OTP);
+				return(FALSE);
+			}
+			break;
+
+		default:
+			xor_block(clear, pad, *len);
+			if (le_write(options->output, clear, *len) < 0) {
+				pipe_fail(p, ERR_WRITE_ENC);
+				return(FALSE);
+			}
+			if (tick(options, (unsigned long long) *len) != EXIT_SUCCESS) {
+				pipe_fail(p, options->errmsg);
+				return(FALSE);
+			}
+			break;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->done[stage]++;
+	pthread_cond_broadcast(&p->moved);
+	pthread_mutex_unlock(&p->lock);
+	return(TRUE);
+}
+
+static void *pipe_main(void *arg)
+{
+	ct_stage_t *st = arg;
+	unsigned long long b;
+
+	for (b = 0; pipe_ready(st->pipe, st->stage, b) && pipe_step(st, b); b++)
+		;
+	return(NULL);
+}
+
+/*  encrypt_pipe  --  the whole of CMD_ALT E without a container body.  */
+
+static int encrypt_pipe(options_t *options)
+{
+	ct_pipe_t p;
+	ct_stage_t st[LE_PIPE_STAGES];
+	pthread_t tid[LE_PIPE_STAGES];
+	int started[LE_PIPE_STAGES];
+	unsigned long long b;
+	int i, threads = TRUE;
+
+	memset(&p, 0, sizeof(p));
+	p.options = options;
+	if ((p.clear = alloc_blocks(options, 2 * LE_PIPE_SLOTS)) == NULL)
+		return(EXIT_FAILURE);
+	p.pad = p.clear + LE_PIPE_SLOTS * LE_BLOCK_SIZE;
+	pthread_mutex_init(&p.lock, NULL);
+	pthread_cond_init(&p.moved, NULL);
+
+	for (i = LE_PIPE_READ; i < LE_PIPE_STAGES; i++) {
+		st[i].pipe = &p;
+		st[i].stage = i;
+		st[i].opts = *options;
+	}
+	for (i = LE_PIPE_HARVEST; i < LE_PIPE_STAGES; i++)
+		if (!(started[i] = (pthread_create(&tid[i], NULL, pipe_main, &st[i]) == 0)))
+			threads = FALSE;
+
+	if (threads)
+		pipe_main(&st[LE_PIPE_READ]);
+	else
+		pipe_fail(&p, NULL);		/* stops the stages that started */
+	for (i = LE_PIPE_HARVEST; i < LE_PIPE_STAGES; i++)
+		if (started[i])
+			pthread_join(tid[i], NULL);
+
+	/* no block has been taken when a thread failed to start */
+
+	if (!threads) {
+		p.failed = FALSE;
+		for (b = 0; !p.failed && pipe_step(&st[LE_PIPE_READ], b); b++)
+			for (i = LE_PIPE_HARVEST; i < LE_PIPE_STAGES; i++)
+				if (!pipe_step(&st[i], b))
+					break;
+	}
+	options->stats.bytes = st[LE_PIPE_ENCW].opts.stats.bytes;
+
+	pthread_cond_destroy(&p.moved);
+	pthread_mutex_destroy(&p.lock);
+	le_buf_put(p.clear);
+	return(p.failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* E -ifsp -pfsp -ofsp  || E -ifsp -pnewfsp -ofsp */
+/* [E -iclear.in -pexisting.otp -oencrypted.out] */
+/* [E -iclear.in -pnew.otp -oencrypted.out] */
+
+static int run_encrypt(options_t *options)
+{
+unsigned char *clear, *pad;
+unsigned char hdr[LE_CT_PADHDR];
+unsigned int flags;
+size_t hdrlen;
+ssize_t n, m;
+unsigned long long used = 0, base, end, to;
+reuse_chunk_t *claim = NULL;
+size_t nclaim = 0;
+long long need;
+int inp_fine = FALSE;
+int rc = EXIT_FAILURE;
+int hfd = -1;
+
+	if ((clear = alloc_blocks(options, LE_CT_BLOCKS)) == NULL)
+		return(EXIT_FAILURE);
+	pad = clear + LE_BLOCK_SIZE;
+
+	/* A container pad is used from its consumed offset, under lock */
+
+	memset(&options->pad, 0, sizeof(le_pad_t));
+	if ((options->cmd_mode == CMD_STD) && (pad_attach(options, TRUE) != EXIT_SUCCESS))
+		goto done;
+	if (options->pad.hdrlen && ((hfd = pad_lock(options)) < 0))
+		goto done;
+	used = options->otp->position;
+
+	/* With a reuse index, claim the pad bytes this E can use before any is */
+
+	if ((options->reuse_fsp[0] != '\0') && (options->cmd_mode == CMD_STD) && (le_size(options->otp) >= 0)) {
+		base = options->pad.hdrlen;
+		end = options->pad.hdrlen ? options->pad.length : (unsigned long long) le_size(options->otp);
+		to = end;
+		if ((need = le_size(options->input)) >= 0)
+			to = used - base + (unsigned long long) (need + need / 64) + LE_MAC_KEY + LE_BLOCK_SIZE;
+		if (reuse_claim(options, base, end, used - base, (to < end) ? to : end, &claim, &nclaim) != EXIT_SUCCESS)
+			goto done;
+	}
+
+	tick_total(options, le_size(options->input));
+
+	flags = (options->compress ? LE_CT_LZ : 0) | (options->auth ? LE_CT_AUTH : 0) | (options->pad.hdrlen ? LE_CT_PAD : 0)
+		| (options->chunk ? LE_CT_CHUNK : 0);
+	if ((flags & LE_CT_CHUNK) && (flags & LE_CT_AUTH)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_CHUNKAUTH);
+		goto done;
+	}
+	if (flags & (LE_CT_FRAMED | LE_CT_CHUNK)) {
+		rc = encrypt_container(options, clear, flags);
+		goto done;
+	}
+	if (flags && (ct_write_header(options, flags, hdr, &hdrlen) != EXIT_SUCCESS))
+		goto done;
+
+	switch (options->cmd_mode) {
+		case CMD_STD:
+
+		while ((n = le_read(options->input, clear, LE_BLOCK_SIZE)) > 0) {
+			inp_fine = TRUE;
+			if ((m = le_read(options->otp, pad, (size_t) n)) < 0) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+				goto done;
+			}
+			xor_block(clear, pad, (size_t) m);
+			if (le_write(options->output, clear, (size_t) m) < 0) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_ENC);
+				goto done;
+			}
+			if (m < n) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+				goto done;
+			}
+			if (tick(options, (unsigned long long) n) != EXIT_SUCCESS)
+				goto done;
+		}
+
+		if (inp_fine == FALSE) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_INPUT);
+			goto done;
+		}
+
+		break;
+
+		case CMD_ALT:
+
+		if (encrypt_pipe(options) != EXIT_SUCCESS)
+			goto done;
+
+		break;
+	}
+	rc = EXIT_SUCCESS;
+
+done:
+	if (hfd >= 0) {
+		options->pad.consumed = options->pad.length - options->otp->remain;
+		if ((pad_unlock(options, hfd) != EXIT_SUCCESS) && (rc == EXIT_SUCCESS)) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_UPDATE);
+			rc = EXIT_FAILURE;
+		}
+	}
+	if ((claim != NULL) && (reuse_settle(options, claim, nclaim, options->otp->position - options->pad.hdrlen) != EXIT_SUCCESS))
+		rc = EXIT_FAILURE;
+	free(claim);
+	if ((rc == EXIT_SUCCESS) && (options->cmd_mode == CMD_ALT) && (options->reuse_fsp[0] != '\0') && (options->otp_fsp[0] != '\0'))
+		rc = reuse_record(options, TRUE);
+	if ((rc == EXIT_SUCCESS) && options->wipe && (options->cmd_mode == CMD_STD) && (options->otp->position > used))
+		rc = wipe_used(options, used, options->otp->position);
+	le_buf_put(clear);
+	return(rc);
+}
+
+/* D -ifsp -pfsp -ofsp || D -ifsp -pfsp -ofsp -s<size BKMG> */
+/* [D -iencrypted.in -pexisting.otp -oclear.out] */ 
+/* [D -iencrypted.in -pexisting.otp -oclear.out -s1M] */ 
+
+static int run_decrypt(options_t *options)
+{
+unsigned char *enc, *pad;
+unsigned char hdr[LE_CT_BASE];
+ssize_t n, m, have;
+size_t want;
+unsigned int flags = 0;
+int inp_fine = FALSE;
+int rc = EXIT_FAILURE;
+unsigned long long keep_count, used = 0, upto = 0;
+long long sz;
+
+	keep_count=0;
+
+	if ((enc = alloc_blocks(options, LE_CT_BLOCKS)) == NULL)
+		return(EXIT_FAILURE);
+	pad = enc + LE_BLOCK_SIZE;
+
+	tick_total(options, (options->size > 0) ? (long long) options->size : le_size(options->input));
+
+	if (pad_attach(options, FALSE) != EXIT_SUCCESS)
+		goto done;
+
+	/* Containers announce themselves; anything else is plain XOR ciphertext */
+
+	if ((have = le_read(options->input, hdr, sizeof(hdr))) < 0)
+		have = 0;
+	if ((have == sizeof(hdr)) && (memcmp(hdr, LE_CT_MAGIC, 4) == 0)) {
+		if (ct_read_header(options, hdr, enc, &flags) != EXIT_SUCCESS)
+			goto done;
+		used = options->otp->position;
+		if (flags & LE_CT_CHUNK) {
+			rc = decrypt_chunked(options, flags, &used, &upto);
+			goto done;
+		}
+		if (flags & LE_CT_FRAMED) {
+			rc = decrypt_container(options, enc, hdr, flags);
+			goto done;
+		}
+		have = 0;
+	} else
+		used = options->otp->position;
+	if (options->chunk_no > 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CT_NOCHUNK);
+		goto done;
+	}
+	memcpy(enc, hdr, (size_t) have);
+
+	if(options->size>0) {
+		if ((sz = le_size(options->input)) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_STAT);
+			goto done;
+		}
+
+		if(options->size>(unsigned long long)sz) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_ENC_SIZE);
+			goto done;
+		}
+
+		if ((sz = le_size(options->otp)) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_STAT);
+			goto done;
+		}
+
+		if(options->size>(unsigned long long)sz) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SIZE);
+			goto done;
+		}
+	}
+
+	for (;;) {
+		want = LE_BLOCK_SIZE;
+		if ((options->size > 0) && (options->size - keep_count < want))
+			want = (size_t) (options->size - keep_count);
+		if (want == 0)
+			break;
+		n = ((size_t) have > want) ? (ssize_t) want : have;
+		have = 0;
+		if (((size_t) n < want) && ((m = le_read(options->input, enc + n, want - (size_t) n)) > 0))
+			n += m;
+		if (n <= 0)
+			break;
 		inp_fine = TRUE;
-		if ((otp_ch = fgetc(options->otp) ) != EOF) {
-			if ((fputc((enc_ch^otp_ch), options->output)) == EOF) {
-				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_DEC);
-				return(EXIT_FAILURE);
+		if ((m = le_read(options->otp, pad, (size_t) n)) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+			goto done;
+		}
+		xor_block(enc, pad, (size_t) m);
+		if (le_write(options->output, enc, (size_t) m) < 0) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_WRITE_DEC);
+			goto done;
+		}
+		keep_count += (unsigned long long) m;
+		if (m < n) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+			goto done;
+		}
+		if (tick(options, (unsigned long long) m) != EXIT_SUCCESS)
+			goto done;
+	}
+
+	if (inp_fine == FALSE) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_INPUT);
+		goto done;
+	}
+	rc = EXIT_SUCCESS;
+
+done:
+	if (!(flags & LE_CT_CHUNK))
+		upto = options->otp->position;
+	if ((rc == EXIT_SUCCESS) && options->wipe && (upto > used))
+		rc = wipe_used(options, used, upto);
+	le_buf_put(enc);
+	return(rc);
+}
+
+/* perform pyx trial on existing otp : entropy, chi square, mean */ 
+/* binary/byte mode and text stdout/terse fsp output */
+
+/*  pyx_row_t  --  the figures of one assessment.  */
+
+typedef struct {
+	char					*fsp;
+	int						status;		/* TRUE pass, FALSE fail, -1 error */
+	int						cached;		/* answered from the Pyx result cache */
+	long					totalc;
+	double					ent, chisq, mean, montepi, scc;
+	double					pairs, triples;	/* serial tests, -1 when not run */
+	double					acf;		/* largest autocorrelation coefficient */
+	int						lag;		/* its lag, 0 when not run */
+	double					lz;			/* percent LZ saved, -1 when not run */
+	long					lzsegs;		/* segments holding structure */
+} pyx_row_t;
+
+/*  pyx_judge  --  the Pyx pass/fail tests of a finished assessment;
+	TRUE when all pass.  chip receives the Chi-Square probability.  A
+	serial test, autocorrelation or LZ test not run passes.  */
+
+static int pyx_judge(options_t *options, const pyx_row_t *row, int result[10], double *chip)
+{
+	int binmode = options->pyx_binary;
+	double ent = row->ent, mean = row->mean, montepi = row->montepi, p;
+
+	*chip = pochisq(row->chisq, (binmode ? 1 : 255));
+
+	result[0] = (ent <= 7.5)?FALSE:TRUE;
+	result[1] = (((short) ((100 * ((binmode ? 1 : 8) - ent) / (binmode ? 1.0 : 8.0)))) > 1)?FALSE:TRUE;
+	result[2] = ((*chip * 100 <= 10) || (*chip * 100 >= 90))?FALSE:TRUE;
+	result[3] = (((binmode)&&(mean >= 4.5)&&(mean <= 5.5))||((!binmode)&&(mean <= 127)&&(mean >= 128)))?FALSE:TRUE;
+	result[4] = (((100.0 * (fabs(PI - montepi) / PI)) > 0.3)&&((100.0 * (fabs(PI - montepi) / PI)) > 0.01))?FALSE:TRUE;
+	result[5] = (row->scc >= 0.1)?FALSE:TRUE;
+	p = pochisq(row->pairs, LE_PYX_PAIRS_DF);
+	result[6] = ((row->pairs >= 0.0) && ((p <= 0.01) || (p >= 0.99)))?FALSE:TRUE;
+	p = pochisq(row->triples, LE_PYX_TRIPLES_DF);
+	result[7] = ((row->triples >= 0.0) && ((p <= 0.01) || (p >= 0.99)))?FALSE:TRUE;
+	if (row->lag > 0)
+		p = pyx_acf_p(row->acf, row->lag, options->pyx_lags, (unsigned long long) (binmode ? row->totalc / 8 : row->totalc));
+	result[8] = ((row->lag > 0) && ((p <= 0.01) || (p >= 0.99)))?FALSE:TRUE;
+	result[9] = ((row->lz >= 0.0) && (row->lzsegs > 0))?FALSE:TRUE;
+	return(result[0]&&result[1]&&result[2]&&result[3]&&result[4]&&result[5]&&result[6]&&result[7]&&result[8]&&result[9]);
+}
+
+/*  Pyx inventory  --  P over many pads at once.
+
+	With options->otp NULL, P takes options->otp_fsp as a set of pads:
+	"@file" lists one path per line, a directory stands for the regular
+	files in it and anything else is a glob(3) pattern.  Up to
+	LE_PYX_WORKERS threads (no more than the CPUs) take pads from a
+	shared cursor; each verifies a container against its index and
+	assesses the pad data with its own Pyx state into one row.  The
+	rows are written in list order to options->output (stdout when
+	NULL) in the terse CSV layout of P -o, with Result and Pad columns
+	added, then the pass/fail/error counts.  P fails when any pad fails
+	or cannot be assessed.  */
+
+typedef struct pyxc pyxc_t;		/* Pyx result cache, see pyxc_load */
+
+typedef struct {
+	options_t				*options;
+	pyxc_t					*cache;		/* NULL without options->pyx_cache_fsp */
+	pyx_row_t				*rows;
+	int						count;
+	int						next;		/* next row to assess, under lock */
+	int						stop;		/* cancelled */
+	pthread_mutex_t			lock;
+} pyx_inventory_t;
+
+static int pyx_name_cmp(const void *a, const void *b)
+{
+	return(strcmp(*(char * const *) a, *(char * const *) b));
+}
+
+static int pyx_list_add(char ***names, int *count, const char *name)
+{
+	char **grown;
+
+	if ((*count % 64) == 0) {
+		if ((grown = realloc(*names, (size_t) (*count + 64) * sizeof(char *))) == NULL)
+			return(EXIT_FAILURE);
+		*names = grown;
+	}
+	if (((*names)[*count] = strdup(name)) == NULL)
+		return(EXIT_FAILURE);
+	(*count)++;
+	return(EXIT_SUCCESS);
+}
+
+/*  pyx_list  --  expand spec into *count malloc'd paths, or NULL.  */
+
+static char **pyx_list(const char *spec, int *count)
+{
+	char **names = NULL, line[4 * MAX_FSP_PATH];
+	struct dirent *de;
+	struct stat sb;
+	size_t i;
+	glob_t g;
+	FILE *fp;
+	DIR *dir;
+	int rc = EXIT_SUCCESS;
+
+	*count = 0;
+	if (spec[0] == '@') {
+		if ((fp = fopen(spec + 1, "r")) == NULL)
+			return(NULL);
+		while ((rc == EXIT_SUCCESS) && (fgets(line, sizeof(line), fp) != NULL)) {
+			line[strcspn(line, "\r\n")] = '\0';
+			if (line[0] != '\0')
+				rc = pyx_list_add(&names, count, line);
+		}
+		fclose(fp);
+	} else
+		if ((stat(spec, &sb) == 0) && S_ISDIR(sb.st_mode)) {
+			if ((dir = opendir(spec)) == NULL)
+				return(NULL);
+			while ((rc == EXIT_SUCCESS) && ((de = readdir(dir)) != NULL)) {
+				snprintf(line, sizeof(line), (spec[strlen(spec) - 1] == '/') ? "%s%s" : "%s/%s", spec, de->d_name);
+				if ((de->d_name[0] != '.') && (stat(line, &sb) == 0) && S_ISREG(sb.st_mode))
+					rc = pyx_list_add(&names, count, line);
 			}
-			if (options->size >0)
-				if ((++keep_count)>=options->size)
-						break;
+			closedir(dir);
+			if (*count > 0)
+				qsort(names, (size_t) *count, sizeof(char *), pyx_name_cmp);
 		} else {
-			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_OTP_SHORT);
+			if (glob(spec, 0, NULL, &g) != 0)
+				return(NULL);
+			for (i = 0; (rc == EXIT_SUCCESS) && (i < g.gl_pathc); i++)
+				rc = pyx_list_add(&names, count, g.gl_pathv[i]);
+			globfree(&g);
+		}
+	if ((rc != EXIT_SUCCESS) || (*count == 0)) {
+		while (*count > 0)
+			free(names[--(*count)]);
+		free(names);
+		return(NULL);
+	}
+	return(names);
+}
+
+/*  Pyx result cache  --  P answers for pads it has already assessed.
+
+	Tools that run P over the same pads again and again pay for a full
+	read of every pad each time.  With options->pyx_cache_fsp set (er -y
+	file, or the ER_PYX_CACHE environment variable) P looks each pad up
+	in a small results file first and reports the stored figures without
+	reading the pad when it is unchanged; otherwise it assesses the pad
+	and stores the result.  A pad is unchanged when its device, inode,
+	size and modification time (to the nanosecond) match, and so does an
+	XXH64 fingerprint of LE_PYXC_SAMPLES 4K samples spread evenly over
+	the file, first and last included, so a pad rewritten with its
+	times put back is assessed again.  E, W and C rewrite a container's
+	header, so their pads are assessed afresh.  Byte and bit mode
+	results are kept apart, as are those of different serial and LZ
+	tests.  A hit skips a container's index check as well, as the file
+	is unchanged since it last passed; the report says the blocks were
+	verified (cached).
+
+	The file is LE_PYXC_MAGIC, a record count and LE_PYXC_REC byte
+	records: device, inode, size, mtime, fingerprint and mode (the
+	LE_PYXC_KEY bytes compared), then the sample count, the five Pyx
+	figures, the two serial test statistics, the autocorrelation and
+	its lag, the LZ saving and structured segments and the time the
+	record was stored.  It is read whole under a shared flock and
+	rewritten under an exclusive one, merged with what other processes
+	stored meanwhile; the oldest records go once LE_PYXC_MAX are held.
+	A damaged file is treated as empty.  */
+
+struct pyxc {
+	unsigned char			*recs;		/* records loaded */
+	size_t					count;
+	unsigned char			*fresh;		/* records stored by this P */
+	size_t					nfresh;
+};
+
+/*  pyxc_key  --  the key of the pad open on fd, in LE_PYXC_KEY bytes.  */
+
+static int pyxc_key(int fd, options_t *options, unsigned char *key)
+{
+	unsigned char sample[4096];
+	unsigned long long fp = 0, off, span;
+	struct stat st;
+	ssize_t n;
+	int i;
+
+	if ((fd < 0) || (fstat(fd, &st) == -1) || !S_ISREG(st.st_mode))
+		return(EXIT_FAILURE);
+	span = ((unsigned long long) st.st_size > sizeof(sample)) ? (unsigned long long) st.st_size - sizeof(sample) : 0;
+	for (i = 0; i < LE_PYXC_SAMPLES; i++) {
+		off = span * (unsigned long long) i / (LE_PYXC_SAMPLES - 1);
+		if ((n = pread(fd, sample, sizeof(sample), (off_t) off)) < 0)
+			return(EXIT_FAILURE);
+		fp = xxh64(sample, (size_t) n, fp ^ off);
+	}
+	put64(key, (unsigned long long) st.st_dev);
+	put64(key + 8, (unsigned long long) st.st_ino);
+	put64(key + 16, (unsigned long long) st.st_size);
+	put64(key + 24, (unsigned long long) st.st_mtim.tv_sec * 1000000000ULL + (unsigned long long) st.st_mtim.tv_nsec);
+	put64(key + 32, fp);
+	put64(key + 40, (options->pyx_binary ? 1 : 0) | (options->pyx_triples ? 2 : 0) | (options->pyx_lz ? 4 : 0)
+		| ((unsigned long long) options->pyx_lags << 32));
+	return(EXIT_SUCCESS);
+}
+
+/*  pyxc_read  --  load the records of an open cache file; a new or
+	damaged file reads as empty.  */
+
+static int pyxc_read(int fd, unsigned char **recs, size_t *count)
+{
+	unsigned char hdr[LE_PYXC_HDR];
+	struct stat st;
+	size_t n;
+
+	*recs = NULL;
+	*count = 0;
+	if (fstat(fd, &st) == -1)
+		return(EXIT_FAILURE);
+	if ((pread(fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr)) || (memcmp(hdr, LE_PYXC_MAGIC, 4) != 0)
+		|| ((n = get32(hdr + 4)) > LE_PYXC_MAX)
+		|| ((unsigned long long) st.st_size != LE_PYXC_HDR + (unsigned long long) n * LE_PYXC_REC))
+		return(EXIT_SUCCESS);
+	if ((*recs = malloc(n * LE_PYXC_REC + 1)) == NULL)
+		return(EXIT_FAILURE);
+	if (pread(fd, *recs, n * LE_PYXC_REC, LE_PYXC_HDR) != (ssize_t) (n * LE_PYXC_REC)) {
+		free(*recs);
+		*recs = NULL;
+		return(EXIT_SUCCESS);
+	}
+	*count = n;
+	return(EXIT_SUCCESS);
+}
+
+static unsigned char *pyxc_lookup(unsigned char *recs, size_t count, const unsigned char *key)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		if (memcmp(recs + i * LE_PYXC_REC, key, LE_PYXC_KEY) == 0)
+			return(recs + i * LE_PYXC_REC);
+	return(NULL);
+}
+
+/*  pyxc_load  --  read the cache named by options->pyx_cache_fsp.  */
+
+static int pyxc_load(options_t *options, pyxc_t *c)
+{
+	int fd, rc = EXIT_FAILURE;
+
+	memset(c, 0, sizeof(pyxc_t));
+	if ((fd = open(options->pyx_cache_fsp, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) >= 0) {
+		if (flock(fd, LOCK_SH) == 0)
+			rc = pyxc_read(fd, &c->recs, &c->count);
+		close(fd);
+	}
+	if (rc != EXIT_SUCCESS)
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PYXC_OPEN);
+	return(rc);
+}
+
+/*  pyxc_find  --  fill row from the cache when the pad is unchanged.
+	Read only, so the inventory workers may call it concurrently.  */
+
+static int pyxc_find(const pyxc_t *c, const unsigned char *key, pyx_row_t *row)
+{
+	unsigned char *rec;
+
+	if ((rec = pyxc_lookup(c->recs, c->count, key)) == NULL)
+		return(FALSE);
+	row->totalc = (long) get64(rec + 48);
+	row->ent = setd(get64(rec + 56));
+	row->chisq = setd(get64(rec + 64));
+	row->mean = setd(get64(rec + 72));
+	row->montepi = setd(get64(rec + 80));
+	row->scc = setd(get64(rec + 88));
+	row->pairs = setd(get64(rec + 96));
+	row->triples = setd(get64(rec + 104));
+	row->acf = setd(get64(rec + 112));
+	row->lag = (int) get64(rec + 120);
+	row->lz = setd(get64(rec + 128));
+	row->lzsegs = (long) get64(rec + 136);
+	row->cached = TRUE;
+	return(TRUE);
+}
+
+/*  pyxc_put  --  note the result of an assessed pad for pyxc_save.  */
+
+static void pyxc_put(pyxc_t *c, const unsigned char *key, const pyx_row_t *row)
+{
+	unsigned char *rec, *grown;
+
+	if ((grown = realloc(c->fresh, (c->nfresh + 1) * LE_PYXC_REC)) == NULL)
+		return;
+	c->fresh = grown;
+	rec = c->fresh + c->nfresh++ * LE_PYXC_REC;
+	memcpy(rec, key, LE_PYXC_KEY);
+	put64(rec + 48, (unsigned long long) row->totalc);
+	put64(rec + 56, getd(row->ent));
+	put64(rec + 64, getd(row->chisq));
+	put64(rec + 72, getd(row->mean));
+	put64(rec + 80, getd(row->montepi));
+	put64(rec + 88, getd(row->scc));
+	put64(rec + 96, getd(row->pairs));
+	put64(rec + 104, getd(row->triples));
+	put64(rec + 112, getd(row->acf));
+	put64(rec + 120, (unsigned long long) row->lag);
+	put64(rec + 128, getd(row->lz));
+	put64(rec + 136, (unsigned long long) row->lzsegs);
+	put64(rec + 144, (unsigned long long) time(NULL));
+}
+
+/*  pyxc_save  --  merge this P's results into the cache file and
+	release the cache.  */
+
+static int pyxc_save(options_t *options, pyxc_t *c)
+{
+	unsigned char hdr[LE_PYXC_HDR], *recs = NULL, *rec, *grown;
+	size_t count = 0, i, k, old;
+	int fd = -1, rc = EXIT_FAILURE;
+
+	if (c->nfresh == 0) {
+		rc = EXIT_SUCCESS;
+		goto done;
+	}
+	if (((fd = open(options->pyx_cache_fsp, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0) || (flock(fd, LOCK_EX) == -1)
+		|| (pyxc_read(fd, &recs, &count) != EXIT_SUCCESS))
+		goto done;
+	for (i = 0; i < c->nfresh; i++) {
+		if ((rec = pyxc_lookup(recs, count, c->fresh + i * LE_PYXC_REC)) == NULL) {
+			if (count == LE_PYXC_MAX) {
+				for (old = 0, k = 1; k < count; k++)
+					if (get64(recs + k * LE_PYXC_REC + 144) < get64(recs + old * LE_PYXC_REC + 144))
+						old = k;
+				rec = recs + old * LE_PYXC_REC;
+			} else {
+				if ((grown = realloc(recs, (count + 1) * LE_PYXC_REC)) == NULL)
+					goto done;
+				recs = grown;
+				rec = recs + count++ * LE_PYXC_REC;
+			}
+		}
+		memcpy(rec, c->fresh + i * LE_PYXC_REC, LE_PYXC_REC);
+	}
+	memcpy(hdr, LE_PYXC_MAGIC, 4);
+	put32(hdr + 4, (unsigned int) count);
+	if ((ftruncate(fd, 0) == -1) || (pwrite(fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr))
+		|| (pwrite(fd, recs, count * LE_PYXC_REC, LE_PYXC_HDR) != (ssize_t) (count * LE_PYXC_REC)))
+		goto done;
+	rc = EXIT_SUCCESS;
+
+done:
+	if ((fd >= 0) && (close(fd) == -1))
+		rc = EXIT_FAILURE;
+	if (rc != EXIT_SUCCESS)
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PYXC_OPEN);
+	free(recs);
+	free(c->recs);
+	free(c->fresh);
+	memset(c, 0, sizeof(pyxc_t));
+	return(rc);
+}
+
+/*  pyx_pad  --  assess one pad into row, checking a container against
+	its index first, unless the Pyx result cache has it.  Returns the
+	pad data bytes read.  */
+
+static unsigned long long pyx_pad(pyx_inventory_t *inv, pyx_row_t *row, unsigned char *block)
+{
+	unsigned long long bad, total = 0;
+	unsigned char key[LE_PYXC_KEY];
+	le_stream_t *stream;
+	le_pad_t pad;
+	pyx_t px;
+	pyx_lz_t lz;
+	int result[10];
+	double chip;
+	ssize_t n;
+	int rc, keyed, binmode = inv->options->pyx_binary;
+
+	row->status = -1;
+	if ((stream = le_open_mmap(row->fsp)) == NULL)
+		return(0);
+	io_policy(stream, inv->options->io_policy);
+	keyed = (inv->cache != NULL) && (pyxc_key(stream->fd, inv->options, key) == EXIT_SUCCESS);
+	if (keyed && pyxc_find(inv->cache, key, row)) {
+		le_close(stream);
+		row->status = pyx_judge(inv->options, row, result, &chip);
+		return(0);
+	}
+	if (((rc = le_pad_read(stream, &pad)) < 0)
+		|| ((rc == TRUE) && ((le_pad_verify(stream, &pad, 1, &bad) != EXIT_SUCCESS) || (le_pad_seek(stream, &pad, 0) != EXIT_SUCCESS)))) {
+		le_close(stream);
+		return(0);
+	}
+
+	/* the pads are already spread over the workers, so LZ runs inline */
+
+	pyx_ctx_init(&px, binmode);
+	memset(&lz, 0, sizeof(lz));
+	if ((inv->options->pyx_triples && (pyx_ctx_triples(&px) != EXIT_SUCCESS))
+		|| ((inv->options->pyx_lags > 0) && (pyx_ctx_lags(&px, inv->options->pyx_lags) != EXIT_SUCCESS))
+		|| (inv->options->pyx_lz && (pyx_lz_init(&lz, 0) != EXIT_SUCCESS))) {
+		pyx_ctx_free(&px);
+		le_close(stream);
+		return(0);
+	}
+	while ((n = le_read(stream, block, LE_BLOCK_SIZE)) > 0) {
+		pyx_ctx_add(&px, block, (int) n);
+		if (lz.seg != NULL)
+			pyx_lz_add(&lz, block, (size_t) n);
+		total += (unsigned long long) n;
+	}
+	le_close(stream);
+	if ((n < 0) || (total == 0)) {
+		pyx_ctx_free(&px);
+		pyx_lz_free(&lz);
+		return(total);
+	}
+
+	pyx_ctx_end(&px, &row->ent, &row->chisq, &row->mean, &row->montepi, &row->scc);
+	pyx_ctx_ngram(&px, &row->pairs, &row->triples);
+	if (px.awin != NULL)
+		pyx_ctx_acf(&px, &row->acf, &row->lag);
+	pyx_ctx_free(&px);
+	row->lz = -1.0;
+	if (lz.seg != NULL)
+		pyx_lz_end(&lz, &row->lz, &row->lzsegs);
+	row->totalc = (long) (binmode ? 8 * total : total);
+	row->status = pyx_judge(inv->options, row, result, &chip);
+	if (keyed) {
+		pthread_mutex_lock(&inv->lock);
+		pyxc_put(inv->cache, key, row);
+		pthread_mutex_unlock(&inv->lock);
+	}
+	return(total);
+}
+
+static void *pyx_worker(void *arg)
+{
+	pyx_inventory_t *inv = arg;
+	unsigned long long bytes;
+	unsigned char *block;
+	int i;
+
+	if ((block = le_buf_get(LE_BLOCK_SIZE)) == NULL)
+		return(NULL);
+	for (;;) {
+		pthread_mutex_lock(&inv->lock);
+		i = inv->stop ? inv->count : inv->next++;
+		pthread_mutex_unlock(&inv->lock);
+		if (i >= inv->count)
+			break;
+
+		bytes = pyx_pad(inv, &inv->rows[i], block);
+
+		pthread_mutex_lock(&inv->lock);
+		if (inv->rows[i].cached)
+			inv->options->stats.cached++;
+		if (tick(inv->options, bytes) != EXIT_SUCCESS)
+			inv->stop = TRUE;
+		pthread_mutex_unlock(&inv->lock);
+	}
+	le_buf_put(block);
+	return(NULL);
+}
+
+static int run_pyx_many(options_t *options)
+{
+	pyx_inventory_t inv;
+	pyxc_t cache;
+	pthread_t tid[LE_PYX_WORKERS];
+	int started[LE_PYX_WORKERS];
+	int threads, i, passed = 0, failed = 0, errors = 0, rc = EXIT_FAILURE;
+	le_stream_t *out = options->output;
+	pyx_row_t *row;
+	char **names;
+	long cpus;
+
+	memset(&inv, 0, sizeof(inv));
+	if ((names = pyx_list(options->otp_fsp, &inv.count)) == NULL) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PYX_LIST);
+		return(EXIT_FAILURE);
+	}
+	if ((inv.rows = calloc((size_t) inv.count, sizeof(pyx_row_t))) == NULL) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		goto done;
+	}
+	for (i = 0; i < inv.count; i++) {
+		inv.rows[i].fsp = names[i];
+		inv.rows[i].status = -1;		/* ERROR until a worker assesses it */
+	}
+	inv.options = options;
+	if (options->pyx_cache_fsp[0] != '\0') {
+		if (pyxc_load(options, &cache) != EXIT_SUCCESS)
+			goto done;
+		inv.cache = &cache;
+	}
+	pthread_mutex_init(&inv.lock, NULL);
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	threads = (cpus < 1) ? 1 : ((cpus > LE_PYX_WORKERS) ? LE_PYX_WORKERS : (int) cpus);
+	if (threads > inv.count)
+		threads = inv.count;
+
+	/* the caller is worker 0 and sweeps up if no thread could start */
+
+	for (i = 1; i < threads; i++)
+		started[i] = (pthread_create(&tid[i], NULL, pyx_worker, &inv) == 0);
+	pyx_worker(&inv);
+	for (i = 1; i < threads; i++)
+		if (started[i])
+			pthread_join(tid[i], NULL);
+	pthread_mutex_destroy(&inv.lock);
+	if ((inv.cache != NULL) && (pyxc_save(options, inv.cache) != EXIT_SUCCESS))
+		goto done;
+	if (inv.stop)
+		goto done;
+
+	if ((out == NULL) && ((out = le_open_stdio(stdout, FALSE)) == NULL)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		goto done;
+	}
+	le_printf(out, "0,File-%ss,Entropy,Chi-square,Mean,Monte-Carlo-Pi,Serial-Correlation%s%s,Result,Pad\n",
+		options->pyx_binary ? "bit" : "byte", (options->pyx_lags > 0) ? PYX_ACF_COLUMNS : "", options->pyx_lz ? PYX_LZ_COLUMNS : "");
+	for (i = 0; i < inv.count; i++) {
+		row = &inv.rows[i];
+		le_printf(out, "1,%ld,%f,%f,%f,%f,%f", row->totalc, row->ent, row->chisq, row->mean, row->montepi, row->scc);
+		if (options->pyx_lags > 0)
+			le_printf(out, ",%f,%d", row->acf, row->lag);
+		if (options->pyx_lz)
+			le_printf(out, ",%f,%ld", row->lz, row->lzsegs);
+		le_printf(out, ",%s,%s\n", (row->status == TRUE) ? PASS : ((row->status == FALSE) ? FAIL : "ERROR"), row->fsp);
+		if (row->status == TRUE)
+			passed++;
+		else
+			if (row->status == FALSE)
+				failed++;
+			else
+				errors++;
+	}
+	le_printf(out, "0,Pads,Passed,Failed,Errors\n");
+	le_printf(out, "2,%d,%d,%d,%d\n", inv.count, passed, failed, errors);
+	if (out != options->output)
+		le_close(out);
+
+	if ((failed + errors) > 0)
+		snprintf(options->errmsg, sizeof(options->errmsg), ERR_PYX_FAILED, failed + errors, inv.count);
+	else
+		rc = EXIT_SUCCESS;
+
+done:
+	for (i = 0; i < inv.count; i++)
+		free(names[i]);
+	free(names);
+	free(inv.rows);
+	return(rc);
+}
+
+/* P -pfsp -b || P -pfsp -ofsp -b */
+/* [P -pexisting.otp] [-b] */
+/* [P -pexisting.otp -oterse.rpt] [-b] */
+/* [P -p/pads/ -oinventory.csv] [P -p@pads.lst] [P -p'pads/a*.otp'] */
+
+/*  pyx_assess  --  P of the single pad options->otp into row.  */
+
+static int pyx_assess(options_t *options, pyx_row_t *row)
+{
+	unsigned long long bad;
+	unsigned char *block;
+	pyx_t px;
+	pyx_lz_t lz;
+	ssize_t n;
+	long cpus;
+	int rc = EXIT_FAILURE;
+
+	/* A container pad is checked against its index before assessment */
+
+	if (options->pad.hdrlen
+		&& (le_pad_verify(options->otp, &options->pad, (int) sysconf(_SC_NPROCESSORS_ONLN), &bad) != EXIT_SUCCESS)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), ERR_PAD_BLOCK, bad);
+		return(EXIT_FAILURE);
+	}
+
+	if ((block = alloc_blocks(options, 1)) == NULL)
+		return(EXIT_FAILURE);
+
+	/* Initialise for calculations */
+
+	pyx_ctx_init(&px, options->pyx_binary);
+	memset(&lz, 0, sizeof(lz));
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if ((options->pyx_triples && (pyx_ctx_triples(&px) != EXIT_SUCCESS))
+		|| ((options->pyx_lags > 0) && (pyx_ctx_lags(&px, options->pyx_lags) != EXIT_SUCCESS))
+		|| (options->pyx_lz && (pyx_lz_init(&lz, (cpus < 1) ? 1 : (int) cpus) != EXIT_SUCCESS))) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		goto done;
+	}
+	tick_total(options, le_size(options->otp));
+
+	/* Scan input file and count character occurrences */
+
+	while ((n = le_read(options->otp, block, LE_BLOCK_SIZE)) > 0) {
+		row->totalc += options->pyx_binary ? 8 * n : n;
+		pyx_ctx_add(&px, block, (int) n);
+		if (lz.seg != NULL)
+			pyx_lz_add(&lz, block, (size_t) n);
+		if (tick(options, (unsigned long long) n) != EXIT_SUCCESS)
+			goto done;
+	}
+
+	if (n < 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_OTP);
+		goto done;
+	}
+
+	/* Complete calculation and return sequence metrics */
+
+	pyx_ctx_end(&px, &row->ent, &row->chisq, &row->mean, &row->montepi, &row->scc);
+	pyx_ctx_ngram(&px, &row->pairs, &row->triples);
+	if (px.awin != NULL)
+		pyx_ctx_acf(&px, &row->acf, &row->lag);
+	row->lz = -1.0;
+	if (lz.seg != NULL)
+		pyx_lz_end(&lz, &row->lz, &row->lzsegs);
+	rc = EXIT_SUCCESS;
+
+done:
+	pyx_ctx_free(&px);
+	pyx_lz_free(&lz);
+	le_buf_put(block);
+	return(rc);
+}
+
+/*  pyx_chance  --  print how often chance would exceed a statistic.  */
+
+static void pyx_chance(double p)
+{
+	if (p < 0.0001)
+		printf("Value would be exceeded randomly less than 0.01 percent of the times.\n");
+	else 
+		if (p > 0.9999)
+			printf("Value would be exceeded randomly more than than 99.99 percent of the times.\n");
+		else {
+			printf("Value would be exceeded randomly %1.2f percent of the times.\n", p * 100);
+		}
+}
+
+/*  pyx_serial  --  print one serial test of the P report.  */
+
+static void pyx_serial(const char *what, double stat, int df, unsigned long long needed)
+{
+	if (stat < 0.0) {
+		printf("Byte %s : not tested, fewer than %llu bytes\n", what, needed);
+		return;
+	}
+	printf("Byte %s : serial chi-square is %1.2f for %d degrees of freedom\n", what, stat, df);
+	pyx_chance(pochisq(stat, df));
+}
+
+static int run_pyx(options_t *options)
+{
+	int result[10];
+	long totalc;	      /* Total character count */
+	char *samp;
+	double montepi, chip, scc, ent, mean, chisq;
+	unsigned char key[LE_PYXC_KEY];
+	pyx_row_t row;
+	pyxc_t cache;
+	int keyed, rc;
+
+	if (options->otp == NULL)
+		return(run_pyx_many(options));
+
+	samp = options->pyx_binary ? "bit" : "byte";
+	memset(result, FALSE, sizeof result);
+	memset(&row, 0, sizeof(row));
+
+	if (pad_attach(options, FALSE) != EXIT_SUCCESS)
+		return(EXIT_FAILURE);
+
+	/* An unchanged pad is answered from the Pyx result cache */
+
+	keyed = (options->pyx_cache_fsp[0] != '\0') && (pyxc_key(options->otp->fd, options, key) == EXIT_SUCCESS);
+	if (keyed && (pyxc_load(options, &cache) != EXIT_SUCCESS))
+		return(EXIT_FAILURE);
+	if (keyed && pyxc_find(&cache, key, &row)) {
+		options->stats.cached++;
+		rc = EXIT_SUCCESS;
+	} else
+		if (((rc = pyx_assess(options, &row)) == EXIT_SUCCESS) && keyed)
+			pyxc_put(&cache, key, &row);
+	if (keyed && (pyxc_save(options, &cache) != EXIT_SUCCESS))
+		rc = EXIT_FAILURE;
+	if (rc != EXIT_SUCCESS)
+		return(rc);
+	totalc = row.totalc;
+	ent = row.ent;
+	chisq = row.chisq;
+	mean = row.mean;
+	montepi = row.montepi;
+	scc = row.scc;
+
+	if (options->cmd_mode==CMD_ALT) {
+		le_printf(options->output, "0,File-%ss,Entropy,Chi-square,Mean,Monte-Carlo-Pi,Serial-Correlation%s%s\n", options->pyx_binary ? "bit" : "byte",
+			(options->pyx_lags > 0) ? PYX_ACF_COLUMNS : "", options->pyx_lz ? PYX_LZ_COLUMNS : "");
+		le_printf(options->output, "1,%ld,%f,%f,%f,%f,%f", totalc, ent, chisq, mean, montepi, scc);
+		if (options->pyx_lags > 0)
+			le_printf(options->output, ",%f,%d", row.acf, row.lag);
+		if (options->pyx_lz)
+			le_printf(options->output, ",%f,%ld", row.lz, row.lzsegs);
+		le_printf(options->output, "\n");
+	}
+
+	/* Print calculated results */
+
+	if (options->cmd_mode!=CMD_ALT) {
+	/* Calculate probability of observed distribution occurring from
+	   the results of the Chi-Square test */
+
+		pyx_judge(options, &row, result, &chip);
+
+		printf("Pyx Trial Assessment\n");
+		printf("OVERALL		: %s && %s && %s && %s && %s && %s = %s\n\n", (result[0]&&result[1]&&result[9])?PASS:FAIL, result[2]?PASS:FAIL, result[3]?PASS:FAIL, result[4]?PASS:FAIL, result[5]?PASS:FAIL, (result[6]&&result[7]&&result[8])?PASS:FAIL, (result[0]&&result[1]&&result[2]&&result[3]&&result[4]&&result[5]&&result[6]&&result[7]&&result[8]&&result[9])?PASS:FAIL);
+		printf("One Time Pad Density\n");
+		printf("Entropy : %f bits per %s.\n", ent, samp);
+		printf("Optimum compression of OTP file size %ld %ss by %d percent\n", totalc, samp, (short) ((100 * ((options->pyx_binary ? 1 : 8) - ent) / (options->pyx_binary ? 1.0 : 8.0))));
+		printf("\t[GOOD 		= Entropy close to 8 bits, compression 0 percent]\n");
+		if (row.lz >= 0.0) {
+			printf("LZ compression of OTP in %llu segments of %dK by %1.2f percent, %ld holding repeats\n",
+				((unsigned long long) (options->pyx_binary ? totalc / 8 : totalc) + LE_PYX_LZ_SEG - 1) / LE_PYX_LZ_SEG,
+				LE_PYX_LZ_SEG / 1024, row.lz, row.lzsegs);
+			printf("\t[GOOD 		= no segment holding repeats, compression 0 percent]\n");
+		}
+		printf("\n");
+		printf("One Time Pad Distribution\n");
+		printf("Chi Square : for %ld samples is %1.2f\n", totalc, chisq);
+		pyx_chance(chip);
+		printf("\t[GOOD 		= 10 percent to 90 percent]\n");
+		printf("\t[SUSPECT 	= 5 to 10 percent or 90 to 95 percent]\n");
+		printf("\t[WORSE		= 1 to 5 percent or 95 to 99 percent]\n");
+		printf("\t[WORST		= 0 to 1 percent or 99 to 100 percent]\n");
+				
+		printf("Arithmetic mean of data %ss is %1.4f\n", samp, mean);
+		printf("\t[RANDOM 	= %.1f]\n", options->pyx_binary ? 0.5 : 127.5);
+
+		printf("Monte Carlo value for Pi is %1.9f (error %1.2f percent)\n", montepi, 100.0 * (fabs(PI - montepi) / PI));
+		printf("\t[RANDOM		= error 0.06 percent]\n");
+
+		printf("Serial correlation coefficient is ");
+
+		if (scc >= -99999)
+			printf("%1.6f\n", scc);
+		else
+			printf("undefined (all values are equal)\n");
+		printf("\t[RANDOM		= 0.0]\n");
+		printf("\t[PREDICTED	= 1.0]\n\n");
+
+		printf("One Time Pad Sequence\n");
+		pyx_serial("pairs", row.pairs, LE_PYX_PAIRS_DF, LE_PYX_NGRAM_MIN * 65536ULL);
+		if (options->pyx_triples)
+			pyx_serial("triples", row.triples, LE_PYX_TRIPLES_DF, LE_PYX_NGRAM_MIN * 16777216ULL);
+		if ((options->pyx_lags > 0) && (row.lag == 0))
+			printf("Autocorrelation : not tested, fewer than %d bytes or all equal\n", 2 * options->pyx_lags);
+		if (row.lag > 0) {
+			printf("Autocorrelation : largest of lags 1 to %d is %1.6f at lag %d\n", options->pyx_lags, row.acf, row.lag);
+			pyx_chance(pyx_acf_p(row.acf, row.lag, options->pyx_lags,
+				(unsigned long long) (options->pyx_binary ? totalc / 8 : totalc)));
+		}
+		printf("\t[GOOD		= 1 percent to 99 percent]\n");
+
+		if (options->pad.hdrlen) {
+			printf("\nOne Time Pad Container\n");
+			printf("%llu bytes, %llu consumed, %llu blocks verified%s\n", options->pad.length, options->pad.consumed,
+				(options->pad.length + options->pad.block_size - 1) / options->pad.block_size, row.cached ? " (cached)" : "");
+		}
+	}
+	return(EXIT_SUCCESS);
+}
+
+/* W -pfsp || W -pfsp -s<size BKMG> */
+/* [W -pused.otp] */
+/* [W -plegacy.otp -s1M] */
+
+static int run_wipe(options_t *options)
+{
+	if (wipe_used(options, 0, 0) != EXIT_SUCCESS)
+		return(EXIT_FAILURE);
+	options->stats.bytes = options->stats.wiped;
+	return(EXIT_SUCCESS);
+}
+
+/*  Carve  --  split a pad into segments, or join segments into a pad.
+
+	C takes the unused data of a pad (from its consumed offset) and
+	writes it out as options->segments segments, or as segments of
+	options->size bytes, named <output>.000 on; given a comma separated
+	list of pads it joins their unused data into the one pad output.
+	Every output is a new container (or a legacy raw pad with pad_raw)
+	with its own ID, and every source is marked wholly consumed before
+	anything is copied, so no pad byte stays usable in two places even
+	when C fails part way.  A source must be writable, and a legacy raw
+	source has no consumed offset to mark and is refused.
+
+	Data is never read to be copied: copy_range shares it by reflink
+	(FICLONERANGE) where the filesystem can, which costs no data I/O at
+	all, then asks the kernel to copy with copy_file_range, and only
+	then falls back to a read/write loop.  Index checksums are carried
+	over for blocks that line up with a source block, so cutting at
+	multiples of 64K reads nothing; other blocks are read back from the
+	output and checksummed.  Segment sizes from a count are rounded up to
+	whole blocks where that keeps the count.  */
+
+typedef struct {
+	int						fd;
+	le_pad_t				pad;		/* header, or the length of a legacy pad */
+	unsigned char			*index;		/* source checksums, NULL when none */
+	unsigned long long		from, to;	/* data range taken */
+} carve_src_t;
+
+typedef struct {
+	carve_src_t				*src;
+	unsigned long long		from, to;
+} carve_piece_t;
+
+/*  copy_range  --  len bytes of in at ioff to out at ooff: reflinked
+	(counted in *cloned) when aligned, else copied in the kernel, else
+	through buf.  */
+
+static int copy_range(int in, unsigned long long ioff, int out, unsigned long long ooff, unsigned long long len,
+	unsigned char *buf, unsigned long long *cloned)
+{
+	loff_t io, oo;
+	ssize_t n;
+	size_t want;
+#ifdef FICLONERANGE
+	struct file_clone_range fcr;
+
+	if ((ioff % LE_CLONE_ALIGN == 0) && (ooff % LE_CLONE_ALIGN == 0) && (len >= LE_CLONE_ALIGN)) {
+		fcr.src_fd = in;
+		fcr.src_offset = ioff;
+		fcr.src_length = len - len % LE_CLONE_ALIGN;
+		fcr.dest_offset = ooff;
+		if (ioctl(out, FICLONERANGE, &fcr) == 0) {
+			*cloned += fcr.src_length;
+			ioff += fcr.src_length;
+			ooff += fcr.src_length;
+			len -= fcr.src_length;
+		}
+	}
+#endif
+	io = (loff_t) ioff;
+	oo = (loff_t) ooff;
+	while (len > 0) {
+		if ((n = copy_file_range(in, &io, out, &oo, (size_t) len, 0)) > 0) {
+			len -= (unsigned long long) n;
+			continue;
+		}
+		if (n == 0)
+			return(EXIT_FAILURE);
+		if (errno == EINTR)
+			continue;
+		if ((errno != ENOSYS) && (errno != EXDEV) && (errno != EINVAL) && (errno != EOPNOTSUPP))
+			return(EXIT_FAILURE);
+		break;
+	}
+	while (len > 0) {
+		want = (len < LE_WIPE_CHUNK) ? (size_t) len : LE_WIPE_CHUNK;
+		if ((n = pread(in, buf, want, io)) <= 0) {
+			if ((n < 0) && (errno == EINTR))
+				continue;
 			return(EXIT_FAILURE);
 		}
+		if (pwrite(out, buf, (size_t) n, oo) != n)
+			return(EXIT_FAILURE);
+		io += n;
+		oo += n;
+		len -= (unsigned long long) n;
 	}
+	return(EXIT_SUCCESS);
+}
 
-	if (inp_fine == FALSE) {
-		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_READ_INPUT);
+/*  carve_open  --  open and lock a source pad, taking its unused data.
+	A pad already open as another source is refused, as its second
+	lock would never be granted.  Returns -1 for a legacy raw pad,
+	which cannot be marked consumed.  */
+
+static int carve_open(carve_src_t *src, int n, const char *fsp)
+{
+	carve_src_t *cs = src + n;
+	unsigned char hdr[LE_PAD_HDR];
+	le_stream_t *stream;
+	struct stat st, other;
+	unsigned long long count;
+	ssize_t got;
+	int k;
+
+	memset(cs, 0, sizeof(carve_src_t));
+	if ((cs->fd = open(fsp, O_RDWR | O_CLOEXEC)) < 0)
+		return(EXIT_FAILURE);
+	if (fstat(cs->fd, &st) == -1)
+		return(EXIT_FAILURE);
+	for (k = 0; k < n; k++)
+		if ((fstat(src[k].fd, &other) == 0) && (other.st_ino == st.st_ino) && (other.st_dev == st.st_dev))
+			return(EXIT_FAILURE);
+	if (flock(cs->fd, LOCK_EX) == -1)
+		return(EXIT_FAILURE);
+	if ((got = pread(cs->fd, hdr, sizeof(hdr), 0)) < 0)
+		return(EXIT_FAILURE);
+	if (pad_decode(&cs->pad, hdr, (size_t) got) != TRUE)
+		return(-1);
+	if ((stream = le_open_fd(cs->fd, FALSE)) == NULL)
+		return(EXIT_FAILURE);
+	cs->index = pad_index(stream, &cs->pad, &count);
+	le_close(stream);
+	cs->from = cs->pad.consumed;
+	cs->to = cs->pad.length;
+	return(EXIT_SUCCESS);
+}
+
+/*  carve_out  --  write the pieces, in order, as the new pad fsp.  */
+
+static int carve_out(options_t *options, const char *fsp, const carve_piece_t *piece, int n, carve_src_t *src, int nsrc,
+	unsigned char *buf)
+{
+	unsigned char hdr[LE_PAD_HDR], *index = NULL;
+	unsigned long long length = 0, hdrlen, off, b, count, start, end, at = 0;
+	carve_src_t *cs;
+	struct stat st, other;
+	le_pad_t pad;
+	int fd, k, p = 0, rc = EXIT_FAILURE;
+
+	for (k = 0; k < n; k++)
+		length += piece[k].to - piece[k].from;
+	if ((fd = open(fsp, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
 		return(EXIT_FAILURE);
+	if (fstat(fd, &st) == -1)
+		goto done;
+	for (k = 0; k < nsrc; k++)
+		if ((fstat(src[k].fd, &other) == 0) && (other.st_ino == st.st_ino) && (other.st_dev == st.st_dev))
+			goto done;
+	if (ftruncate(fd, 0) == -1)
+		goto done;
+
+	memset(&pad, 0, sizeof(le_pad_t));
+	hdrlen = options->pad_raw ? 0 : LE_PAD_HDR;
+	for (off = hdrlen, k = 0; k < n; k++) {
+		if (copy_range(piece[k].src->fd, piece[k].src->pad.hdrlen + piece[k].from, fd, off,
+			piece[k].to - piece[k].from, buf, &options->stats.cloned) != EXIT_SUCCESS)
+			goto done;
+		off += piece[k].to - piece[k].from;
+	}
+	if (options->pad_raw) {
+		rc = EXIT_SUCCESS;
+		goto done;
 	}
 
-	return(EXIT_SUCCESS);
+	if (harvest(options, pad.id, LE_PAD_ID) != EXIT_SUCCESS)
+		goto done;
+	pad.hdrlen = LE_PAD_HDR;
+	pad.block_size = LE_BLOCK_SIZE;
+	pad.length = length;
+	pad.created = (unsigned long long) time(NULL);
+	pad.index_offset = pad.hdrlen + pad.length;
+	snprintf(pad.device, sizeof(pad.device), "%s", piece[0].src->pad.hdrlen ? piece[0].src->pad.device : options->devname);
+
+	/* the checksum of each block: carried over when it is exactly a source block, else read back */
+
+	count = (length + LE_BLOCK_SIZE - 1) / LE_BLOCK_SIZE;
+	if ((index = calloc((size_t) count + 1, 8)) == NULL)
+		goto done;
+	memcpy(index, LE_PAD_INDEX, 4);
+	put32(index + 4, (unsigned int) count);
+	for (b = 0; b < count; b++) {
+		off = b * LE_BLOCK_SIZE;
+		end = (off + LE_BLOCK_SIZE < length) ? off + LE_BLOCK_SIZE : length;
+		while (off >= at + piece[p].to - piece[p].from) {
+			at += piece[p].to - piece[p].from;
+			p++;
+		}
+		cs = piece[p].src;
+		start = piece[p].from + (off - at);
+		if ((cs->index != NULL) && (cs->pad.block_size == LE_BLOCK_SIZE) && (start % LE_BLOCK_SIZE == 0)
+			&& (end <= at + piece[p].to - piece[p].from)
+			&& ((start + (end - off) == cs->pad.length) || ((end - off) == LE_BLOCK_SIZE)))
+			memcpy(index + 8 + 8 * b, cs->index + 8 * (start / LE_BLOCK_SIZE), 8);
+		else {
+			if (pread(fd, buf, (size_t) (end - off), (off_t) (pad.hdrlen + off)) != (ssize_t) (end - off))
+				goto done;
+			put64(index + 8 + 8 * b, xxh64(buf, (size_t) (end - off), 0));
+		}
+	}
+	pad_encode(&pad, hdr);
+	if ((pwrite(fd, index, 8 + 8 * (size_t) count, (off_t) pad.index_offset) != (ssize_t) (8 + 8 * count))
+		|| (pwrite(fd, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr)))
+		goto done;
+	rc = EXIT_SUCCESS;
+
+done:
+	free(index);
+	if ((close(fd) == -1) && (rc == EXIT_SUCCESS))
+		rc = EXIT_FAILURE;
+	if (rc != EXIT_SUCCESS)
+		unlink(fsp);
+	return(rc);
 }
 
-/* perform pyx trial on existing otp : entropy, chi square, mean */ 
-/* binary/byte mode and text stdout/terse fsp output */
+static int run_carve(options_t *options)
+{
+	carve_src_t src[LE_STRIPE_MAX];
+	carve_piece_t piece[LE_STRIPE_MAX];
+	char list[MAX_FSP_PATH], fsp[MAX_FSP_PATH + 8], *tok, *save = NULL;
+	unsigned long long avail, size = 0, count = 0, k;
+	unsigned char *buf;
+	int n = 0, i, rc = EXIT_FAILURE;
 
-/* P -pfsp -b || P -pfsp -ofsp -b */
-/* [P -pexisting.otp] [-b] */
-/* [P -pexisting.otp -oterse.rpt] [-b] */
+	if ((buf = le_buf_get(LE_WIPE_CHUNK)) == NULL) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		return(EXIT_FAILURE);
+	}
+	snprintf(list, sizeof(list), "%s", options->otp_fsp);
+	for (tok = strtok_r(list, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+		if ((n == LE_STRIPE_MAX) || ((i = carve_open(src, n, tok)) != EXIT_SUCCESS)) {
+			if ((n < LE_STRIPE_MAX) && (src[n].fd >= 0))
+				close(src[n].fd);
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ((n < LE_STRIPE_MAX) && (i < 0)) ? ERR_CARVE_RAW : ERR_CARVE_OPEN);
+			goto done;
+		}
+		piece[n].src = &src[n];
+		piece[n].from = src[n].from;
+		piece[n].to = src[n].to;
+		n++;
+	}
+	if (n == 0) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CARVE_OPEN);
+		goto done;
+	}
+	for (avail = 0, i = 0; i < n; i++)
+		avail += piece[i].to - piece[i].from;
+	if (n == 1) {
+		if (options->segments > 0) {
+			size = (avail + (unsigned long long) options->segments - 1) / (unsigned long long) options->segments;
+			k = (size + LE_BLOCK_SIZE - 1) / LE_BLOCK_SIZE * LE_BLOCK_SIZE;
+			if ((k > 0) && ((avail + k - 1) / k == (unsigned long long) options->segments))
+				size = k;
+		} else
+			size = options->size;
+		count = (size > 0) ? (avail + size - 1) / size : 0;
+		if ((count == 0) || (count > LE_CARVE_MAX)) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CARVE_SIZE);
+			goto done;
+		}
+	}
+
+	/* the data is given up before any is copied, so a failure part way
+	   loses the rest rather than leaving it usable in two places */
+
+	for (i = 0; i < n; i++) {
+		src[i].pad.consumed = src[i].pad.length;
+		if (pad_store(src[i].fd, &src[i].pad) != EXIT_SUCCESS) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_PAD_UPDATE);
+			goto done;
+		}
+	}
+
+	tick_total(options, (long long) avail);
+	if (n > 1) {
+		if (carve_out(options, options->output_fsp, piece, n, src, n, buf) != EXIT_SUCCESS) {
+			snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CARVE_WRITE);
+			goto done;
+		}
+		if (tick(options, avail) != EXIT_SUCCESS)
+			goto done;
+	} else
+		for (k = 0; k < count; k++) {
+			piece[0].from = src[0].from + k * size;
+			piece[0].to = (piece[0].from + size < src[0].to) ? piece[0].from + size : src[0].to;
+			snprintf(fsp, sizeof(fsp), "%s.%03llu", options->output_fsp, k);
+			if (carve_out(options, fsp, piece, 1, src, 1, buf) != EXIT_SUCCESS) {
+				snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_CARVE_WRITE);
+				goto done;
+			}
+			if (tick(options, piece[0].to - piece[0].from) != EXIT_SUCCESS)
+				goto done;
+		}
+	if (n == 1)
+		options->pad = src[0].pad;
+	rc = EXIT_SUCCESS;
+
+done:
+	for (i = 0; i < n; i++) {
+		free(src[i].index);
+		close(src[i].fd);
+	}
+	le_buf_put(buf);
+	return(rc);
+}
+
+/*  Statistics  --  every command runs under measure(), which resets the
+	per-stream counters, times the command and folds the counters into
+	options->stats.  Time not spent inside a stream backend is charged
+	to compute (XOR, Pyx accumulation and loop overhead).  */
+
+static void stats_reset(le_stream_t *stream, const char *role)
+{
+	if (stream != NULL) {
+		memset(&stream->stats, 0, sizeof(le_io_stats_t));
+		stream->role = role;
+	}
+}
+
+static double stats_take(le_io_stats_t *dst, le_stream_t *stream)
+{
+	if (stream == NULL)
+		return(0.0);
+	*dst = stream->stats;
+	return(dst->seconds);
+}
+
+static int measure(options_t *options, FUNC run)
+{
+	le_stats_t *st = &options->stats;
+	double t0;
+	int rc;
+
+	memset(st, 0, sizeof(le_stats_t));
+	stats_reset(options->input, "input");
+	stats_reset(options->output, "output");
+	stats_reset(options->otp, "otp");
+	stats_reset(options->encrypted, "encrypted");
+	stats_reset(options->device, "device");
+	io_policy(options->input, options->io_policy);
+	io_policy(options->output, options->io_policy);
+	io_policy(options->otp, options->io_policy);
+	io_policy(options->encrypted, options->io_policy);
+
+	t0 = now_seconds();
+	rc = run(options);
+	st->total_seconds = now_seconds() - t0;
+
+	st->io_seconds = stats_take(&st->input, options->input)
+		+ stats_take(&st->output, options->output)
+		+ stats_take(&st->otp, options->otp)
+		+ stats_take(&st->encrypted, options->encrypted);
+	st->rng_seconds = stats_take(&st->device, options->device);
+	st->compute_seconds = st->total_seconds - st->io_seconds - st->rng_seconds;
+	if (st->compute_seconds < 0.0)
+		st->compute_seconds = 0.0;
+	st->throughput = (st->total_seconds > 0.0) ? st->bytes / st->total_seconds : 0.0;
+	return(rc);
+}
+
+int	g_generate(options_t *options)
+{
+	int rc;
+
+	LE_PROBE0(generate_start);
+	rc = measure(options, run_generate);
+	LE_PROBE2(generate_done, rc, options->stats.bytes);
+	return(rc);
+}
+
+int	e_encrypt(options_t *options)
+{
+	int rc;
+
+	LE_PROBE0(encrypt_start);
+	rc = measure(options, run_encrypt);
+	LE_PROBE2(encrypt_done, rc, options->stats.bytes);
+	return(rc);
+}
+
+int	d_decrypt(options_t *options)
+{
+	int rc;
+
+	LE_PROBE0(decrypt_start);
+	rc = measure(options, run_decrypt);
+	LE_PROBE2(decrypt_done, rc, options->stats.bytes);
+	return(rc);
+}
 
 int	p_pyx(options_t *options)
 {
-	int b, oc, result[6];
-	long ccount[256];	      /* Bins to count occurrences of values */
-	long totalc = 0;	      /* Total character count */
-	char *samp;
-	double montepi, chip, scc, ent, mean, chisq;
-	unsigned char ocb, ob;
+	int rc;
 
-	samp = options->pyx_binary ? "bit" : "byte";
-	memset(ccount, 0, sizeof ccount);
-	memset(result, FALSE, sizeof result);
+	LE_PROBE0(pyx_start);
+	rc = measure(options, run_pyx);
+	LE_PROBE2(pyx_done, rc, options->stats.bytes);
+	return(rc);
+}
 
-	/* Initialise for calculations */
+int	w_wipe(options_t *options)
+{
+	return(measure(options, run_wipe));
+}
 
-	pyx_init(options->pyx_binary);
+int	c_carve(options_t *options)
+{
+	return(measure(options, run_carve));
+}
 
-	/* Scan input file and count character occurrences */
+/*  Server  --  resident encrypt/decrypt/generate/Pyx over a Unix socket.
 
-	while ((oc = fgetc(options->otp)) != EOF) {
-		ocb = (unsigned char) oc;
-		totalc += options->pyx_binary ? 8 : 1;
-		if (options->pyx_binary) {
-			ob = ocb;
-			for (b = 0; b < 8; b++) {
-				ccount[ob & 1]++;
-				ob >>= 1;
-			}	
-		} else
-			ccount[ocb]++;	      /* Update counter for this bin */
+	s_serve keeps pads mapped, the RNG device open and its reply buffer
+	warm, so a request costs a few syscalls plus the XOR.  Each request
+	is an le_msg_t header followed by the pad path (pathlen bytes) and,
+	for E and D, length bytes of payload which are XORed with the pad
+	data (past the header of a container pad).  D uses the data from
+	offset.  E needs a container pad and ignores offset: under the pad
+	lock it takes the bytes from the consumed offset and stores the
+	advanced offset before the XOR, so no two requests (or an E run
+	elsewhere) share pad bytes, and replies with the offset used, which
+	the client keeps for D.  G returns length fresh
+	device bytes, or writes a new container pad of that size when a
+	path is given.  P returns the terse
+	CSV Pyx report of the pad.  The reply is an le_msg_t (flags 0 on
+	success) followed by length bytes of result or of error text.
+	Connections are persistent; requests on one connection are served
+	in order.  Requests are read without blocking into per-connection
+	state, so a client that sends part of a request holds up nobody
+	else, and a client that stops reading its replies is dropped after
+	LE_SERVE_TIMEOUT seconds.  le_serve_shutdown (async-signal-safe)
+	stops the loop.  */
+
+typedef struct {
+	char					fsp[MAX_FSP_PATH];
+	le_stream_t				*stream;
+	le_pad_t				info;		/* container header, or legacy size */
+	dev_t					dev;		/* the file mapped, to notice a pad */
+	ino_t					ino;		/* replaced at fsp */
+	off_t					size;
+	unsigned long long		used;		/* LRU stamp */
+} serve_pad_t;
+
+typedef struct {
+	le_msg_t				msg;
+	char					fsp[MAX_FSP_PATH];
+	unsigned char			*payload;	/* malloc'd, doubled as requests grow */
+	size_t					payload_max;
+	size_t					got;		/* bytes of the request read so far */
+} serve_conn_t;
+
+typedef struct {
+	options_t				*options;
+	serve_pad_t				pads[LE_SERVE_PADS];
+	unsigned long long		clock;
+	le_stream_t				*source;	/* memory stream over a payload */
+	le_stream_t				*sink;		/* growable reply buffer, kept warm */
+} serve_t;
+
+static volatile sig_atomic_t serve_stop = 0;
 
-	pyx_add(&ocb, 1);
+void le_serve_shutdown(void)
+{
+	serve_stop = 1;
+}
+
+static int full_io(int fd, void *buf, size_t len, int out)
+{
+	unsigned char *bp = buf;
+	ssize_t n;
+
+	while (len > 0) {
+		n = out ? send(fd, bp, len, MSG_NOSIGNAL) : recv(fd, bp, len, 0);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return(EXIT_FAILURE);
+		}
+		if (n == 0)
+			return(EXIT_FAILURE);
+		bp += n;
+		len -= (size_t) n;
 	}
+	return(EXIT_SUCCESS);
+}
 
-	/* Complete calculation and return sequence metrics */
+static int send_reply(int fd, le_msg_t *msg, const void *data, size_t len)
+{
+	struct iovec iov[2];
+	struct msghdr mh;
+	size_t total;
+	ssize_t n;
 
-	pyx_end(&ent, &chisq, &mean, &montepi, &scc);
+	msg->magic = LE_SERVE_MAGIC;
+	msg->pathlen = 0;
+	msg->length = len;
+	iov[0].iov_base = msg;
+	iov[0].iov_len = sizeof(le_msg_t);
+	iov[1].iov_base = (void *) data;
+	iov[1].iov_len = len;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 2;
+	total = sizeof(le_msg_t) + len;
 
-	if (options->cmd_mode==CMD_ALT) {
-		fprintf(options->output, "0,File-%ss,Entropy,Chi-square,Mean,Monte-Carlo-Pi,Serial-Correlation\n", options->pyx_binary ? "bit" : "byte");
-		fprintf(options->output, "1,%ld,%f,%f,%f,%f,%f\n", totalc, ent, chisq, mean, montepi, scc);
+	while ((n = sendmsg(fd, &mh, MSG_NOSIGNAL)) < 0)
+		if (errno != EINTR)
+			return(EXIT_FAILURE);
+	if ((size_t) n == total)
+		return(EXIT_SUCCESS);
+	if ((size_t) n < sizeof(le_msg_t))
+		return(full_io(fd, (unsigned char *) msg + n, sizeof(le_msg_t) - n, TRUE) == EXIT_SUCCESS
+			? full_io(fd, (void *) data, len, TRUE) : EXIT_FAILURE);
+	return(full_io(fd, (unsigned char *) data + (n - sizeof(le_msg_t)), total - n, TRUE));
+}
+
+/*  serve_same  --  TRUE when sb describes the file pad has mapped.  */
+
+static int serve_same(const serve_pad_t *pad, const struct stat *sb)
+{
+	return((pad->dev == sb->st_dev) && (pad->ino == sb->st_ino) && (pad->size == sb->st_size));
+}
+
+/*  serve_pad  --  mapped pad for fsp, opening it (evicting LRU) if needed.
+	A pad renamed over, regenerated or resized at fsp is mapped again.  */
+
+static serve_pad_t *serve_pad(serve_t *sv, const char *fsp)
+{
+	serve_pad_t *pad, *victim = &sv->pads[0];
+	struct stat sb;
+	int i;
+
+	for (i = 0; i < LE_SERVE_PADS; i++) {
+		pad = &sv->pads[i];
+		if ((pad->stream != NULL) && (strcmp(pad->fsp, fsp) == 0)) {
+			if ((stat(fsp, &sb) == 0) && serve_same(pad, &sb)) {
+				pad->used = ++sv->clock;
+				return(pad);
+			}
+			victim = pad;
+			break;
+		}
+		if ((victim->stream != NULL) && ((pad->stream == NULL) || (pad->used < victim->used)))
+			victim = pad;
 	}
 
-	/* Print calculated results */
+	le_close(victim->stream);
+	if (((victim->stream = le_open_mmap(fsp)) != NULL)
+		&& ((fstat(victim->stream->fd, &sb) == -1) || (le_pad_read(victim->stream, &victim->info) < 0))) {
+		le_close(victim->stream);
+		victim->stream = NULL;
+	}
+	if (victim->stream == NULL)
+		return(NULL);
+	victim->dev = sb.st_dev;
+	victim->ino = sb.st_ino;
+	victim->size = sb.st_size;
+	snprintf(victim->fsp, sizeof(victim->fsp), "%s", fsp);
+	victim->used = ++sv->clock;
+	return(victim);
+}
 
-	if (options->cmd_mode!=CMD_ALT) {
-	/* Calculate probability of observed distribution occurring from
-	   the results of the Chi-Square test */
+static void serve_forget(serve_t *sv, const char *fsp)
+{
+	int i;
 
-		chip = pochisq(chisq, (options->pyx_binary ? 1 : 255));
+	for (i = 0; i < LE_SERVE_PADS; i++)
+		if ((sv->pads[i].stream != NULL) && (strcmp(sv->pads[i].fsp, fsp) == 0)) {
+			le_close(sv->pads[i].stream);
+			sv->pads[i].stream = NULL;
+		}
+}
 
-		result[0] = (ent <= 7.5)?FALSE:TRUE;
-		result[1] = (((short) ((100 * ((options->pyx_binary ? 1 : 8) - ent) / (options->pyx_binary ? 1.0 : 8.0)))) > 1)?FALSE:TRUE;
-		result[2] = ((chip * 100 <= 10) || (chip * 100 >= 90))?FALSE:TRUE;
-		result[3] = (((options->pyx_binary)&&(mean >= 4.5)&&(mean <= 5.5))||((!options->pyx_binary)&&(mean <= 127)&&(mean >= 128)))?FALSE:TRUE;
-		result[4] = (((100.0 * (fabs(PI - montepi) / PI)) > 0.3)&&((100.0 * (fabs(PI - montepi) / PI)) > 0.01))?FALSE:TRUE;
-		result[5] = (scc >= 0.1)?FALSE:TRUE;
+/*  serve_read  --  read what the client has sent of its next request
+	without blocking.  Returns 1 when the request is complete, 0 when
+	more is to come and -1 when the connection should be dropped.  */
 
-		printf("Pyx Trial Assessment\n");
-		printf("OVERALL		: %s && %s && %s && %s && %s = %s\n\n", (result[0]&&result[1])?PASS:FAIL, result[2]?PASS:FAIL, result[3]?PASS:FAIL, result[4]?PASS:FAIL, result[5]?PASS:FAIL, (result[0]&&result[1]&&result[2]&&result[3]&&result[4]&&result[5])?PASS:FAIL);
-		printf("One Time Pad Density\n");
-		printf("Entropy : %f bits per %s.\n", ent, samp);
-		printf("Optimum compression of OTP file size %ld %ss by %d percent\n", totalc, samp, (short) ((100 * ((options->pyx_binary ? 1 : 8) - ent) / (options->pyx_binary ? 1.0 : 8.0))));
-		printf("\t[GOOD 		= Entropy close to 8 bits, compression 0 percent]\n\n");
-		printf("One Time Pad Distribution\n");
-		printf("Chi Square : for %ld samples is %1.2f\n", totalc, chisq);
-		if (chip < 0.0001)
-			printf("Value would be exceeded randomly less than 0.01 percent of the times.\n");
-		else 
-			if (chip > 0.9999)
-				printf("Value would be exceeded randomly more than than 99.99 percent of the times.\n");
-			else {
-				printf("Value would be exceeded randomly %1.2f percent of the times.\n", chip * 100);
+static int serve_read(serve_conn_t *conn, int fd)
+{
+	unsigned char *dst, *grown;
+	size_t head, need, want;
+	ssize_t n;
+
+	for (;;) {
+		head = sizeof(le_msg_t);
+		if (conn->got < head) {
+			dst = (unsigned char *) &conn->msg + conn->got;
+			need = head - conn->got;
+		} else {
+			if (conn->got == head) {
+				if ((conn->msg.magic != LE_SERVE_MAGIC) || (conn->msg.pathlen >= MAX_FSP_PATH))
+					return(-1);
+				if (((conn->msg.op == 'E') || (conn->msg.op == 'D')) && (conn->msg.length > conn->payload_max)) {
+					if (conn->msg.length > LE_SERVE_MAX)
+						return(-1);		/* cannot resynchronise */
+					for (want = LE_BLOCK_SIZE; want < conn->msg.length; want *= 2)
+						;
+					if (want > LE_SERVE_MAX)
+						want = LE_SERVE_MAX;
+					if ((grown = realloc(conn->payload, want)) == NULL)
+						return(-1);
+					conn->payload = grown;
+					conn->payload_max = want;
+				}
 			}
-		printf("\t[GOOD 		= 10 percent to 90 percent]\n");
-		printf("\t[SUSPECT 	= 5 to 10 percent or 90 to 95 percent]\n");
-		printf("\t[WORSE		= 1 to 5 percent or 95 to 99 percent]\n");
-		printf("\t[WORST		= 0 to 1 percent or 99 to 100 percent]\n");
-				
-		printf("Arithmetic mean of data %ss is %1.4f\n", samp, mean);
-		printf("\t[RANDOM 	= %.1f]\n", options->pyx_binary ? 0.5 : 127.5);
+			if (conn->got < head + conn->msg.pathlen) {
+				dst = (unsigned char *) conn->fsp + (conn->got - head);
+				need = head + conn->msg.pathlen - conn->got;
+			} else if (((conn->msg.op == 'E') || (conn->msg.op == 'D'))
+				&& (conn->got < head + conn->msg.pathlen + conn->msg.length)) {
+				dst = conn->payload + (conn->got - head - conn->msg.pathlen);
+				need = head + conn->msg.pathlen + conn->msg.length - conn->got;
+			} else {
+				conn->fsp[conn->msg.pathlen] = '\0';
+				conn->got = 0;
+				return(1);
+			}
+		}
 
-		printf("Monte Carlo value for Pi is %1.9f (error %1.2f percent)\n", montepi, 100.0 * (fabs(PI - montepi) / PI));
-		printf("\t[RANDOM		= error 0.06 percent]\n");
+		n = recv(fd, dst, need, MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return(((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1);
+		}
+		if (n == 0)
+			return(-1);
+		conn->got += (size_t) n;
+	}
+}
 
-		printf("Serial correlation coefficient is ");
+/*  serve_request  --  run and answer the request read on conn.  Returns
+	EXIT_FAILURE when the connection should be dropped.  */
 
-		if (scc >= -99999)
-			printf("%1.6f\n", scc);
-		else
-			printf("undefined (all values are equal)\n");
-		printf("\t[RANDOM		= 0.0]\n");
-		printf("\t[PREDICTED	= 1.0]\n");
+static int serve_request(serve_t *sv, serve_conn_t *conn, int fd)
+{
+	char *fsp = conn->fsp;
+	le_msg_t msg = conn->msg;
+	unsigned char hdr[LE_PAD_HDR];
+	struct stat sb;
+	options_t opts;
+	serve_pad_t *pad;
+	int rc = EXIT_FAILURE;
+	int lock;
+
+	memset(&opts, 0, sizeof(opts));
+	opts.cmd_mode = CMD_STD;
+	opts.device = sv->options->device;
+	opts.condition = sv->options->condition;
+	opts.fold = sv->options->fold;
+	memcpy(opts.reuse_fsp, sv->options->reuse_fsp, sizeof(opts.reuse_fsp));
+	sv->sink->offset = sv->sink->length = 0;
+
+	if (msg.length > LE_SERVE_MAX) {
+		snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_SERVE_SIZE);
+		goto reply;
+	}
+
+	switch (msg.op) {
+		case 'E':
+		case 'D':
+			if ((pad = serve_pad(sv, fsp)) == NULL) {
+				snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_SERVE_PAD);
+				break;
+			}
+			if ((msg.op == 'E') && (pad->info.hdrlen == 0)) {
+				snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_SERVE_RAW);
+				break;
+			}
+			if (msg.op == 'E') {
+				/* reserve length bytes from the consumed offset of the file mapped */
+				if ((lock = open(fsp, O_RDWR | O_CLOEXEC)) < 0) {
+					snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_PAD_UPDATE);
+					break;
+				}
+				if ((flock(lock, LOCK_EX) == -1) || (fstat(lock, &sb) == -1)
+					|| (!serve_same(pad, &sb) && (((pad = serve_pad(sv, fsp)) == NULL) || !serve_same(pad, &sb)))
+					|| (pread(lock, hdr, sizeof(hdr), 0) != (ssize_t) sizeof(hdr))
+					|| (pad_decode(&pad->info, hdr, sizeof(hdr)) != TRUE))
+					snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_PAD_UPDATE);
+				else if (msg.length > pad->info.length - pad->info.consumed)
+					snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_OTP_SHORT);
+				else {
+					msg.offset = pad->info.consumed;
+					pad->info.consumed += msg.length;
+					if (pad_store(lock, &pad->info) != EXIT_SUCCESS)
+						snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_PAD_UPDATE);
+				}
+				close(lock);
+				if (opts.errmsg[0] != '\0') {
+					serve_forget(sv, fsp);
+					break;
+				}
+			}
+			if (le_pad_seek(pad->stream, &pad->info, msg.offset) != EXIT_SUCCESS) {
+				snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_SERVE_OFFSET);
+				break;
+			}
+			sv->source->base = conn->payload;
+			sv->source->length = sv->source->capacity = msg.length;
+			sv->source->offset = 0;
+			opts.input = sv->source;
+			opts.otp = pad->stream;
+			opts.output = sv->sink;
+			rc = (msg.op == 'E') ? e_encrypt(&opts) : d_decrypt(&opts);
+			break;
+
+		case 'G':
+			opts.size = msg.length;
+			if (msg.pathlen > 0) {
+				serve_forget(sv, fsp);
+				if ((opts.otp = le_open_file(fsp, O_WRONLY | O_CREAT | O_TRUNC)) == NULL) {
+					snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_SERVE_PAD);
+					break;
+				}
+				rc = g_generate(&opts);
+				if ((le_close(opts.otp) != 0) && (rc == EXIT_SUCCESS)) {
+					snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_WRITE_OTP);
+					rc = EXIT_FAILURE;
+				}
+			} else {
+				opts.otp = sv->sink;
+				opts.pad_raw = TRUE;
+				rc = g_generate(&opts);
+			}
+			break;
+
+		case 'P':
+			if ((pad = serve_pad(sv, fsp)) == NULL) {
+				snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_SERVE_PAD);
+				break;
+			}
+			le_pad_seek(pad->stream, &pad->info, 0);
+			opts.otp = pad->stream;
+			opts.output = sv->sink;
+			opts.cmd_mode = CMD_ALT;
+			opts.pyx_binary = (msg.flags & LE_SERVE_BINARY) ? TRUE : FALSE;
+			rc = p_pyx(&opts);
+			break;
+
+		default:
+			snprintf(opts.errmsg, sizeof(opts.errmsg), "%s", ERR_SERVE_OP);
+			break;
+	}
+
+reply:
+	msg.flags = (rc == EXIT_SUCCESS) ? 0 : 1;
+	if (rc == EXIT_SUCCESS)
+		return(send_reply(fd, &msg, sv->sink->base, (size_t) sv->sink->length));
+	return(send_reply(fd, &msg, opts.errmsg, strlen(opts.errmsg)));
+}
+
+/* S -u<socket fsp> */
+/* [S -u/run/er.sock] */
+
+int s_serve(options_t *options)
+{
+	struct pollfd fds[LE_SERVE_CLIENTS + 1];
+	serve_conn_t conns[LE_SERVE_CLIENTS + 1];
+	struct timeval tv = { LE_SERVE_TIMEOUT, 0 };
+	struct sockaddr_un addr;
+	struct stat sb;
+	serve_t sv;
+	int listener, nfds, i, fd, rc;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(options->socket_fsp) >= sizeof(addr.sun_path)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_SOCK_PATH);
+		return(EXIT_FAILURE);
+	}
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", options->socket_fsp);
+
+	/* a socket left behind by a previous server is replaced */
+	if ((lstat(options->socket_fsp, &sb) == 0) && S_ISSOCK(sb.st_mode))
+		unlink(options->socket_fsp);
+
+	if (((listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		|| (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+		|| (chmod(options->socket_fsp, 0600) == -1)
+		|| (listen(listener, LE_SERVE_CLIENTS) == -1)) {
+		if (listener >= 0)
+			close(listener);
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_SOCKET);
+		return(EXIT_FAILURE);
+	}
+
+	memset(&sv, 0, sizeof(sv));
+	memset(conns, 0, sizeof(conns));
+	sv.options = options;
+	sv.source = le_open_mem(NULL, 0, 0);
+	sv.sink = le_open_mem(NULL, 0, 0);
+	if ((sv.source == NULL) || (sv.sink == NULL)) {
+		snprintf(options->errmsg, sizeof(options->errmsg), "%s", ERR_BLOCK_ALLOC);
+		le_close(sv.source);
+		le_close(sv.sink);
+		close(listener);
+		return(EXIT_FAILURE);
+	}
+	sv.source->owned = FALSE;
+
+	fds[0].fd = listener;
+	fds[0].events = POLLIN;
+	nfds = 1;
+	serve_stop = 0;
+
+	while (!serve_stop) {
+		if (poll(fds, (nfds_t) nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = nfds - 1; i >= 1; i--) {
+			if (fds[i].revents == 0)
+				continue;
+			if (!(fds[i].revents & POLLIN) || ((rc = serve_read(&conns[i], fds[i].fd)) < 0)
+				|| ((rc > 0) && (serve_request(&sv, &conns[i], fds[i].fd) != EXIT_SUCCESS))) {
+				close(fds[i].fd);
+				free(conns[i].payload);
+				fds[i] = fds[--nfds];
+				conns[i] = conns[nfds];
+				memset(&conns[nfds], 0, sizeof(serve_conn_t));
+			}
+		}
+
+		if ((fds[0].revents & POLLIN) && ((fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC)) >= 0)) {
+			if (nfds > LE_SERVE_CLIENTS)
+				close(fd);
+			else {
+				setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+				fds[nfds].fd = fd;
+				fds[nfds].events = POLLIN;
+				fds[nfds++].revents = 0;
+			}
+		}
+	}
+
+	for (i = 1; i < nfds; i++) {
+		close(fds[i].fd);
+		free(conns[i].payload);
 	}
+	for (i = 0; i < LE_SERVE_PADS; i++)
+		le_close(sv.pads[i].stream);
+	le_close(sv.source);
+	le_close(sv.sink);
+	close(listener);
+	unlink(options->socket_fsp);
 	return(EXIT_SUCCESS);
 }
+
+/*  le_connect  --  client side: connect to a running s_serve.  */
+
+int le_connect(const char *fsp)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(fsp) >= sizeof(addr.sun_path))
+		return(-1);
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", fsp);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return(-1);
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		close(fd);
+		return(-1);
+	}
+	return(fd);
+}
+
+/*  le_call  --  client side: send one request and collect the reply.
+	msg carries op, flags, offset and length in, and the reply header
+	out; for E the reply offset is the pad offset the server used.
+	payload (length bytes) is sent for E and D.  The reply body
+	(result or error text) is stored in reply, which must hold
+	reply_max bytes.  Returns EXIT_SUCCESS when the server succeeded.  */
+
+int le_call(int sock, le_msg_t *msg, const char *pad_fsp, const void *payload, void *reply, size_t reply_max)
+{
+	struct iovec iov[3];
+	struct msghdr mh;
+	size_t pathlen, total, sent;
+	unsigned char drain[256];
+	ssize_t n;
+	int i;
+
+	pathlen = (pad_fsp != NULL) ? strlen(pad_fsp) : 0;
+	if (pathlen >= MAX_FSP_PATH)
+		return(EXIT_FAILURE);
+	msg->magic = LE_SERVE_MAGIC;
+	msg->pathlen = (unsigned short) pathlen;
+
+	iov[0].iov_base = msg;
+	iov[0].iov_len = sizeof(le_msg_t);
+	iov[1].iov_base = (void *) pad_fsp;
+	iov[1].iov_len = pathlen;
+	iov[2].iov_base = (void *) payload;
+	iov[2].iov_len = ((msg->op == 'E') || (msg->op == 'D')) ? (size_t) msg->length : 0;
+	total = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 3;
+	for (sent = 0; sent < total; ) {
+		if ((n = sendmsg(sock, &mh, MSG_NOSIGNAL)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return(EXIT_FAILURE);
+		}
+		sent += (size_t) n;
+		for (i = 0; (i < 3) && (n > 0); i++) {
+			if ((size_t) n >= iov[i].iov_len) {
+				n -= (ssize_t) iov[i].iov_len;
+				iov[i].iov_len = 0;
+			} else {
+				iov[i].iov_base = (unsigned char *) iov[i].iov_base + n;
+				iov[i].iov_len -= (size_t) n;
+				n = 0;
+			}
+		}
+	}
+
+	if ((full_io(sock, msg, sizeof(le_msg_t), FALSE) != EXIT_SUCCESS) || (msg->magic != LE_SERVE_MAGIC))
+		return(EXIT_FAILURE);
+	if (msg->length <= reply_max)
+		return((full_io(sock, reply, (size_t) msg->length, FALSE) == EXIT_SUCCESS) && (msg->flags == 0)
+			? EXIT_SUCCESS : EXIT_FAILURE);
+
+	/* reply too large for the caller: consume it to stay in step */
+	if (full_io(sock, reply, reply_max, FALSE) != EXIT_SUCCESS)
+		return(EXIT_FAILURE);
+	for (total = (size_t) msg->length - reply_max; total > 0; total -= n) {
+		n = (total < sizeof(drain)) ? (ssize_t) total : (ssize_t) sizeof(drain);
+		if (full_io(sock, drain, (size_t) n, FALSE) != EXIT_SUCCESS)
+			return(EXIT_FAILURE);
+	}
+	return(EXIT_FAILURE);
+}